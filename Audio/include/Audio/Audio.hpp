@@ -1,6 +1,9 @@
 #pragma once
 #include "AudioStream.hpp"
 #include "Sample.hpp"
+#include "Resampler.hpp"
+#include "AudioClock.hpp"
+#include "AudioTelemetry.hpp"
 
 extern class Audio* g_audio;
 
@@ -16,11 +19,40 @@ public:
 	~Audio();
 	// Initializes the audio device
 	bool Init(bool exclusive);
+	// Initializes using a custom output (e.g. FileAudioOutput), takes ownership of the output
+	bool Init(class IAudioOutput* output);
 	void SetGlobalVolume(float vol);
+	// Sets the interpolation used when streams are played at a different rate
+	void SetResamplerQuality(ResamplerQuality quality);
+	// Sets how far ahead streams that are not preloaded decode on their own thread, applies to new streams
+	void SetStreamReadAhead(uint32 milliseconds);
+	// Stores decoded audio of preloaded streams in directory so it doesn't need to be decoded again
+	// the least recently used files are removed when the total size exceeds maxSize, 0 disables the cache
+	void SetPcmCache(const String& directory, uint64 maxSize);
+	// Sets the number of frames the mixer renders at once, 0 follows the period of the output device
+	//	smaller blocks lower the latency but cost more cpu time, clamped to 64-4096
+	void SetMixBlockSize(uint32 frames);
+	// Stores preloaded audio as 16-bit instead of float to halve its memory usage, applies to new streams
+	void SetCompactPcm(bool enabled);
+	// Subtracts the output latency from the play position of streams so it matches the audio being heard
+	//	off by default, the positions then match the mixer like before and the global offset has to cover the latency
+	void SetLatencyCompensation(bool enabled);
+	// Writes the timing of every output callback to a csv file at path, an empty path stops writing
+	void SetTelemetryCsv(const String& path);
+	// Writes telemetry collected since the last call, called once per frame
+	void UpdateTelemetry();
+	// Memory used by decoded audio of all streams and samples, in bytes
+	uint64 GetPCMMemoryUsage();
+	// Latency, jitter and drift of the clock streams use for their play position
+	AudioClockStats GetClockStats();
+	// Block timing, xruns and the cost of items and DSPs measured by the audio thread
+	AudioMixerStats GetMixerStats();
 
 	// Opens a stream at path
 	//	settings preload loads the whole file into memory before playing
 	Ref<AudioStream> CreateStream(const String& path, bool preload = false);
+	// Decodes the whole file at path for analysis, the stream can't be played and isn't stored in the pcm cache
+	Ref<AudioStream> DecodeStream(const String& path);
 	// Open a wav file at path
 	Sample CreateSample(const String& path);
 
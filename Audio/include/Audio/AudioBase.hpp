@@ -1,4 +1,5 @@
 #pragma once
+#include "CommandQueue.hpp"
 
 /*
 	Base class for Digital Signal Processors
@@ -18,6 +19,9 @@ protected:
 
 	class AudioBase *m_audioBase = nullptr;
 
+	// Used instead of the position of m_audioBase while pre-rendering, -1 otherwise
+	int64 m_preRenderPosition = -1;
+
 public:
 	virtual ~DSP();
 	static bool Sorter(DSP *&a, DSP *&b);
@@ -25,10 +29,22 @@ public:
 	void SetAudioBase(class AudioBase *audioBase);
 	inline void RemoveAudioBase() { m_audioBase = nullptr; }
 	inline void SetSampleRate(uint32 sampleRate) { m_sampleRate = sampleRate; }
+	// Makes Process act as if the audio base is at position, so multiple DSPs on the same audio can be pre-rendered at once
+	inline void SetPreRenderPosition(int64 position) { m_preRenderPosition = position; }
+
+	// How far outside of startTime-endTime this DSP reads from its audio base, in milliseconds
+	// effects closer together than this depend on each other when pre-rendering
+	virtual uint32 GetReadMargin() const { return 0; }
 
 	// Process <numSamples> amount of samples in stereo float format
 	virtual void Process(float *out, uint32 numSamples) = 0;
 	virtual const char *GetName() const = 0;
+	// Describes everything that affects the output of this DSP, used to identify pre-rendered audio
+	//	derived classes append their parameters
+	virtual String GetKey() const;
+
+	// Increase when changing how any DSP processes audio, audio rendered by older versions is not reused
+	static constexpr uint32 implementationVersion = 2;
 
 	float mix = 1.0f;
 	uint32 priority = 0;
@@ -57,6 +73,16 @@ public:
 	// Get the exact playback position in samples
 	virtual uint64 GetSamplePos() const = 0;
 
+	// Frame in the block that is being mixed at which this audio reaches samplePos, 0 if it was already reached
+	//	INT64_MAX if it isn't moving towards it, audio without a position of its own reaches everything right away
+	//	positions are negative during the lead-in of streams, INT64_MIN is always reached
+	//	only called by the audio thread
+	virtual int64 GetMixOffset(int64 samplePos) const { return 0; }
+	// Changes when earlier positions of this audio stop meaning anything, when it is registered and when it seeks
+	//	plays scheduled against an older generation are dropped
+	uint64 GetClockGeneration() const { return m_clockGeneration; }
+	void NewClockGeneration();
+
 	// Get the sample rate of the audio connected to this
 	uint32 GetAudioSampleRate() const;
 
@@ -64,15 +90,31 @@ public:
 	virtual float *GetPCM() = 0;
 	// Gets pcm sample count
 	virtual uint64 GetPCMCount() const = 0;
+	// Gets 16-bit pcm data from a decoded stream that is stored in compact form, GetPCM returns nullptr in that case
+	virtual int16 *GetPCM16() { return nullptr; }
+	// Memory used to store decoded pcm data, in bytes
+	virtual uint64 GetPCMMemoryUsage() const { return 0; }
 	virtual void PreRenderDSPs(Vector<DSP *> &DSPs) = 0;
+	// Name shown in the audio telemetry
+	virtual const char *GetName() const { return "AudioBase"; }
 
-	void ProcessDSPs(float *out, uint32 numSamples);
 	// Adds a signal processor to the audio
 	void AddDSP(DSP *dsp);
 	// Removes a signal processor from the audio
+	// the DSP is no longer used by the audio thread after this returns
 	void RemoveDSP(DSP *dsp);
 
-	void Deregister();
+	virtual void Deregister();
+
+	// Sets dsp->mix when this audio reaches samplePos, the mixer applies it at the exact frame
+	//	replaces changes to the same DSP that are still pending, they are dropped when the DSP is removed
+	//	dropped and counted in the telemetry when the queue to the audio thread is full
+	//	should be called from a single thread
+	void ScheduleDSPMix(DSP *dsp, float mix, int64 samplePos);
+	// Applies scheduled changes to DSPs reached at offset in the block that is being mixed
+	//	returns the offset of the next change within numSamples, or numSamples if there is none
+	//	only called by the audio thread
+	uint32 ApplyScheduledEvents(const Vector<DSP *> &activeDSPs, uint32 offset, uint32 numSamples);
 
 	// Stream volume from 0-1
 	void SetVolume(float volume)
@@ -84,10 +126,24 @@ public:
 		return m_volume;
 	}
 
+	// Only modified through AddDSP/RemoveDSP, the audio thread renders a published copy
 	Vector<DSP *> DSPs;
 	float PlaybackSpeed = 1.0;
 	class Audio_Impl *audio = nullptr;
 
 private:
 	float m_volume = 1.0f;
+	std::atomic<uint64> m_clockGeneration = { 0 };
+
+	struct DSPEvent
+	{
+		DSP *dsp;
+		float mix;
+		int64 samplePos;
+	};
+	static const uint32 maxPendingDSPEvents = 16;
+	CommandQueue<DSPEvent, 64> m_newDSPEvents;
+	// Events taken from m_newDSPEvents that weren't reached yet, only touched by the audio thread
+	DSPEvent m_pendingDSPEvents[maxPendingDSPEvents];
+	uint32 m_numPendingDSPEvents = 0;
 };
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+#include "SeqLock.hpp"
+#include <mutex>
+
+/*
+	Statistics about how well the output device keeps time
+*/
+struct AudioClockStats
+{
+	// Time between audio being mixed and it being heard, as reported by the output
+	double latencyMs = 0.0;
+	// Average and largest difference between a callback and where the clock expected it
+	double jitterMs = 0.0;
+	double maxJitterMs = 0.0;
+	// How much faster the device consumes audio than its nominal sample rate, in parts per million
+	double driftPpm = 0.0;
+	// Number of times the clock jumped to the device position because it was too far off
+	uint32 numResyncs = 0;
+};
+
+/*
+	Clock of the audio that is currently being heard, in frames of the mixer
+	The output callback publishes how many frames it consumed and its latency
+	readers interpolate between callbacks with a filter that smooths out callback jitter and follows the device rate
+*/
+class AudioClock
+{
+public:
+	AudioClock();
+
+	// Clears the clock for output at sampleRate
+	void Reset(uint32 sampleRate);
+
+	// Called by the audio thread at the start of every output callback
+	//	mixPosition is the number of frames handed to the output before this callback
+	//	outputs that aren't real-time count as heard up to the end of the callback, without interpolating
+	void Publish(uint64 mixPosition, uint32 numFrames, double latency, bool realTime);
+
+	// Mixer frame that is being heard right now, returns false if no callback happened yet
+	//	never goes backwards, unless the clock had to resync
+	bool GetHeardPosition(double &position);
+	// Latency reported by the last output callback, in seconds
+	double GetLatency() const;
+
+	AudioClockStats GetStats();
+
+private:
+	struct Callback
+	{
+		// Counts callbacks, 0 when there was none yet
+		uint64 index;
+		uint64 mixPosition;
+		uint32 numFrames;
+		double latency;
+		double time;
+		bool realTime;
+	};
+	void m_Update(const Callback &callback);
+
+	// Shared time base of the audio and game thread
+	Timer m_timer;
+	uint32 m_sampleRate = 44100;
+	uint64 m_numCallbacks = 0;
+	SeqLock<Callback> m_lastCallback;
+
+	// Filter state, only used by readers
+	std::mutex m_filterLock;
+	uint64 m_filteredCallback = 0;
+	// Frame heard at m_filterTime and the estimated rate of the device
+	double m_filterPosition = 0.0;
+	double m_filterTime = 0.0;
+	double m_framesPerSecond = 0.0;
+	double m_lastHeard = 0.0;
+	AudioClockStats m_stats;
+};
@@ -6,10 +6,36 @@ public:
 	virtual void Mix(void* data, uint32& numSamples) = 0;
 };
 
+/*
+	Interface for anything that consumes mixed audio
+*/
+class IAudioOutput
+{
+public:
+	virtual ~IAudioOutput() = default;
+
+	// Safe to start mixing
+	virtual void Start(IMixer* mixer) = 0;
+	// Should stop mixing, the mixer is no longer called after this returns
+	virtual void Stop() = 0;
+
+	virtual uint32_t GetNumChannels() const = 0;
+	virtual uint32_t GetSampleRate() const = 0;
+
+	// The actual length of the buffer in seconds
+	virtual double GetBufferLength() const = 0;
+	// Time between the start of the audio handed to the mixer and it being heard, in seconds
+	//	only called from inside Mix
+	virtual double GetLatency() const { return GetBufferLength(); }
+	// Whether the audio is consumed at the pace of a device, otherwise it counts as heard as soon as it is mixed
+	virtual bool IsRealTime() const { return true; }
+	virtual bool IsIntegerFormat() const = 0;
+};
+
 /*
 	Low level audio output
 */
-class AudioOutput : public Unique
+class AudioOutput : public IAudioOutput, public Unique
 {
 public:
 	AudioOutput();
@@ -17,17 +43,15 @@ public:
 
 	bool Init(bool exclusive);
 
-	// Safe to start mixing
-	void Start(IMixer* mixer);
-	// Should stop mixing
-	void Stop();
+	void Start(IMixer* mixer) override;
+	void Stop() override;
 
-	uint32_t GetNumChannels() const;
-	uint32_t GetSampleRate() const;
+	uint32_t GetNumChannels() const override;
+	uint32_t GetSampleRate() const override;
 
-	// The actual length of the buffer in seconds
-	double GetBufferLength() const;
-	bool IsIntegerFormat() const;
+	double GetBufferLength() const override;
+	double GetLatency() const override;
+	bool IsIntegerFormat() const override;
 
 private:
 	class AudioOutput_Impl* m_impl;
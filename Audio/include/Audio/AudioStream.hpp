@@ -11,7 +11,19 @@ class AudioStream : public AudioBase
 {
 public:
 	static Ref<AudioStream> Create(Audio *audio, const String &path, bool preload);
+	// Decodes the whole file into memory without using the pcm cache
+	//	the stream isn't registered with the mixer so it can't be played, used for analysing songs
+	static Ref<AudioStream> Decode(Audio *audio, const String &path);
 	static Ref<AudioStream> Clone(Audio *audio, Ref<AudioStream> source);
+	// Decodes only length milliseconds starting at start into memory, position 0 of the stream is at start
+	//	used for previews, which never play the rest of the file
+	static Ref<AudioStream> CreateWindow(Audio *audio, const String &path, int32 start, int32 length);
+	// Loads audio derived from the file at path (e.g. with pre-rendered effects) from the pcm cache
+	//	variant identifies the derived audio, variantKey should include everything it depends on
+	//	nullptr if not cached or cached with a different key
+	static Ref<AudioStream> LoadVariant(Audio *audio, const String &path, const String &variant, const String &variantKey);
+	// Stores the pcm data of stream in the pcm cache so it can be loaded with LoadVariant, replacing the one stored with an older key
+	static void StoreVariant(Audio *audio, const String &path, const String &variant, const String &variantKey, Ref<AudioStream> stream);
 	virtual ~AudioStream() = default;
 	// Starts playback of the stream or continues a paused stream
 	virtual void Play() = 0;
@@ -20,4 +32,8 @@ public:
 	// Sets the playback position in milliseconds
 	// negative time alowed, which will produce no audio for a certain amount of time
 	virtual void SetPosition(int32 pos) = 0;
+	// Waits up to timeout milliseconds until a stream decoded on a separate thread has as much audio ahead of the play position as it buffers
+	//	seeks are only performed once the stream is mixed again, used to render the stream without underruns in tests and offline rendering
+	//	returns false on timeout, true right away for streams without a decode thread
+	virtual bool WaitForDecoding(uint32 timeout) = 0;
 };
@@ -0,0 +1,122 @@
+#pragma once
+#include "CommandQueue.hpp"
+#include <Shared/File.hpp>
+#include <atomic>
+#include <array>
+
+/*
+	Timing of a single output callback
+*/
+struct AudioCallbackRecord
+{
+	// Seconds since the telemetry was created
+	double time;
+	// Frames the output asked for and the length of the rendered blocks
+	uint32 numFrames;
+	uint32 blockSize;
+	// Items that were rendered
+	uint32 numItems;
+	// Time spent in the callback and the time the audio it produced lasts
+	uint32 callbackMicroseconds;
+	uint32 periodMicroseconds;
+	// Streams that output silence in this callback because the game thread held their lock
+	uint32 numLockMisses;
+};
+
+/*
+	Time spent in one kind of item or DSP, identified by its name
+*/
+struct AudioCost
+{
+	std::atomic<const char *> name = {nullptr};
+	std::atomic<uint64> numCalls = {0};
+	std::atomic<uint64> totalNanoseconds = {0};
+	std::atomic<uint64> maxNanoseconds = {0};
+};
+
+// Copy of an AudioCost for displaying
+struct AudioCostStats
+{
+	const char *name;
+	uint64 numCalls;
+	double averageMicroseconds;
+	double maxMicroseconds;
+	// Share of the time spent in callbacks
+	double percent;
+};
+
+/*
+	Copy of the mixer statistics and telemetry counters for displaying, see Audio::GetMixerStats
+*/
+struct AudioMixerStats
+{
+	// Length of the last rendered block in frames
+	uint32 blockSize = 0;
+	uint64 maxBlockMicroseconds = 0;
+	// Smallest amount of time a callback had left, INT64_MAX before the first callback
+	int64 minMarginMicroseconds = INT64_MAX;
+	uint64 numXruns = 0;
+	uint64 totalCallbackMicroseconds = 0;
+	// Sorted by the total time spent in them
+	Vector<AudioCostStats> itemCosts;
+	Vector<AudioCostStats> dspCosts;
+	uint64 numLockMisses = 0;
+	uint64 totalLockWaitMicroseconds = 0;
+	uint64 maxLockWaitMicroseconds = 0;
+	uint64 numDroppedRecords = 0;
+	uint64 numDroppedDSPEvents = 0;
+};
+
+/*
+	Measurements of the audio thread, collected without locking so they can stay enabled during gameplay
+	Costs and counters can be read from any thread, callback records are written to a csv file by the game thread
+*/
+class AudioTelemetry
+{
+public:
+	constexpr static uint32 maxCosts = 32;
+	constexpr static uint32 maxRecords = 1024;
+
+	AudioTelemetry();
+	~AudioTelemetry();
+
+	// Adds the time one item or DSP took, only called by the audio thread
+	//	names are compared by address first so GetName should return a literal
+	void AddCost(std::array<AudioCost, maxCosts> &costs, const char *name, uint64 nanoseconds);
+	// Called by the audio thread at the end of every callback
+	void AddCallback(const AudioCallbackRecord &record);
+	// Called by the game thread after it waited for the audio thread
+	void AddLockWait(uint64 microseconds);
+
+	// Starts writing a line for every callback to a csv file at path, an empty path stops writing
+	void SetCsvPath(const String &path);
+	// Writes the callbacks that happened since the last call, called by the game thread
+	void Update();
+
+	// Costs sorted by the total time spent in them, sum of all callbacks is needed to compute their share
+	Vector<AudioCostStats> GetCosts(const std::array<AudioCost, maxCosts> &costs, uint64 totalCallbackMicroseconds) const;
+
+	// Seconds since the telemetry was created
+	double GetTime() const;
+
+	std::array<AudioCost, maxCosts> itemCosts;
+	std::array<AudioCost, maxCosts> dspCosts;
+
+	// Blocks streams skipped because their lock was held
+	std::atomic<uint64> numLockMisses = {0};
+	// Time the game thread spent waiting for the audio thread to release the render state
+	std::atomic<uint64> totalLockWaitMicroseconds = {0};
+	std::atomic<uint64> maxLockWaitMicroseconds = {0};
+	// Callbacks that weren't written to the csv file because the queue was full
+	std::atomic<uint64> numDroppedRecords = {0};
+	// Scheduled DSP changes that were dropped because the queue to the audio thread was full
+	std::atomic<uint64> numDroppedDSPEvents = {0};
+
+private:
+	Timer m_timer;
+	std::atomic<bool> m_recording = {false};
+	CommandQueue<AudioCallbackRecord, maxRecords> m_records;
+	// Only used by the game thread
+	File m_csvFile;
+	bool m_csvOpen = false;
+};
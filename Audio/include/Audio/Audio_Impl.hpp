@@ -1,19 +1,62 @@
 #pragma once
 #include "AudioOutput.hpp"
 #include "AudioBase.hpp"
+#include "Resampler.hpp"
+#include "PcmCache.hpp"
+#include "AudioClock.hpp"
+#include "AudioTelemetry.hpp"
 
 #include <array>
 
 // Threading
 #include <thread>
 #include <mutex>
+#include <atomic>
 using std::thread;
 using std::mutex;
 
+/*
+	Immutable copy of everything the audio thread renders
+	A new one is published whenever an item or DSP is added or removed so the audio thread never has to lock
+*/
+struct AudioRenderState
+{
+	struct Item
+	{
+		AudioBase* audio;
+		Vector<DSP*> DSPs;
+	};
+	Vector<Item> items;
+	Vector<DSP*> globalDSPs;
+};
+
+/*
+	Statistics about the audio callback, updated by the audio thread
+*/
+struct AudioCallbackStats
+{
+	std::atomic<uint64> numCallbacks = { 0 };
+	// Total number of frames handed to the output
+	std::atomic<uint64> numFramesMixed = { 0 };
+	// Longest time spent in a single callback
+	std::atomic<uint64> maxCallbackMicroseconds = { 0 };
+	// Total time spent in callbacks
+	std::atomic<uint64> totalCallbackMicroseconds = { 0 };
+	// Longest time spent rendering a single block
+	std::atomic<uint64> maxBlockMicroseconds = { 0 };
+	// Smallest amount of time a callback had left before the audio it produced would have run out
+	std::atomic<int64> minMarginMicroseconds = { INT64_MAX };
+	// Callbacks that took longer than the audio they produced, the device most likely ran dry
+	std::atomic<uint64> numXruns = { 0 };
+	// Length of the last rendered block in frames
+	std::atomic<uint32> blockSize = { 0 };
+};
+
 class Audio_Impl : public IMixer
 {
 public:
 	Audio_Impl();
+	~Audio_Impl();
 
 	void Start();
 	void Stop();
@@ -22,32 +65,72 @@ public:
 	// Registers an AudioBase to be rendered
 	void Register(AudioBase* audio);
 	// Removes an AudioBase so it is no longer rendered
+	// after this returns the audio thread no longer references the item or its DSPs
 	void Deregister(AudioBase* audio);
 
+	// Publishes itemsToRender, their DSPs and globalDSPs to the audio thread
+	// must be called with lock held, waits for the audio thread to stop using the previous state
+	void PublishRenderState();
+	// True if audio is part of the block that is being mixed, it can't be freed before the block is done
+	//	only called by the audio thread
+	bool IsMixing(const AudioBase* audio) const;
+
 	uint32 GetSampleRate() const;
 	double GetSecondsPerSample() const;
 
 	float globalVolume = 1.0f;
+	// Resampler used by streams, picked up on their next block
+	std::atomic<ResamplerQuality> resamplerQuality = { ResamplerQuality::Linear };
+	// Amount of audio decoded ahead by streams that are not preloaded, in milliseconds
+	std::atomic<uint32> streamReadAhead = { 500 };
+	// Store preloaded streams as 16-bit instead of float, applies to new streams
+	std::atomic<bool> compactPcm = { false };
+	// Report the position that is being heard instead of the one being mixed, see Audio::SetLatencyCompensation
+	std::atomic<bool> compensateLatency = { false };
+	// Number of frames rendered at once, 0 renders exactly what the output asks for in each callback
+	std::atomic<uint32> mixBlockSize = { 0 };
+
+	constexpr static uint32 minBlockSize = 64;
+	constexpr static uint32 maxBlockSize = 4096;
 
+	// Guards modifications to itemsToRender, globalDSPs and AudioBase::DSPs
+	// never taken by the audio thread, which only reads the published render state
 	mutex lock;
 	Vector<AudioBase*> itemsToRender;
 	Vector<DSP*> globalDSPs;
 
+	AudioCallbackStats stats;
+	// Cost of items and DSPs, lock waits and a record of every callback
+	AudioTelemetry telemetry;
+	// Position of the audio that is being heard
+	AudioClock clock;
+	// Decoded audio of preloaded streams
+	PcmCache pcmCache;
+
 	class LimiterDSP* limiter = nullptr;
 	uint32 m_remainingSamples = 0;
+	// Frames mixed before the block that is being rendered, only used by the audio thread
+	uint64 mixPosition = 0;
 
 	thread audioThread;
 	bool runAudioThread = false;
-	AudioOutput* output = nullptr;
+	IAudioOutput* output = nullptr;
 
 protected:
 	// Used to limit rendering to a fixed number of samples
-	constexpr static uint32 m_sampleBufferLength = 384;
-	std::array<float, 2*m_sampleBufferLength> m_sampleBuffer;
+	std::array<float, 2 * maxBlockSize> m_sampleBuffer;
+	// Number of frames in m_sampleBuffer
+	uint32 m_sampleBufferLength = 0;
 	
 private:
+	std::atomic<AudioRenderState*> m_renderState = { nullptr };
+	// State used by the block that is being mixed, only touched by the audio thread
+	const AudioRenderState* m_mixState = nullptr;
+	// Incremented when the audio thread starts and finishes rendering a block, odd while rendering
+	std::atomic<uint64> m_renderEpoch = { 0 };
+
 	alignas(sizeof(float))
-	std::array<float, 2 * m_sampleBufferLength> m_itemBuffer;
+	std::array<float, 2 * maxBlockSize> m_itemBuffer;
 
 	// Check memory corruption during filling m_itemBuffer
 #if _DEBUG
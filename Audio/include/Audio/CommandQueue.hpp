@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+
+/*
+	Fixed size queue passing commands from one producer thread to one consumer thread without locking
+	Used to hand requests from the game thread to the audio thread
+*/
+template <typename T, uint32 capacity>
+class CommandQueue
+{
+public:
+	// Adds a command, returns false if the queue is full
+	//	only called by the producer
+	bool Push(const T &command)
+	{
+		const uint32 writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+		if (writeIndex - m_readIndex.load(std::memory_order_acquire) >= capacity)
+			return false;
+		m_commands[writeIndex % capacity] = command;
+		m_writeIndex.store(writeIndex + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Takes the oldest command, returns false if the queue is empty
+	//	only called by the consumer
+	bool Pop(T &command)
+	{
+		const uint32 readIndex = m_readIndex.load(std::memory_order_relaxed);
+		if (readIndex == m_writeIndex.load(std::memory_order_acquire))
+			return false;
+		command = m_commands[readIndex % capacity];
+		m_readIndex.store(readIndex + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Whether commands are waiting for the consumer, can be called from any thread
+	bool IsEmpty() const
+	{
+		return m_readIndex.load(std::memory_order_acquire) == m_writeIndex.load(std::memory_order_acquire);
+	}
+
+private:
+	T m_commands[capacity];
+	std::atomic<uint32> m_writeIndex = {0};
+	std::atomic<uint32> m_readIndex = {0};
+};
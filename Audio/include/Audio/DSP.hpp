@@ -3,6 +3,7 @@
 */
 #pragma once
 #include "AudioBase.hpp"
+#include "StereoBQF.hpp"
 #include <Shared/Interpolation.hpp>
 
 // Biquad Filter
@@ -38,6 +39,7 @@ public:
 	float panning = 0.0f;
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "PanDSP"; }
+	virtual String GetKey() const;
 };
 
 class BQFDSP : public DSP
@@ -47,6 +49,7 @@ public:
 
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "BQFDSP"; }
+	virtual String GetKey() const;
 
 	// Sets the filter parameters
 	void SetPeaking(float q, float freq, float gain);
@@ -54,7 +57,7 @@ public:
 	void SetHighPass(float q, float freq);
 
 private:
-	BQF m_filters[2];
+	StereoBQF m_filter;
 };
 
 // Combinded Low/High-pass and Peaking filter
@@ -65,6 +68,7 @@ public:
 	void SetLowPass(float q, float freq, float peakQ, float peakGain);
 	void SetHighPass(float q, float freq, float peakQ, float peakGain);
 	virtual const char *GetName() const { return "CombinedFilterDSP"; }
+	virtual String GetKey() const;
 
 	virtual void Process(float *out, uint32 numSamples);
 
@@ -82,6 +86,7 @@ public:
 	float releaseTime = 0.1f;
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "LimiterDSP"; }
+	virtual String GetKey() const;
 
 private:
 	float m_currentMaxVolume = 1.0f;
@@ -97,6 +102,7 @@ public:
 	void SetPeriod(float period = 0);
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "BitCrusherDSP"; }
+	virtual String GetKey() const;
 
 private:
 	uint32 m_period = 1;
@@ -119,6 +125,7 @@ public:
 
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "GateDSP"; }
+	virtual String GetKey() const;
 
 private:
 	float m_gating = 0.5f;
@@ -138,6 +145,7 @@ public:
 
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "TapeStopDSP"; }
+	virtual String GetKey() const;
 
 private:
 	uint32 m_length = 0;
@@ -158,6 +166,8 @@ public:
 
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "RetriggerDSP"; }
+	virtual String GetKey() const;
+	virtual uint32 GetReadMargin() const;
 
 private:
 	float m_gating = 0.75f;
@@ -183,9 +193,10 @@ public:
 
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "WobbleDSP"; }
+	virtual String GetKey() const;
 
 private:
-	BQF m_filters[2];
+	StereoBQF m_filter;
 	uint32 m_length{};
 	uint32 m_currentSample = 0;
 };
@@ -208,13 +219,14 @@ public:
 
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "PhaserDSP"; }
+	virtual String GetKey() const;
 
 private:
 	uint32 m_length = 0;
 	uint32 m_stage = 6;
-	BQF m_apf[12][2];
-	BQF m_hiShelf[2];
-	float za[2] = {0.0f};
+	// All-pass stages with feedback
+	StereoBQF m_apf;
+	StereoBQF m_hiShelf;
 	uint32 m_currentSample = 0;
 };
 
@@ -231,6 +243,7 @@ public:
 
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "FlangerDSP"; }
+	virtual String GetKey() const;
 
 private:
 	uint32 m_length = 0;
@@ -260,6 +273,7 @@ public:
 
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "EchoDSP"; }
+	virtual String GetKey() const;
 
 private:
 	uint32 m_bufferLength = 0;
@@ -282,6 +296,7 @@ public:
 
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "SidechainDSP"; }
+	virtual String GetKey() const;
 
 private:
 	uint32 m_length = 0;
@@ -303,6 +318,7 @@ public:
 
 	virtual void Process(float *out, uint32 numSamples);
 	virtual const char *GetName() const { return "PitchShiftDSP"; }
+	virtual String GetKey() const;
 
 private:
 	class PitchShiftDSP_Impl *m_impl;
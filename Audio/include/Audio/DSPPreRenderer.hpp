@@ -0,0 +1,72 @@
+#pragma once
+#include "AudioStream.hpp"
+#include <Shared/Jobs.hpp>
+
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/*
+	Applies DSPs to the pcm data of a preloaded stream ahead of time
+	Effects are grouped into clusters of overlapping time ranges, clusters don't depend on each other
+	and are rendered in parallel by the job sheduler, starting with the earliest one
+	The pcm data is modified in place so the stream can already play parts that are finished
+*/
+class DSPPreRenderer : Unique
+{
+public:
+	// Takes ownership of the DSPs, which should be sorted with DSP::Sorter
+	DSPPreRenderer(Ref<AudioStream> stream, Vector<DSP*> DSPs);
+	// Stops rendering and waits for running jobs
+	~DSPPreRenderer();
+
+	// Queues jobs that render all clusters, sheduler may be nullptr to only render in WaitUntil
+	void Start(JobSheduler* sheduler);
+
+	// Blocks until all effects starting before time are rendered, helps rendering those while waiting
+	// onProgress is called with the fraction of rendered clusters
+	void WaitUntil(uint32 time, const std::function<void(float)>& onProgress = nullptr);
+	// Blocks until everything is rendered
+	void Wait(const std::function<void(float)>& onProgress = nullptr);
+
+	// Time up to which all effects are rendered
+	uint32 GetRenderedUntil() const;
+	float GetProgress() const;
+	bool IsFinished() const;
+
+	uint32 GetNumClusters() const { return (uint32)m_clusters.size(); }
+
+	// Called once everything is rendered, from the thread that rendered the last cluster
+	std::function<void()> onFinished;
+
+	// Renders a single DSP over its time range
+	static void RenderDSP(AudioBase* audio, DSP* dsp);
+
+private:
+	struct Cluster
+	{
+		uint32 startTime;
+		Vector<DSP*> DSPs;
+	};
+
+	// Renders the next cluster that isn't claimed yet if it starts before time, false if there is none
+	bool m_RenderNext(uint32 time = UINT32_MAX);
+
+	Ref<AudioStream> m_stream;
+	Vector<DSP*> m_DSPs;
+	// Sorted by start time
+	Vector<Cluster> m_clusters;
+	std::atomic<uint32> m_nextCluster = { 0 };
+	std::atomic<bool> m_cancel = { false };
+	Vector<Job> m_jobs;
+	Timer m_timer;
+
+	// Guards the completion state below
+	mutable std::mutex m_lock;
+	std::condition_variable m_clusterDone;
+	Vector<bool> m_done;
+	uint32 m_numDone = 0;
+	// Index of the first cluster that isn't done yet
+	uint32 m_firstPending = 0;
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <complex>
+
+/*
+	Radix-2 fast fourier transform of a fixed size
+	The twiddle factors and bit reversal table are computed once so many transforms of the same size are cheap
+*/
+class FFT
+{
+public:
+	// size should be a power of two
+	FFT(uint32 size);
+
+	// Transforms size values in place
+	//	inverse computes the inverse transform, including the division by size
+	void Transform(std::complex<float> *data, bool inverse = false) const;
+
+	uint32 GetSize() const { return m_size; }
+
+	// Smallest power of two that is at least size
+	static uint32 GetPowerOfTwo(uint32 size);
+
+private:
+	uint32 m_size;
+	Vector<std::complex<float>> m_twiddles;
+	Vector<uint32> m_reversed;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include "AudioOutput.hpp"
+
+#include <thread>
+#include <atomic>
+
+/*
+	Audio output that doesn't need a sound card
+	pulls the mixer either manually, as fast as possible or at real-time pace and writes the result to a wav file
+*/
+class FileAudioOutput : public IAudioOutput, public Unique
+{
+public:
+	enum class Pacing
+	{
+		// Only renders when Render is called
+		Manual,
+		// Renders on a separate thread as fast as possible
+		FreeRunning,
+		// Renders on a separate thread at the same rate a sound card would consume the audio
+		RealTime,
+	};
+
+	FileAudioOutput(uint32 sampleRate = 48000, Pacing pacing = Pacing::Manual, uint32 blockSize = 1024);
+	~FileAudioOutput();
+
+	// Opens a wav file (32-bit float stereo) to write the rendered audio to
+	// when no file is opened the rendered audio is discarded
+	bool Open(const String& path);
+	// Finalizes the wav header and closes the file
+	void Close();
+
+	// Manually renders a number of frames, only valid with Pacing::Manual
+	// returns the number of frames rendered
+	uint64 Render(uint64 numFrames);
+
+	// Total number of frames rendered so far
+	uint64 GetFramesRendered() const { return m_framesRendered; }
+	// Seconds of cpu time spent inside the mixer
+	double GetMixTime() const { return m_mixTime; }
+
+	void Start(IMixer* mixer) override;
+	void Stop() override;
+
+	uint32_t GetNumChannels() const override { return 2; }
+	uint32_t GetSampleRate() const override { return m_sampleRate; }
+	double GetBufferLength() const override { return (double)m_blockSize / (double)m_sampleRate; }
+	// Only real-time pacing pretends to have a device buffer
+	double GetLatency() const override { return m_pacing == Pacing::RealTime ? GetBufferLength() : 0.0; }
+	// The clock follows the rendered frames instead of the time, unless rendering at real-time pace
+	bool IsRealTime() const override { return m_pacing == Pacing::RealTime; }
+	bool IsIntegerFormat() const override { return false; }
+
+private:
+	void m_RenderBlock(uint32 numFrames);
+	void m_WriteHeader();
+	void m_ThreadMain();
+
+	uint32 m_sampleRate;
+	uint32 m_blockSize;
+	Pacing m_pacing;
+
+	IMixer* m_mixer = nullptr;
+	Vector<float> m_buffer;
+	File m_file;
+	bool m_fileOpen = false;
+	uint64 m_framesWritten = 0;
+
+	std::atomic<uint64> m_framesRendered = { 0 };
+	double m_mixTime = 0.0;
+
+	std::thread m_thread;
+	std::atomic<bool> m_running = { false };
+};
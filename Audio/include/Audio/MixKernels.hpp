@@ -0,0 +1,29 @@
+#pragma once
+
+/*
+	Sample processing kernels used by the mixer
+	Multiple implementations exist (scalar, SSE2, AVX2, NEON), the best one supported by the cpu is picked at startup
+*/
+struct MixKernels
+{
+	// Name of the implementation
+	const char *name;
+
+	// dst[i] += src[i] * gain, for count floats
+	void (*Accumulate)(float *dst, const float *src, float gain, uint32 count);
+	// buffer[i] = clamp(buffer[i] * gain, -1, 1), for count floats
+	void (*GainClamp)(float *buffer, float gain, uint32 count);
+
+	// Writes stereo frames into an interleaved output buffer with numChannels channels
+	// channels above 2 are left untouched
+	void (*InterleaveFloat)(float *dst, const float *src, uint32 numFrames, uint32 numChannels);
+	// Same as InterleaveFloat but converts to signed 16-bit, the input is expected to be in [-1, 1]
+	void (*InterleaveInt16)(int16 *dst, const float *src, uint32 numFrames, uint32 numChannels);
+	// dst[i] = src[i] / 0x7FFF, for count values, used to read compact pcm data
+	void (*Int16ToFloat)(float *dst, const int16 *src, uint32 count);
+
+	// Kernels selected for the current cpu
+	static const MixKernels &Get();
+	// All implementations supported by the current cpu, the scalar fallback comes first
+	static Vector<const MixKernels *> GetSupported();
+};
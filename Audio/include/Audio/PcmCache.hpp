@@ -0,0 +1,122 @@
+#pragma once
+#include <Shared/MappedFile.hpp>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Sample format of cached pcm data
+enum class PcmCacheFormat : uint32
+{
+	Float32 = 0,
+	// Signed 16-bit, halves the size of the data
+	Int16 = 1,
+};
+// Size of a single sample in bytes
+inline uint32 GetPcmSampleSize(PcmCacheFormat format)
+{
+	return format == PcmCacheFormat::Int16 ? sizeof(int16) : sizeof(float);
+}
+
+/*
+	Header at the start of every cache file, followed by interleaved stereo frames
+*/
+struct PcmCacheHeader
+{
+	static constexpr uint32 currentVersion = 3;
+
+	char magic[4];
+	uint32 version;
+	PcmCacheFormat format;
+	uint32 numChannels;
+	// Rate of the stored pcm data
+	uint32 sampleRate;
+	// Output rate of the audio device when the file was decoded
+	uint32 outputRate;
+	uint64 numFrames;
+	// Identifies the contents of the source file
+	uint64 sourceSize;
+	uint64 sourceHash;
+	// Hash of the key describing how a variant was made, 0 for the decoded file itself
+	uint64 variantHash;
+	uint8 reserved[8];
+};
+static_assert(sizeof(PcmCacheHeader) == 64, "Cache header size should keep pcm data aligned");
+
+/*
+	On-disk cache of decoded audio files
+	Entries are keyed on a hash of the source file contents, the output rate and variant
+	a variant stored again with a different key replaces the old entry
+	and are memory mapped when loaded, new entries are hashed and written on a background thread
+	The total size is limited by evicting the least recently used entries, entries that are still mapped are kept until released
+*/
+class PcmCache : Unique
+{
+public:
+	~PcmCache();
+
+	// Sets the folder to store cached files in, a maximum size of 0 disables the cache
+	void Configure(const String& directory, uint64 maxSize);
+	bool IsEnabled() const;
+
+	// Maps the cached pcm data for the file at path, nullptr if not cached
+	//	variant separates audio derived from the same file, empty for the decoded file itself
+	//	variantKey describes how the variant was made, entries stored with a different key are not loaded
+	//	the cache should outlive the returned mapping
+	Ref<MappedFile> Load(const String& path, uint32 outputRate, PcmCacheFormat format, PcmCacheHeader& header, const String& variant = String(), const String& variantKey = String());
+	// Queues decoded pcm data to be written to the cache without copying it
+	//	owner keeps pcm alive until it is written, the data should not be modified in the meantime
+	void Store(const String& path, uint32 outputRate, PcmCacheFormat format, const void* pcm, uint64 numFrames, uint32 sampleRate, Ref<void> owner, const String& variant = String(), const String& variantKey = String());
+	// Waits until all queued entries are written
+	void Flush();
+
+private:
+	struct Entry
+	{
+		uint64 size;
+		uint64 lastUsed;
+	};
+	struct PendingWrite
+	{
+		String path;
+		uint32 outputRate;
+		PcmCacheFormat format;
+		String variant;
+		String variantKey;
+		const void* pcm;
+		uint64 numFrames;
+		uint32 sampleRate;
+		Ref<void> owner;
+	};
+
+	String m_GetFilePath(const String& name) const;
+	bool m_MakeHeader(const String& path, uint32 outputRate, PcmCacheFormat format, const String& variant, const String& variantKey, PcmCacheHeader& header, String& name) const;
+	// Checks if the entry stored in name is the same as header, ignoring the number of frames
+	bool m_IsSameEntry(const String& name, const PcmCacheHeader& header) const;
+	void m_WriterMain();
+	// Returns the size of the written entry, 0 if it was not written
+	uint64 m_Write(const PendingWrite& write, const String& name, const PcmCacheHeader& header);
+	// Removes the least recently used entries that are not mapped until the cache fits in m_maxSize, call with m_lock held
+	void m_Evict();
+	// Called when a mapping returned by Load is destroyed
+	void m_Release(const String& filePath);
+	void m_LoadIndex();
+	void m_SaveIndex();
+
+	String m_directory;
+	uint64 m_maxSize = 0;
+
+	// Guards everything below
+	mutable std::mutex m_lock;
+	std::condition_variable m_signal;
+	// Notified when the writer finishes a queued entry
+	std::condition_variable m_written;
+	Map<String, Entry> m_entries;
+	// Number of mappings of each file returned by Load, by full path so it stays valid when the cache is reconfigured
+	Map<String, uint32> m_mapped;
+	Vector<PendingWrite> m_pending;
+	bool m_writing = false;
+	bool m_indexDirty = false;
+	bool m_stop = false;
+	std::thread m_writer;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+DefineEnum(ResamplerQuality,
+	Fast,
+	Linear,
+	Sinc)
+
+/*
+	Stereo sample rate converter used by audio streams
+	Input frames are pushed one at a time, output is interpolated at a fractional position after the newest frame
+	Fast picks the newest frame, Linear interpolates between the last 2 frames (1 frame delay)
+	and Sinc uses a band-limited polyphase filter over the last numTaps frames (numTaps/2 frames delay)
+	Sinc filter tables are shared between resamplers and built on a separate thread, see Prepare
+*/
+class Resampler
+{
+public:
+	// Number of filter taps used by the sinc interpolator
+	static constexpr uint32 numTaps = 16;
+	// Number of precomputed filter phases between two input frames
+	static constexpr uint32 numPhases = 256;
+
+	// Filter coefficients for one cutoff, (numPhases + 1) rows of numTaps coefficients
+	struct Table
+	{
+		double cutoff;
+		Vector<float> coefficients;
+	};
+
+	Resampler();
+
+	// Builds the filter table used for ratio on the calling thread, so a resampler can use it from the first block
+	static void Prepare(double ratio);
+
+	// Clears the history, used after seeking
+	void Reset();
+
+	void SetQuality(ResamplerQuality quality);
+	ResamplerQuality GetQuality() const { return m_quality; }
+
+	// Sets the number of input frames consumed per output frame, safe to call from the audio thread
+	//	a table that isn't built yet is requested from the builder thread, the previous one is used until it is ready
+	//	the filter is bypassed when the ratio is exactly 1
+	void SetRatio(double ratio);
+
+	// Adds an input frame to the history
+	inline void Push(float l, float r)
+	{
+		m_writePos = (m_writePos + 1) % numTaps;
+		m_history[0][m_writePos] = l;
+		m_history[0][m_writePos + numTaps] = l;
+		m_history[1][m_writePos] = r;
+		m_history[1][m_writePos + numTaps] = r;
+	}
+
+	// Generates a stereo output frame at a fractional position in [0,1) relative to the newest frame
+	void Interpolate(float fraction, float* out) const;
+
+private:
+	// Picks up the table for m_cutoff if it's ready
+	void m_UpdateTable();
+
+	ResamplerQuality m_quality = ResamplerQuality::Fast;
+	// Filter cutoff relative to the input nyquist frequency
+	double m_cutoff = 0.0;
+	// Input and output rate match, nothing has to be filtered
+	bool m_bypass = false;
+
+	// History is stored twice so the last numTaps frames are always contiguous in memory
+	alignas(16) float m_history[2][numTaps * 2];
+	uint32 m_writePos = 0;
+
+	// Table for m_cutoff, or the previous one while it's being built, nullptr if there is none yet
+	const Table* m_table = nullptr;
+};
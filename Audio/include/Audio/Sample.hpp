@@ -16,9 +16,17 @@ public:
 	virtual uint32 GetNumChannels() const = 0;
 
 	// Plays this sample from the start
+	//	plays overlap with the ones that are still playing, a looping play stops all others
+	//	Play and Stop should be called from a single thread
 	virtual void Play(bool looping = false) = 0;
+	// Plays this sample from the start when clock reaches samplePos, the mixer starts it at the exact frame
+	//	plays right away if samplePos was already reached, dropped when clock is removed or seeks before that
+	virtual void PlayAt(AudioBase *clock, int64 samplePos, bool looping = false) = 0;
 	virtual void Stop() = 0;
 	virtual bool IsPlaying() const = 0;
+
+	// Sets how many plays can be heard at the same time, the oldest one is cut off when another one starts
+	virtual void SetMaxVoices(uint32 maxVoices) = 0;
 };
 
 typedef Ref<SampleRes> Sample;
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <string.h>
+
+/*
+	Value written by one thread and read by any other thread without locking
+	Readers retry when they catch the writer in the middle of an update, so T should be small and trivially copyable
+*/
+template <typename T>
+class SeqLock
+{
+public:
+	// Replaces the value, only called by the writer
+	void Store(const T &value)
+	{
+		const uint32 sequence = m_sequence.load(std::memory_order_relaxed);
+		// Odd while writing
+		m_sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		memcpy(&m_value, &value, sizeof(T));
+		m_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	// Copy of the last value that was stored completely
+	T Load() const
+	{
+		T value;
+		uint32 before, after;
+		do
+		{
+			before = m_sequence.load(std::memory_order_acquire);
+			memcpy(&value, &m_value, sizeof(T));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = m_sequence.load(std::memory_order_relaxed);
+		} while ((before & 1) || before != after);
+		return value;
+	}
+
+private:
+	std::atomic<uint32> m_sequence = {0};
+	T m_value = {};
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+class BQF;
+
+/*
+	Cascade of identical biquad filters for interleaved stereo, in transposed direct form II
+	Both channels are filtered at the same time using SIMD, each channel can have its own coefficients
+	Coefficient changes can be interpolated over a block so modulated filters don't need new coefficients for every sample
+*/
+class StereoBQF
+{
+public:
+	static constexpr uint32 maxStages = 12;
+
+	// Sets the number of filters in series, they all use the same coefficients
+	void SetNumStages(uint32 numStages);
+	uint32 GetNumStages() const { return m_numStages; }
+
+	// Sets the coefficients of each channel from a filter design
+	//	with interpolate the coefficients move linearly to the new values during the next call to Process
+	void SetCoefficients(const BQF &left, const BQF &right, bool interpolate = false);
+	void SetCoefficients(const BQF &both, bool interpolate = false);
+
+	// Filters frames of interleaved stereo in place
+	//	feedback mixes the previous output of the cascade into its input
+	void Process(float *out, uint32 numFrames, float feedback = 0.0f);
+
+	// Clears the filter state
+	void Reset();
+
+	// Describes the coefficients and number of stages, used in the keys of DSPs
+	String GetKey() const;
+
+private:
+	// Normalized coefficients, for the left and right channel
+	struct Coefficients
+	{
+		float b0[2] = {1.0f, 1.0f};
+		float b1[2] = {0.0f, 0.0f};
+		float b2[2] = {0.0f, 0.0f};
+		float a1[2] = {0.0f, 0.0f};
+		float a2[2] = {0.0f, 0.0f};
+	};
+	Coefficients m_current;
+	Coefficients m_target;
+	bool m_interpolate = false;
+	bool m_initialized = false;
+
+	uint32 m_numStages = 1;
+	// Delay elements of every stage
+	float m_z1[maxStages][2] = {};
+	float m_z2[maxStages][2] = {};
+	float m_lastOutput[2] = {0.0f, 0.0f};
+};
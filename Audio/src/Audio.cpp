@@ -4,6 +4,7 @@
 #include "Audio_Impl.hpp"
 #include "AudioOutput.hpp"
 #include "DSP.hpp"
+#include "MixKernels.hpp"
 
 Audio *g_audio = nullptr;
 static Audio_Impl g_impl;
@@ -13,113 +14,186 @@ Audio_Impl::Audio_Impl()
 #if _DEBUG
 	InitMemoryGuard();
 #endif
+	m_renderState = new AudioRenderState();
+}
+Audio_Impl::~Audio_Impl()
+{
+	delete m_renderState.load();
 }
 
 void Audio_Impl::Mix(void *data, uint32 &numSamples)
 {
-	double adv = GetSecondsPerSample();
+	Timer callbackTimer;
+	const MixKernels &kernels = MixKernels::Get();
 
 	uint32 outputChannels = this->output->GetNumChannels();
-	if (output->IsIntegerFormat())
-	{
-		memset(data, 0, numSamples * sizeof(int16) * outputChannels);
-	}
-	else
+	const bool integerFormat = output->IsIntegerFormat();
+
+	// Frames mixed ahead in m_sampleBuffer weren't handed to the output yet
+	clock.Publish(mixPosition - m_remainingSamples, numSamples, output->GetLatency(), output->IsRealTime());
+
+	// Only surround channels are not written to below
+	if (outputChannels != 2)
 	{
-		memset(data, 0, numSamples * sizeof(float) * outputChannels);
+		if (integerFormat)
+		{
+			memset(data, 0, numSamples * sizeof(int16) * outputChannels);
+		}
+		else
+		{
+			memset(data, 0, numSamples * sizeof(float) * outputChannels);
+		}
 	}
 
+	const uint64 lockMissesBefore = telemetry.numLockMisses.load(std::memory_order_relaxed);
+	uint32 numItems = 0;
 	uint32 currentNumberOfSamples = 0;
 	while (currentNumberOfSamples < numSamples)
 	{
 		// Generate new sample
 		if (m_remainingSamples <= 0)
 		{
+			Timer blockTimer;
+			const uint32 fixedBlockSize = mixBlockSize;
+			if (fixedBlockSize != 0)
+				m_sampleBufferLength = Math::Clamp(fixedBlockSize, minBlockSize, maxBlockSize);
+			else // Follow the device, nothing is left over for the next callback
+				m_sampleBufferLength = Math::Min(numSamples - currentNumberOfSamples, maxBlockSize);
+
 			// Clear sample buffer storing a fixed amount of samples
-			m_sampleBuffer.fill(0);
+			std::fill_n(m_sampleBuffer.begin(), m_sampleBufferLength * 2, 0.0f);
+
+			// Mark the render state as in use, writers wait for this to finish before freeing it
+			m_renderEpoch.fetch_add(1);
+			const AudioRenderState *state = m_renderState.load();
+			m_mixState = state;
 
 			// Render items
-			lock.lock();
-			for (auto &item : itemsToRender)
+			for (auto &item : state->items)
 			{
 				// Clear per-channel data
-				m_itemBuffer.fill(0);
-				item->Process(m_itemBuffer.data(), m_sampleBufferLength);
+				std::fill_n(m_itemBuffer.begin(), m_sampleBufferLength * 2, 0.0f);
+				Timer itemTimer;
+				item.audio->Process(m_itemBuffer.data(), m_sampleBufferLength);
+				telemetry.AddCost(telemetry.itemCosts, item.audio->GetName(), itemTimer.Nanoseconds());
 #if _DEBUG
 				CheckMemoryGuard();
 #endif
-				item->ProcessDSPs(m_itemBuffer.data(), m_sampleBufferLength);
+				// Split the block where scheduled changes to the DSPs happen
+				uint32 offset = 0;
+				while (offset < m_sampleBufferLength)
+				{
+					uint32 end = item.audio->ApplyScheduledEvents(item.DSPs, offset, m_sampleBufferLength);
+					for (DSP *dsp : item.DSPs)
+					{
+						// Make the DSP see the position it would have at this offset in a single call
+						if (offset > 0)
+							dsp->SetPreRenderPosition(item.audio->GetSamplePos() + offset);
+						Timer dspTimer;
+						dsp->Process(m_itemBuffer.data() + offset * 2, end - offset);
+						telemetry.AddCost(telemetry.dspCosts, dsp->GetName(), dspTimer.Nanoseconds());
+						if (offset > 0)
+							dsp->SetPreRenderPosition(-1);
+					}
+					offset = end;
+				}
 #if _DEBUG
 				CheckMemoryGuard();
 #endif
 
 				// Mix into buffer and apply volume scaling
-				for (uint32 i = 0; i < m_sampleBufferLength; i++)
-				{
-					m_sampleBuffer[i * 2 + 0] += m_itemBuffer[i * 2] * item->GetVolume();
-					m_sampleBuffer[i * 2 + 1] += m_itemBuffer[i * 2 + 1] * item->GetVolume();
-				}
+				kernels.Accumulate(m_sampleBuffer.data(), m_itemBuffer.data(), item.audio->GetVolume(), m_sampleBufferLength * 2);
 			}
 
 			// Process global DSPs
-			for (auto dsp : globalDSPs)
+			for (auto dsp : state->globalDSPs)
 			{
+				Timer dspTimer;
 				dsp->Process(m_sampleBuffer.data(), m_sampleBufferLength);
+				telemetry.AddCost(telemetry.dspCosts, dsp->GetName(), dspTimer.Nanoseconds());
 			}
-			lock.unlock();
+			numItems = (uint32)state->items.size();
+			m_mixState = nullptr;
+			m_renderEpoch.fetch_add(1);
+			mixPosition += m_sampleBufferLength;
 
-			// Apply volume levels
-			for (uint32 i = 0; i < m_sampleBufferLength; i++)
-			{
-				m_sampleBuffer[i * 2 + 0] *= globalVolume;
-				m_sampleBuffer[i * 2 + 1] *= globalVolume;
-				// Safety clamp to [-1, 1] that should help protect speakers a bit in case of corruption
-				// this will clip, but so will values outside [-1, 1] anyway
-				m_sampleBuffer[i * 2 + 0] = fmin(fmax(m_sampleBuffer[i * 2 + 0], -1.f), 1.f);
-				m_sampleBuffer[i * 2 + 1] = fmin(fmax(m_sampleBuffer[i * 2 + 1], -1.f), 1.f);
-			}
+			// Apply volume levels and clamp
+			kernels.GainClamp(m_sampleBuffer.data(), globalVolume, m_sampleBufferLength * 2);
 
 			// Set new remaining buffer data
 			m_remainingSamples = m_sampleBufferLength;
+
+			uint64 blockTime = blockTimer.Microseconds();
+			stats.blockSize = m_sampleBufferLength;
+			if (blockTime > stats.maxBlockMicroseconds)
+				stats.maxBlockMicroseconds = blockTime;
 		}
 
 		// Copy samples from sample buffer
+		// TODO: Mix to surround channels as well?
 		uint32 sampleOffset = m_sampleBufferLength - m_remainingSamples;
 		uint32 maxSamples = Math::Min(numSamples - currentNumberOfSamples, m_remainingSamples);
-		for (uint32 c = 0; c < outputChannels; c++)
+		const float *src = m_sampleBuffer.data() + sampleOffset * 2;
+		if (integerFormat)
 		{
-			if (c < 2)
-			{
-				for (uint32 i = 0; i < maxSamples; i++)
-				{
-					if (output->IsIntegerFormat())
-					{
-						((int16 *)data)[(currentNumberOfSamples + i) * outputChannels + c] = (int16)(0x7FFF * Math::Clamp(m_sampleBuffer[(sampleOffset + i) * 2 + c], -1.f, 1.f));
-					}
-					else
-					{
-						((float *)data)[(currentNumberOfSamples + i) * outputChannels + c] = m_sampleBuffer[(sampleOffset + i) * 2 + c];
-					}
-				}
-			}
-			// TODO: Mix to surround channels as well?
+			kernels.InterleaveInt16((int16 *)data + currentNumberOfSamples * outputChannels, src, maxSamples, outputChannels);
+		}
+		else
+		{
+			kernels.InterleaveFloat((float *)data + currentNumberOfSamples * outputChannels, src, maxSamples, outputChannels);
 		}
 		m_remainingSamples -= maxSamples;
 		currentNumberOfSamples += maxSamples;
 	}
+
+	uint64 callbackTime = callbackTimer.Microseconds();
+	stats.numCallbacks++;
+	stats.numFramesMixed += numSamples;
+	stats.totalCallbackMicroseconds += callbackTime;
+	if (callbackTime > stats.maxCallbackMicroseconds)
+		stats.maxCallbackMicroseconds = callbackTime;
+
+	// Time the produced audio lasts minus the time it took to produce it
+	const uint64 period = (uint64)numSamples * 1000000 / GetSampleRate();
+	int64 margin = (int64)period - (int64)callbackTime;
+	if (margin < stats.minMarginMicroseconds)
+		stats.minMarginMicroseconds = margin;
+	if (margin < 0)
+		stats.numXruns++;
+
+	AudioCallbackRecord record;
+	record.time = telemetry.GetTime();
+	record.numFrames = numSamples;
+	record.blockSize = m_sampleBufferLength;
+	record.numItems = numItems;
+	record.callbackMicroseconds = (uint32)callbackTime;
+	record.periodMicroseconds = (uint32)period;
+	record.numLockMisses = (uint32)(telemetry.numLockMisses.load(std::memory_order_relaxed) - lockMissesBefore);
+	telemetry.AddCallback(record);
 }
 void Audio_Impl::Start()
 {
+	m_remainingSamples = 0;
+	mixPosition = 0;
+	clock.Reset(GetSampleRate());
 	limiter = new LimiterDSP(GetSampleRate());
 	limiter->releaseTime = 0.2f;
 
+	Logf("Using %s mixing kernels", Logger::Severity::Info, MixKernels::Get().name);
+
+	lock.lock();
 	globalDSPs.Add(limiter);
+	PublishRenderState();
+	lock.unlock();
 	output->Start(this);
 }
 void Audio_Impl::Stop()
 {
 	output->Stop();
+	lock.lock();
 	globalDSPs.Remove(limiter);
+	PublishRenderState();
+	lock.unlock();
 
 	delete limiter;
 	limiter = nullptr;
@@ -131,6 +205,8 @@ void Audio_Impl::Register(AudioBase *audio)
 		lock.lock();
 		itemsToRender.AddUnique(audio);
 		audio->audio = this;
+		audio->NewClockGeneration();
+		PublishRenderState();
 		lock.unlock();
 	}
 }
@@ -139,8 +215,43 @@ void Audio_Impl::Deregister(AudioBase *audio)
 	lock.lock();
 	itemsToRender.Remove(audio);
 	audio->audio = nullptr;
+	PublishRenderState();
 	lock.unlock();
 }
+void Audio_Impl::PublishRenderState()
+{
+	AudioRenderState *state = new AudioRenderState();
+	state->items.reserve(itemsToRender.size());
+	for (AudioBase *audio : itemsToRender)
+	{
+		state->items.push_back({audio, audio->DSPs});
+	}
+	state->globalDSPs = globalDSPs;
+
+	AudioRenderState *oldState = m_renderState.exchange(state);
+
+	// Wait until the audio thread is done with a block that might still use the old state
+	uint64 epoch = m_renderEpoch.load();
+	if (epoch & 1)
+	{
+		Timer waitTimer;
+		while (m_renderEpoch.load() == epoch)
+			std::this_thread::yield();
+		telemetry.AddLockWait(waitTimer.Microseconds());
+	}
+	delete oldState;
+}
+bool Audio_Impl::IsMixing(const AudioBase *audio) const
+{
+	if (!m_mixState)
+		return false;
+	for (const AudioRenderState::Item &item : m_mixState->items)
+	{
+		if (item.audio == audio)
+			return true;
+	}
+	return false;
+}
 uint32 Audio_Impl::GetSampleRate() const
 {
 	return output->GetSampleRate();
@@ -158,6 +269,10 @@ Audio::Audio()
 }
 Audio::~Audio()
 {
+	// Finish writing cached audio
+	g_impl.pcmCache.Configure(String(), 0);
+	g_impl.telemetry.SetCsvPath(String());
+
 	if (m_initialized)
 	{
 		g_impl.Stop();
@@ -170,24 +285,95 @@ Audio::~Audio()
 }
 bool Audio::Init(bool exclusive)
 {
-	audioLatency = 0;
-
-	g_impl.output = new AudioOutput();
-	if (!g_impl.output->Init(exclusive))
+	AudioOutput *output = new AudioOutput();
+	if (!output->Init(exclusive))
 	{
-		delete g_impl.output;
-		g_impl.output = nullptr;
+		delete output;
 		return false;
 	}
 
+	return Init(output);
+}
+bool Audio::Init(IAudioOutput *output)
+{
+	assert(!m_initialized);
+	audioLatency = 0;
+
+	g_impl.output = output;
 	g_impl.Start();
 
 	return m_initialized = true;
 }
+AudioClockStats Audio::GetClockStats()
+{
+	return g_impl.clock.GetStats();
+}
+AudioMixerStats Audio::GetMixerStats()
+{
+	AudioMixerStats result;
+	result.blockSize = g_impl.stats.blockSize;
+	result.maxBlockMicroseconds = g_impl.stats.maxBlockMicroseconds;
+	result.minMarginMicroseconds = g_impl.stats.minMarginMicroseconds;
+	result.numXruns = g_impl.stats.numXruns;
+	result.totalCallbackMicroseconds = g_impl.stats.totalCallbackMicroseconds;
+
+	const AudioTelemetry &telemetry = g_impl.telemetry;
+	result.itemCosts = telemetry.GetCosts(telemetry.itemCosts, result.totalCallbackMicroseconds);
+	result.dspCosts = telemetry.GetCosts(telemetry.dspCosts, result.totalCallbackMicroseconds);
+	result.numLockMisses = telemetry.numLockMisses;
+	result.totalLockWaitMicroseconds = telemetry.totalLockWaitMicroseconds;
+	result.maxLockWaitMicroseconds = telemetry.maxLockWaitMicroseconds;
+	result.numDroppedRecords = telemetry.numDroppedRecords;
+	result.numDroppedDSPEvents = telemetry.numDroppedDSPEvents;
+	return result;
+}
 void Audio::SetGlobalVolume(float vol)
 {
 	g_impl.globalVolume = vol;
 }
+void Audio::SetResamplerQuality(ResamplerQuality quality)
+{
+	g_impl.resamplerQuality = quality;
+}
+void Audio::SetStreamReadAhead(uint32 milliseconds)
+{
+	g_impl.streamReadAhead = milliseconds;
+}
+void Audio::SetPcmCache(const String &directory, uint64 maxSize)
+{
+	g_impl.pcmCache.Configure(directory, maxSize);
+}
+void Audio::SetMixBlockSize(uint32 frames)
+{
+	g_impl.mixBlockSize = frames == 0 ? 0 : Math::Clamp(frames, Audio_Impl::minBlockSize, Audio_Impl::maxBlockSize);
+}
+void Audio::SetCompactPcm(bool enabled)
+{
+	g_impl.compactPcm = enabled;
+}
+void Audio::SetLatencyCompensation(bool enabled)
+{
+	g_impl.compensateLatency = enabled;
+}
+void Audio::SetTelemetryCsv(const String &path)
+{
+	g_impl.telemetry.SetCsvPath(path);
+}
+void Audio::UpdateTelemetry()
+{
+	g_impl.telemetry.Update();
+}
+uint64 Audio::GetPCMMemoryUsage()
+{
+	uint64 total = 0;
+	g_impl.lock.lock();
+	for (AudioBase *item : g_impl.itemsToRender)
+	{
+		total += item->GetPCMMemoryUsage();
+	}
+	g_impl.lock.unlock();
+	return total;
+}
 uint32 Audio::GetSampleRate() const
 {
 	return g_impl.output->GetSampleRate();
@@ -201,6 +387,10 @@ Ref<AudioStream> Audio::CreateStream(const String &path, bool preload)
 {
 	return AudioStream::Create(this, path, preload);
 }
+Ref<AudioStream> Audio::DecodeStream(const String &path)
+{
+	return AudioStream::Decode(this, path);
+}
 Sample Audio::CreateSample(const String &path)
 {
 	return SampleRes::Create(this, path);
@@ -10,6 +10,8 @@ uint32 DSP::GetStartSample() const
 
 uint32 DSP::GetCurrentSample() const
 {
+	if (m_preRenderPosition >= 0)
+		return static_cast<uint32>(m_preRenderPosition);
 	return static_cast<uint32>(m_audioBase->GetSamplePos());
 }
 
@@ -19,6 +21,10 @@ DSP::~DSP()
 	assert(!m_audioBase);
 }
 
+String DSP::GetKey() const
+{
+	return Utility::Sprintf("%s%u|%u|%.9g|%u|%u|%u|%d|%d", GetName(), implementationVersion, m_sampleRate, mix, priority, startTime, endTime, chartOffset, lastTimingPoint);
+}
 bool DSP::Sorter(DSP *&a, DSP *&b)
 {
 	if (a->priority == b->priority)
@@ -50,13 +56,6 @@ uint32 AudioBase::GetAudioSampleRate() const
 {
 	return audio->GetSampleRate();
 }
-void AudioBase::ProcessDSPs(float *out, uint32 numSamples)
-{
-	for (DSP *dsp : DSPs)
-	{
-		dsp->Process(out, numSamples);
-	}
-}
 void AudioBase::AddDSP(DSP *dsp)
 {
 	audio->lock.lock();
@@ -68,6 +67,7 @@ void AudioBase::AddDSP(DSP *dsp)
 		return l->priority < r->priority;
 	});
 	dsp->SetAudioBase(this);
+	audio->PublishRenderState();
 	audio->lock.unlock();
 }
 void AudioBase::RemoveDSP(DSP *dsp)
@@ -76,10 +76,17 @@ void AudioBase::RemoveDSP(DSP *dsp)
 
 	audio->lock.lock();
 	DSPs.Remove(dsp);
+	audio->PublishRenderState();
 	dsp->SetAudioBase(nullptr);
 	audio->lock.unlock();
 }
 
+void AudioBase::NewClockGeneration()
+{
+	// Unique across all audio so a new object at the address of a removed one never matches
+	static std::atomic<uint64> lastGeneration = { 0 };
+	m_clockGeneration = ++lastGeneration;
+}
 void AudioBase::Deregister()
 {
 	// Remove from audio manager
@@ -96,3 +103,58 @@ void AudioBase::Deregister()
 	}
 	DSPs.clear();
 }
+void AudioBase::ScheduleDSPMix(DSP *dsp, float mix, int64 samplePos)
+{
+	// DSP state is only written by the audio thread, so a change that doesn't fit is lost
+	if (!m_newDSPEvents.Push({dsp, mix, samplePos}) && audio)
+		audio->telemetry.numDroppedDSPEvents++;
+}
+uint32 AudioBase::ApplyScheduledEvents(const Vector<DSP *> &activeDSPs, uint32 offset, uint32 numSamples)
+{
+	if (offset == 0)
+	{
+		// Forget about DSPs that were removed
+		for (uint32 i = 0; i < m_numPendingDSPEvents;)
+		{
+			if (activeDSPs.Contains(m_pendingDSPEvents[i].dsp))
+				i++;
+			else
+				m_pendingDSPEvents[i] = m_pendingDSPEvents[--m_numPendingDSPEvents];
+		}
+
+		DSPEvent event;
+		while (m_newDSPEvents.Pop(event))
+		{
+			if (!activeDSPs.Contains(event.dsp))
+				continue;
+			uint32 i = 0;
+			while (i < m_numPendingDSPEvents && m_pendingDSPEvents[i].dsp != event.dsp)
+				i++;
+			if (i == maxPendingDSPEvents)
+			{
+				// Too many DSPs waiting for a change, apply this one now
+				event.dsp->mix = event.mix;
+				continue;
+			}
+			m_pendingDSPEvents[i] = event;
+			m_numPendingDSPEvents = Math::Max(m_numPendingDSPEvents, i + 1);
+		}
+	}
+
+	uint32 next = numSamples;
+	for (uint32 i = 0; i < m_numPendingDSPEvents;)
+	{
+		DSPEvent &event = m_pendingDSPEvents[i];
+		int64 eventOffset = GetMixOffset(event.samplePos);
+		if (eventOffset <= (int64)offset)
+		{
+			event.dsp->mix = event.mix;
+			event = m_pendingDSPEvents[--m_numPendingDSPEvents];
+			continue;
+		}
+		if (eventOffset < (int64)next)
+			next = (uint32)eventOffset;
+		i++;
+	}
+	return next;
+}
@@ -0,0 +1,95 @@
+#include "stdafx.h"
+#include "AudioClock.hpp"
+
+// How quickly the filter follows the device, lower values smooth out more jitter
+static const double filterBandwidth = 1.0;
+// Jump to the device position when the filter is off by more than this, in seconds
+static const double resyncThreshold = 0.05;
+
+AudioClock::AudioClock()
+{
+	Reset(m_sampleRate);
+}
+void AudioClock::Reset(uint32 sampleRate)
+{
+	std::lock_guard<std::mutex> guard(m_filterLock);
+	m_sampleRate = sampleRate;
+	m_numCallbacks = 0;
+	m_lastCallback.Store({0, 0, 0, 0.0, 0.0, true});
+	m_filteredCallback = 0;
+	m_framesPerSecond = (double)sampleRate;
+	m_lastHeard = 0.0;
+	m_stats = AudioClockStats();
+}
+void AudioClock::Publish(uint64 mixPosition, uint32 numFrames, double latency, bool realTime)
+{
+	m_lastCallback.Store({++m_numCallbacks, mixPosition, numFrames, latency, m_timer.SecondsAsDouble(), realTime});
+}
+void AudioClock::m_Update(const Callback &callback)
+{
+	// The first frame of the callback is heard after the latency
+	const double measured = (double)callback.mixPosition - callback.latency * (double)m_sampleRate;
+	m_stats.latencyMs = callback.latency * 1000.0;
+
+	const double dt = callback.time - m_filterTime;
+	const double predicted = m_filterPosition + dt * m_framesPerSecond;
+	const double error = measured - predicted;
+	if (m_filteredCallback == 0 || dt <= 0.0 || fabs(error) > resyncThreshold * (double)m_sampleRate)
+	{
+		if (m_filteredCallback != 0)
+			m_stats.numResyncs++;
+		m_filterPosition = measured;
+		m_filterTime = callback.time;
+		m_framesPerSecond = (double)m_sampleRate;
+		m_lastHeard = measured;
+		m_filteredCallback = callback.index;
+		return;
+	}
+
+	// Second order loop, moves the position towards the measurement and slowly adapts the rate
+	const double w = Math::Min(2.0 * Math::pi * filterBandwidth * dt, 1.0);
+	m_filterPosition = predicted + sqrt(2.0) * w * error;
+	m_framesPerSecond += w * w * error / dt;
+	m_filterTime = callback.time;
+	m_filteredCallback = callback.index;
+
+	const double errorMs = fabs(error) * 1000.0 / (double)m_sampleRate;
+	m_stats.jitterMs += (errorMs - m_stats.jitterMs) * 0.01;
+	m_stats.maxJitterMs = Math::Max(m_stats.maxJitterMs, errorMs);
+	m_stats.driftPpm = (m_framesPerSecond / (double)m_sampleRate - 1.0) * 1000000.0;
+}
+bool AudioClock::GetHeardPosition(double &position)
+{
+	const Callback callback = m_lastCallback.Load();
+	if (callback.index == 0)
+		return false;
+
+	std::lock_guard<std::mutex> guard(m_filterLock);
+	if (!callback.realTime)
+	{
+		// Frame counts are the only time base, there is nothing to interpolate
+		m_stats.latencyMs = callback.latency * 1000.0;
+		position = (double)(callback.mixPosition + callback.numFrames) - callback.latency * (double)m_sampleRate;
+		position = Math::Max(position, m_lastHeard);
+		m_lastHeard = position;
+		return true;
+	}
+	if (callback.index != m_filteredCallback)
+		m_Update(callback);
+
+	position = m_filterPosition + (m_timer.SecondsAsDouble() - m_filterTime) * m_framesPerSecond;
+	// Nothing after the last callback has been handed to the device, this also stops the clock when the audio thread stalls
+	position = Math::Min(position, (double)(callback.mixPosition + callback.numFrames));
+	position = Math::Max(position, m_lastHeard);
+	m_lastHeard = position;
+	return true;
+}
+double AudioClock::GetLatency() const
+{
+	return m_lastCallback.Load().latency;
+}
+AudioClockStats AudioClock::GetStats()
+{
+	std::lock_guard<std::mutex> guard(m_filterLock);
+	return m_stats;
+}
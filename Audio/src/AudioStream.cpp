@@ -45,16 +45,103 @@ static Ref<AudioStream> FindImplementation(Audio *audio, const String &path, boo
 
 Ref<AudioStream> AudioStream::Create(Audio *audio, const String &path, bool preload)
 {
+	PcmCache &cache = audio->GetImpl()->pcmCache;
+	const PcmCacheFormat format = audio->GetImpl()->compactPcm ? PcmCacheFormat::Int16 : PcmCacheFormat::Float32;
+	if (preload)
+	{
+		// Skip decoding when this file was decoded before
+		PcmCacheHeader header;
+		Ref<MappedFile> cached = cache.Load(path, audio->GetSampleRate(), format, header);
+		if (cached)
+		{
+			Ref<AudioStream> impl = AudioStreamPcm::Create(audio, cached, header);
+			if (impl)
+			{
+				audio->GetImpl()->Register(impl.get());
+				return impl;
+			}
+		}
+	}
+
 	Ref<AudioStream> impl = FindImplementation(audio, path, preload);
-	if (impl)
-		audio->GetImpl()->Register(impl.get());
+	if (!impl)
+		return impl;
+
+	if (preload)
+	{
+		if (format == PcmCacheFormat::Int16)
+		{
+			// Keep a 16-bit copy and release the decoder along with its float data
+			Ref<AudioStream> compact = AudioStreamPcm::Create(audio, impl);
+			if (compact)
+				impl = compact;
+		}
+		if (impl->GetPCM16())
+			cache.Store(path, audio->GetSampleRate(), PcmCacheFormat::Int16, impl->GetPCM16(), impl->GetPCMCount(), impl->GetSampleRate(), impl);
+		else
+			cache.Store(path, audio->GetSampleRate(), PcmCacheFormat::Float32, impl->GetPCM(), impl->GetPCMCount(), impl->GetSampleRate(), impl);
+	}
+	else
+	{
+		// Keep decoding off the audio thread for streams that are read from disk
+		double readAhead = (double)audio->GetImpl()->streamReadAhead / 1000.0;
+		static_cast<AudioStreamBase *>(impl.get())->StartDecodeThread(readAhead);
+	}
+	audio->GetImpl()->Register(impl.get());
 	return impl;
 }
 
+Ref<AudioStream> AudioStream::Decode(Audio *audio, const String &path)
+{
+	Ref<AudioStream> impl = FindImplementation(audio, path, true);
+	if (impl && audio->GetImpl()->compactPcm)
+	{
+		Ref<AudioStream> compact = AudioStreamPcm::Create(audio, impl);
+		if (compact)
+			impl = compact;
+	}
+	return impl;
+}
 Ref<AudioStream> AudioStream::Clone(Audio *audio, Ref<AudioStream> source)
 {
 	auto clone = AudioStreamPcm::Create(audio, source);
 	if (clone)
 		audio->GetImpl()->Register(clone.get());
 	return clone;
-}
\ No newline at end of file
+}
+Ref<AudioStream> AudioStream::CreateWindow(Audio *audio, const String &path, int32 start, int32 length)
+{
+	// Decode straight from the file so only the window ends up in memory
+	Ref<AudioStream> decoder = FindImplementation(audio, path, false);
+	if (!decoder || length <= 0)
+		return Ref<AudioStream>();
+
+	const uint32 sampleRate = decoder->GetSampleRate();
+	const int64 startFrame = (int64)Math::Max(0, start) * sampleRate / 1000;
+	const uint64 numFrames = (uint64)length * sampleRate / 1000;
+	Ref<AudioStream> impl = AudioStreamPcm::Create(audio, static_cast<AudioStreamBase *>(decoder.get()), startFrame, numFrames);
+	if (impl)
+		audio->GetImpl()->Register(impl.get());
+	return impl;
+}
+Ref<AudioStream> AudioStream::LoadVariant(Audio *audio, const String &path, const String &variant, const String &variantKey)
+{
+	PcmCacheHeader header;
+	const PcmCacheFormat format = audio->GetImpl()->compactPcm ? PcmCacheFormat::Int16 : PcmCacheFormat::Float32;
+	Ref<MappedFile> cached = audio->GetImpl()->pcmCache.Load(path, audio->GetSampleRate(), format, header, variant, variantKey);
+	if (!cached)
+		return Ref<AudioStream>();
+
+	Ref<AudioStream> impl = AudioStreamPcm::Create(audio, cached, header);
+	if (impl)
+		audio->GetImpl()->Register(impl.get());
+	return impl;
+}
+void AudioStream::StoreVariant(Audio *audio, const String &path, const String &variant, const String &variantKey, Ref<AudioStream> stream)
+{
+	PcmCache &cache = audio->GetImpl()->pcmCache;
+	if (stream->GetPCM16())
+		cache.Store(path, audio->GetSampleRate(), PcmCacheFormat::Int16, stream->GetPCM16(), stream->GetPCMCount(), stream->GetSampleRate(), stream, variant, variantKey);
+	else if (stream->GetPCM())
+		cache.Store(path, audio->GetSampleRate(), PcmCacheFormat::Float32, stream->GetPCM(), stream->GetPCMCount(), stream->GetSampleRate(), stream, variant, variantKey);
+}
@@ -36,6 +36,8 @@ void AudioStreamBase::m_initSampling(uint32 sampleRate)
 	// Calculate the sample step if the rate is not the same as the output rate
 	double sampleStep = (double)sampleRate / (double)m_audio->GetSampleRate();
 	m_sampleStepIncrement = (uint64)(sampleStep * (double)fp_sampleStep);
+	// Build the filter for normal speed here instead of on the audio thread
+	Resampler::Prepare((double)m_sampleStepIncrement / (double)fp_sampleStep);
 
 	m_numChannels = 2;
 	m_readBuffer = new float *[m_numChannels];
@@ -73,7 +75,7 @@ void AudioStreamBase::Pause()
 }
 bool AudioStreamBase::HasEnded() const
 {
-	return m_ended;
+	return m_ended && !m_isSeekPending();
 }
 uint64 AudioStreamBase::m_secondsToSamples(double s) const
 {
@@ -98,21 +100,115 @@ double AudioStreamBase::m_getPositionSeconds(bool allowFreezeSkip /*= true*/) co
 }
 uint64 AudioStreamBase::GetSamplePos() const
 {
-	return m_samplePos;
+	return m_getRequestedSamplePos();
+}
+bool AudioStreamBase::m_isSeekPending() const
+{
+	return m_numSeeksPerformed != m_numSeeksRequested;
+}
+int64 AudioStreamBase::m_getRequestedSamplePos() const
+{
+	return m_isSeekPending() ? m_requestedSamplePos.load() : m_samplePos;
 }
 
+bool AudioStreamBase::m_getHeardPositionSeconds(double &position) const
+{
+	double heard;
+	AudioClock &clock = m_audio->GetImpl()->clock;
+	if (!clock.GetHeardPosition(heard))
+		return false;
+	// Without compensation the position runs ahead by the latency, which keeps calibrated offsets valid
+	if (!m_audio->GetImpl()->compensateLatency)
+		heard += clock.GetLatency() * (double)m_audio->GetSampleRate();
+
+	const ClockSegments segments = m_publishedClockSegments.Load();
+	const ClockSegment &current = segments.current;
+	if (current.mixPosition == UINT64_MAX)
+		return false;
+
+	double samplePos;
+	if (heard >= (double)current.mixPosition)
+	{
+		samplePos = (double)current.samplePos + (heard - (double)current.mixPosition) * current.step;
+	}
+	else if (segments.previous.mixPosition != UINT64_MAX && segments.previous.step > 0.0)
+	{
+		// Audio from before a seek is still being heard
+		const ClockSegment &previous = segments.previous;
+		samplePos = (double)previous.samplePos + (heard - (double)previous.mixPosition) * previous.step;
+	}
+	else
+	{
+		// Wait at the start of the segment until it is heard
+		samplePos = (double)current.samplePos;
+	}
+	position = samplePos / (double)const_cast<AudioStreamBase *>(this)->GetStreamRate_Internal();
+	return true;
+}
 int32 AudioStreamBase::GetPosition() const
 {
-	return (int32)(m_getPositionSeconds() * 1000.0);
+	// Seeks show up right away, even before the audio thread has performed them
+	if (m_isSeekPending())
+		return (int32)(SamplesToSeconds(m_requestedSamplePos) * 1000.0);
+
+	double position;
+	if (m_paused || !m_playing || !m_getHeardPositionSeconds(position))
+		position = m_getPositionSeconds();
+	return (int32)(position * 1000.0);
 }
 void AudioStreamBase::SetPosition(int32 pos)
 {
-	m_lock.lock();
-	m_remainingBufferData = 0;
-	m_samplePos = m_secondsToSamples((double)pos / 1000.0);
-	SetPosition_Internal((int32)m_samplePos);
+	NewClockGeneration();
+	const SeekCommand seek = {(int64)m_secondsToSamples((double)pos / 1000.0), m_numSeeksRequested + 1};
+	m_requestedSamplePos = seek.samplePos;
+	m_numSeeksRequested = seek.index;
+	if (m_seekCommands.Push(seek))
+		return;
+
+	// The audio thread hasn't picked up the queued seeks, it skips this stream while the lock is held
+	std::lock_guard<mutex> guard(m_lock);
+	SeekCommand skipped;
+	while (m_seekCommands.Pop(skipped))
+		;
+	m_seek(seek);
+}
+void AudioStreamBase::m_applySeeks()
+{
+	SeekCommand seek;
+	bool seeked = false;
+	while (m_seekCommands.Pop(seek))
+		seeked = true;
+	if (seeked)
+		m_seek(seek);
+}
+void AudioStreamBase::m_seek(const SeekCommand &seek)
+{
+	m_inputRemaining = 0;
+	m_resamplerReadIndex = 0;
+	m_resampler.Reset();
+	m_samplePos = seek.samplePos;
+	if (m_decodeThread.joinable())
+	{
+		// Let the decode thread seek, anything decoded before this is dropped by the audio thread
+		//	notified without locking, the decode thread also wakes up on its own
+		m_seekPosition = m_samplePos;
+		m_seekGeneration++;
+		// Drop it right away, a paused stream doesn't fetch and the decode thread couldn't decode ahead of the new position
+		const uint32 numChunks = (uint32)m_chunks.size();
+		m_holdingChunk = false;
+		while (m_chunkReadIndex != m_chunkWriteIndex)
+		{
+			m_bufferedFrames -= m_chunks[m_chunkReadIndex % numChunks].numFrames;
+			m_chunkReadIndex++;
+		}
+		m_decodeSignal.notify_all();
+	}
+	else
+	{
+		SetPosition_Internal((int32)m_samplePos);
+	}
 	m_ended = false;
-	m_lock.unlock();
+	m_numSeeksPerformed = seek.index;
 }
 float *AudioStreamBase::GetPCM()
 {
@@ -122,13 +218,18 @@ uint64 AudioStreamBase::GetPCMCount() const
 {
 	return GetSampleCount_Internal();
 }
+uint64 AudioStreamBase::GetPCMMemoryUsage() const
+{
+	// Only preloaded streams keep the decoded file around
+	return m_preloaded ? GetSampleCount_Internal() * 2 * sizeof(float) : 0;
+}
 uint32 AudioStreamBase::GetSampleRate() const
 {
 	return GetSampleRate_Internal();
 }
 void AudioStreamBase::m_restartTiming()
 {
-	m_streamTimeOffset = SamplesToSeconds(m_samplePos); // Add audio latency to this offset
+	m_streamTimeOffset = SamplesToSeconds(m_getRequestedSamplePos()); // Add audio latency to this offset
 	m_samplePos = 0;
 	m_streamTimer.Restart();
 	m_offsetCorrection = 0.0f;
@@ -139,23 +240,88 @@ void AudioStreamBase::PreRenderDSPs(Vector<DSP *> &DSPs)
 {
 	PreRenderDSPs_Internal(DSPs);
 }
+uint64 AudioStreamBase::m_getSampleStepIncrement() const
+{
+	return static_cast<uint64>(m_sampleStepIncrement * PlaybackSpeed);
+}
+int64 AudioStreamBase::GetMixOffset(int64 samplePos) const
+{
+	// The fraction of the resampler position counts, otherwise events land up to a frame late
+	double startPos;
+	double step;
+	if (m_blockMixPosition == m_audio->GetImpl()->mixPosition)
+	{
+		// Already processed this block
+		startPos = (double)m_blockStartPos + m_blockStartFraction;
+		step = m_blockStep;
+	}
+	else
+	{
+		if (m_isSeekPending())
+			startPos = (double)m_requestedSamplePos.load();
+		else
+			startPos = (double)m_samplePos + (double)m_sampleStep / (double)fp_sampleStep;
+		step = (m_playing && !m_paused) ? (double)m_getSampleStepIncrement() / (double)fp_sampleStep : 0.0;
+	}
+
+	if ((double)samplePos <= startPos)
+		return 0;
+	if (step <= 0.0)
+		return INT64_MAX;
+	return (int64)ceil(((double)samplePos - startPos) / step);
+}
+void AudioStreamBase::m_startBlock(double step)
+{
+	// Remember where this block starts for placing scheduled events
+	m_blockMixPosition = m_audio->GetImpl()->mixPosition;
+	m_blockStartPos = m_samplePos;
+	m_blockStartFraction = (double)m_sampleStep / (double)fp_sampleStep;
+	m_blockStep = step;
+
+	// Start a new clock segment when the stream doesn't continue where it was expected to be
+	ClockSegment &current = m_clockSegments.current;
+	if (current.mixPosition != UINT64_MAX && current.step == step)
+	{
+		double expected = (double)current.samplePos + (double)(m_blockMixPosition - current.mixPosition) * step;
+		if (fabs(expected - (double)m_blockStartPos) <= 1.0)
+			return;
+	}
+	m_clockSegments.previous = current;
+	current = {m_blockMixPosition, m_blockStartPos, step};
+	m_publishedClockSegments.Store(m_clockSegments);
+}
 void AudioStreamBase::Process(float *out, uint32 numSamples)
 {
-	if (!m_playing || m_paused)
+	// Don't wait for the game thread, output silence for this block instead
+	//	only happens when SetPosition couldn't queue its seek
+	if (!m_lock.try_lock())
+	{
+		m_audio->GetImpl()->telemetry.numLockMisses++;
+		m_startBlock(0.0);
 		return;
+	}
 
-	m_lock.lock();
+	m_applySeeks();
+	if (!m_playing || m_paused)
+	{
+		m_startBlock(0.0);
+		m_lock.unlock();
+		return;
+	}
 
-	const uint64 sampleStepIncrement = static_cast<uint64>(m_sampleStepIncrement * PlaybackSpeed);
+	const uint64 sampleStepIncrement = m_getSampleStepIncrement();
+	m_startBlock((double)sampleStepIncrement / (double)fp_sampleStep);
+	m_resampler.SetQuality(m_audio->GetImpl()->resamplerQuality);
+	m_resampler.SetRatio((double)sampleStepIncrement / (double)fp_sampleStep);
 
 	uint32 outCount = 0;
 	while (outCount < numSamples)
 	{
-		if (m_remainingBufferData > 0)
+		if (m_inputRemaining > 0)
 		{
-			uint32 idxStart = (m_currentBufferSize - m_remainingBufferData);
+			uint32 idxStart = (m_inputSize - m_inputRemaining);
 			uint32 readOffset = 0; // Offset from the start to read from
-			for (uint32 i = 0; outCount < numSamples && readOffset < m_remainingBufferData; i++)
+			for (uint32 i = 0; outCount < numSamples && readOffset < m_inputRemaining; i++)
 			{
 				if (m_samplePos < 0)
 				{
@@ -164,8 +330,13 @@ void AudioStreamBase::Process(float *out, uint32 numSamples)
 				}
 				else
 				{
-					out[outCount * 2] = m_readBuffer[0][idxStart + readOffset];
-					out[outCount * 2 + 1] = m_readBuffer[1][idxStart + readOffset];
+					// Feed every input frame up to the current one, including skipped ones so the filter can band-limit them
+					while (m_resamplerReadIndex <= idxStart + readOffset)
+					{
+						m_resampler.Push(m_input[0][m_resamplerReadIndex], m_input[1][m_resamplerReadIndex]);
+						m_resamplerReadIndex++;
+					}
+					m_resampler.Interpolate((float)((double)m_sampleStep / (double)fp_sampleStep), out + outCount * 2);
 				}
 				outCount++;
 
@@ -180,13 +351,13 @@ void AudioStreamBase::Process(float *out, uint32 numSamples)
 				}
 			}
 
-			if (readOffset > m_remainingBufferData)
+			if (readOffset > m_inputRemaining)
 			{
-				m_remainingBufferData = 0;
+				m_inputRemaining = 0;
 			}
 			else
 			{
-				m_remainingBufferData -= readOffset;
+				m_inputRemaining -= readOffset;
 			}
 		}
 
@@ -194,7 +365,13 @@ void AudioStreamBase::Process(float *out, uint32 numSamples)
 			break;
 
 		// Read more data
-		if (DecodeData_Internal() <= 0)
+		int32 fetchResult = m_fetchInput();
+		if (fetchResult == 0)
+		{
+			// Decode thread is behind, the rest of this block stays silent
+			break;
+		}
+		if (fetchResult < 0)
 		{
 			// Ended
 			Log("Audio stream ended", Logger::Severity::Info);
@@ -207,7 +384,7 @@ void AudioStreamBase::Process(float *out, uint32 numSamples)
 	// Store timing info
 	if (m_samplePos > 0)
 	{
-		m_samplePos = GetStreamPosition_Internal() - (int64)m_remainingBufferData;
+		m_samplePos = m_inputEndPosition - (int64)m_inputRemaining;
 	}
 
 	if (m_samplePos > 0)
@@ -246,3 +423,181 @@ void AudioStreamBase::Process(float *out, uint32 numSamples)
 
 	m_lock.unlock();
 }
+
+int32 AudioStreamBase::m_fetchInput()
+{
+	m_resamplerReadIndex = 0;
+
+	if (!m_decodeThread.joinable())
+	{
+		if (DecodeData_Internal() <= 0)
+			return -1;
+
+		m_input[0] = m_readBuffer[0];
+		m_input[1] = m_readBuffer[1];
+		m_inputSize = m_currentBufferSize;
+		m_inputRemaining = m_remainingBufferData;
+		m_inputEndPosition = GetStreamPosition_Internal();
+		return 1;
+	}
+
+	const uint32 generation = m_seekGeneration;
+	const uint32 numChunks = (uint32)m_chunks.size();
+
+	// Release the chunk that was just played back
+	if (m_holdingChunk)
+	{
+		DecodedChunk &chunk = m_chunks[m_chunkReadIndex % numChunks];
+		bool endOfStream = chunk.endOfStream && chunk.generation == generation;
+		m_bufferedFrames -= chunk.numFrames;
+		m_chunkReadIndex++;
+		m_decodeSignal.notify_all();
+		m_holdingChunk = false;
+		m_inputRemaining = 0;
+		if (endOfStream)
+			return -1;
+	}
+
+	while (m_chunkReadIndex != m_chunkWriteIndex)
+	{
+		DecodedChunk &chunk = m_chunks[m_chunkReadIndex % numChunks];
+		if (chunk.generation != generation || chunk.numFrames == 0)
+		{
+			// Decoded before a seek or an empty end marker
+			bool endOfStream = chunk.endOfStream && chunk.generation == generation;
+			m_bufferedFrames -= chunk.numFrames;
+			m_chunkReadIndex++;
+			m_decodeSignal.notify_all();
+			if (endOfStream)
+				return -1;
+			continue;
+		}
+
+		m_holdingChunk = true;
+		m_input[0] = chunk.data[0].data();
+		m_input[1] = chunk.data[1].data();
+		m_inputSize = chunk.numFrames;
+		m_inputRemaining = chunk.numFrames;
+		m_inputEndPosition = chunk.endPosition;
+		return 1;
+	}
+	return 0;
+}
+void AudioStreamBase::StartDecodeThread(double readAhead)
+{
+	if (m_preloaded || m_decodeThread.joinable())
+		return;
+
+	// A single decode call never produces more than m_bufferSize frames
+	m_chunkCapacity = m_bufferSize * 2;
+	m_readAheadFrames = (uint32)m_secondsToSamples(readAhead);
+	uint32 numChunks = m_readAheadFrames / m_bufferSize + 2;
+	m_chunks.resize(numChunks);
+	for (auto &chunk : m_chunks)
+	{
+		chunk.data[0].resize(m_chunkCapacity);
+		chunk.data[1].resize(m_chunkCapacity);
+	}
+
+	m_decodeThreadRunning = true;
+	m_decodeThread = thread(&AudioStreamBase::m_decodeThreadMain, this);
+}
+void AudioStreamBase::m_decodeThreadMain()
+{
+	const uint32 numChunks = (uint32)m_chunks.size();
+	uint32 currentGeneration = m_seekGeneration;
+	bool ended = false;
+
+	while (m_decodeThreadRunning)
+	{
+		const uint32 generation = m_seekGeneration;
+		if (generation != currentGeneration)
+		{
+			SetPosition_Internal((int32)m_seekPosition);
+			currentGeneration = generation;
+			ended = false;
+		}
+
+		if (ended || m_isDecodeBufferFull())
+		{
+			std::unique_lock<mutex> lock(m_decodeLock);
+			m_decodeIdleGeneration = currentGeneration;
+			m_decodeEnded = ended;
+			m_decodeSignal.notify_all();
+			m_decodeSignal.wait_for(lock, std::chrono::milliseconds(50), [&]() {
+				return !m_decodeThreadRunning || m_seekGeneration != currentGeneration || (!ended && !m_isDecodeBufferFull());
+			});
+			continue;
+		}
+
+		DecodedChunk &chunk = m_chunks[m_chunkWriteIndex % numChunks];
+		chunk.numFrames = 0;
+		chunk.generation = generation;
+		chunk.endOfStream = false;
+		chunk.endPosition = GetStreamPosition_Internal();
+		while (chunk.numFrames + m_bufferSize <= m_chunkCapacity && m_seekGeneration == generation)
+		{
+			if (DecodeData_Internal() <= 0)
+			{
+				chunk.endOfStream = true;
+				ended = true;
+				break;
+			}
+			memcpy(chunk.data[0].data() + chunk.numFrames, m_readBuffer[0], m_currentBufferSize * sizeof(float));
+			memcpy(chunk.data[1].data() + chunk.numFrames, m_readBuffer[1], m_currentBufferSize * sizeof(float));
+			chunk.numFrames += m_currentBufferSize;
+			chunk.endPosition = GetStreamPosition_Internal();
+		}
+
+		// Publish to the audio thread
+		m_bufferedFrames += chunk.numFrames;
+		m_chunkWriteIndex++;
+	}
+}
+bool AudioStreamBase::m_isDecodeBufferFull() const
+{
+	return m_chunkWriteIndex - m_chunkReadIndex >= (uint32)m_chunks.size() || m_bufferedFrames >= (int64)m_readAheadFrames;
+}
+bool AudioStreamBase::WaitForDecoding(uint32 timeout)
+{
+	if (!m_decodeThread.joinable())
+		return true;
+
+	// The decode thread notifies every time it stops decoding, the buffer is checked here because the audio thread might have used it since
+	std::unique_lock<mutex> lock(m_decodeLock);
+	return m_decodeSignal.wait_for(lock, std::chrono::milliseconds(timeout), [&]() {
+		return m_decodeIdleGeneration == m_seekGeneration && (m_decodeEnded || m_isDecodeBufferFull());
+	});
+}
+uint64 AudioStreamBase::DecodeFrames(int64 start, uint64 numFrames, float *out)
+{
+	assert(!m_decodeThread.joinable());
+	std::lock_guard<mutex> guard(m_lock);
+
+	SetPosition_Internal((int32)start);
+	uint64 decoded = 0;
+	while (decoded < numFrames && DecodeData_Internal() > 0)
+	{
+		const uint32 count = (uint32)Math::Min<uint64>(m_currentBufferSize, numFrames - decoded);
+		for (uint32 i = 0; i < count; i++)
+		{
+			out[(decoded + i) * 2] = m_readBuffer[0][i];
+			out[(decoded + i) * 2 + 1] = m_readBuffer[1][i];
+		}
+		decoded += count;
+	}
+	return decoded;
+}
+void AudioStreamBase::Deregister()
+{
+	// Stop rendering first so the audio thread no longer looks at the decode thread
+	AudioStream::Deregister();
+
+	{
+		std::lock_guard<mutex> guard(m_decodeLock);
+		m_decodeThreadRunning = false;
+	}
+	m_decodeSignal.notify_all();
+	if (m_decodeThread.joinable())
+		m_decodeThread.join();
+}
@@ -2,6 +2,8 @@
 #include "Audio.hpp"
 #include "AudioStream.hpp"
 #include "Audio_Impl.hpp"
+#include "Resampler.hpp"
+#include <condition_variable>
 
 class AudioStreamBase : public AudioStream
 {
@@ -19,18 +21,103 @@ protected:
 
 	mutex m_lock;
 
+	// Output of DecodeData_Internal
 	float **m_readBuffer = nullptr;
 	uint32 m_bufferSize = 4096;
 	uint32 m_numChannels = 0;
 	uint32 m_currentBufferSize = 0;
 	uint32 m_remainingBufferData = 0;
 
+	// Decoded data currently being played back, either m_readBuffer or a chunk from the decode thread
+	float *m_input[2] = {nullptr, nullptr};
+	uint32 m_inputSize = 0;
+	uint32 m_inputRemaining = 0;
+	// Stream position after the last frame in m_input
+	int64 m_inputEndPosition = 0;
+
+	// Decoded audio handed from the decode thread to the audio thread
+	struct DecodedChunk
+	{
+		Vector<float> data[2];
+		uint32 numFrames = 0;
+		// Stream position after the last frame in this chunk
+		int64 endPosition = 0;
+		// Seek generation this chunk was decoded for, chunks from before the last seek are dropped
+		uint32 generation = 0;
+		bool endOfStream = false;
+	};
+	// Single producer (decode thread), single consumer (audio thread) ring of chunks
+	Vector<DecodedChunk> m_chunks;
+	uint32 m_chunkCapacity = 0;
+	std::atomic<uint32> m_chunkReadIndex = {0};
+	std::atomic<uint32> m_chunkWriteIndex = {0};
+	std::atomic<int64> m_bufferedFrames = {0};
+	uint32 m_readAheadFrames = 0;
+	// Whether the audio thread is still reading from the chunk at m_chunkReadIndex
+	bool m_holdingChunk = false;
+
+	// Seeks requested by SetPosition, performed by the audio thread at the start of its next block
+	//	only the last one is performed, the game thread only takes m_lock to seek itself when the queue is full
+	struct SeekCommand
+	{
+		int64 samplePos;
+		// Number of seeks requested up to and including this one
+		uint32 index;
+	};
+	CommandQueue<SeekCommand, 16> m_seekCommands;
+	std::atomic<uint32> m_numSeeksRequested = {0};
+	std::atomic<uint32> m_numSeeksPerformed = {0};
+	// Target of the last seek, reported to the game thread until the audio thread has performed it
+	std::atomic<int64> m_requestedSamplePos = {0};
+
+	// Seeks performed by the decode thread
+	std::atomic<uint32> m_seekGeneration = {0};
+	std::atomic<int64> m_seekPosition = {0};
+
+	thread m_decodeThread;
+	std::atomic<bool> m_decodeThreadRunning = {false};
+	// Wakes the decode thread when a chunk is released, a seek is requested or it has to stop, and WaitForDecoding when the decode thread waits
+	//	the audio thread notifies without locking, so the decode thread also wakes up on its own once in a while
+	mutex m_decodeLock;
+	std::condition_variable m_decodeSignal;
+	// Set by the decode thread under m_decodeLock when it waits, for WaitForDecoding
+	uint32 m_decodeIdleGeneration = 0;
+	bool m_decodeEnded = false;
+
 	int64 m_samplePos = 0;
 	uint64 m_samplesTotal = 0; // Total pcm length of audio stream
 
+	// Position at the start of the block mixed at m_blockMixPosition, used to place scheduled events
+	uint64 m_blockMixPosition = UINT64_MAX;
+	int64 m_blockStartPos = 0;
+	// Fraction of a stream frame the resampler was past m_blockStartPos
+	double m_blockStartFraction = 0.0;
+	// Stream frames advanced per output frame during that block, 0 when not playing
+	double m_blockStep = 0.0;
+
+	// Part of the mix timeline where the stream position moves linearly
+	struct ClockSegment
+	{
+		uint64 mixPosition;
+		int64 samplePos;
+		double step;
+	};
+	struct ClockSegments
+	{
+		ClockSegment current;
+		// Still heard until the output reaches current.mixPosition
+		ClockSegment previous;
+	};
+	ClockSegments m_clockSegments = {{UINT64_MAX, 0, 0.0}, {UINT64_MAX, 0, 0.0}};
+	// Copy of m_clockSegments for the game thread
+	SeqLock<ClockSegments> m_publishedClockSegments;
+
 	// Resampling values
 	uint64 m_sampleStep = 0;
 	uint64 m_sampleStepIncrement = 0;
+	Resampler m_resampler;
+	// Index in m_readBuffer of the next frame to feed to the resampler
+	uint32 m_resamplerReadIndex = 0;
 
 	Timer m_deltaTimer;
 	Timer m_streamTimer;
@@ -47,8 +134,27 @@ protected:
 	float m_volume = 0.8f;
 	void m_initSampling(uint32 sampleRate);
 	uint64 m_secondsToSamples(double s) const;
+	// Stream frames advanced per output frame at the current playback speed
+	uint64 m_getSampleStepIncrement() const;
 	void m_restartTiming();
+	// Performs the last queued seek, call with m_lock held
+	void m_applySeeks();
+	void m_seek(const SeekCommand &seek);
+	// Whether a seek requested by the game thread hasn't been performed yet
+	bool m_isSeekPending() const;
+	// Position the game thread sees, including seeks that haven't been performed yet
+	int64 m_getRequestedSamplePos() const;
 	double m_getPositionSeconds(bool allowFreezeSkip = true) const;
+	// Position that is being heard according to the output clock, false if it isn't known yet
+	bool m_getHeardPositionSeconds(double &position) const;
+	// Records where the current block starts, step is the number of stream frames per output frame
+	void m_startBlock(double step);
+	// Makes the next block of decoded audio available in m_input
+	// returns 1 when new data is available, 0 if the decode thread hasn't caught up and -1 at the end of the stream
+	int32 m_fetchInput();
+	void m_decodeThreadMain();
+	// Whether the decode thread has decoded as far ahead as it should
+	bool m_isDecodeBufferFull() const;
 
 	// Implementation specific set position
 	virtual void SetPosition_Internal(int32 pos) = 0;
@@ -65,15 +171,28 @@ protected:
 	virtual bool Init(Audio *audio, const String &path, bool preload);
 
 public:
+	// Moves decoding to a separate thread that keeps readAhead seconds of audio decoded ahead of the play position
+	// only used for streams that are not preloaded
+	void StartDecodeThread(double readAhead);
+	// Decodes up to numFrames frames from frame start into interleaved stereo out, returns the number of frames decoded
+	//	only used for streams without a decode thread
+	uint64 DecodeFrames(int64 start, uint64 numFrames, float *out);
+	// Stops the decode thread and deregisters from the audio
+	// must be called by implementations before they release their decoder
+	virtual void Deregister() override;
+
 	virtual void Play() override;
 	virtual void Pause() override;
 	virtual bool HasEnded() const override;
+	virtual bool WaitForDecoding(uint32 timeout) override;
 	double SamplesToSeconds(int64 s) const;
 	virtual int32 GetPosition() const override;
 	virtual uint64 GetSamplePos() const override;
+	virtual int64 GetMixOffset(int64 samplePos) const override;
 	virtual void SetPosition(int32 pos) override;
 	virtual float *GetPCM() override;
 	virtual uint64 GetPCMCount() const override;
+	virtual uint64 GetPCMMemoryUsage() const override;
 	virtual uint32 GetSampleRate() const override;
 	virtual void PreRenderDSPs(Vector<DSP *> &DSPs) override;
 	virtual void Process(float *out, uint32 numSamples) override;
@@ -78,11 +78,8 @@ void AudioStreamMa::SetPosition_Internal(int32 pos)
 
 	if (!m_preloaded)
 	{
-		//seek_to_pcm_frame is very slow
-		//we want to use ma_decoder_seek_bytes_64
-		//but we require some stuff to do that properly
-
-		//ma_decoder_seek_to_pcm_frame(&m_decoder, pos);
+		// Seeking to a pcm frame is slow, this is done on the decode thread
+		ma_decoder_seek_to_pcm_frame(&m_decoder, m_playbackPointer);
 		return;
 	}
 }
@@ -120,6 +117,7 @@ int32 AudioStreamMa::DecodeData_Internal()
 			m_readBuffer[0][i] = decodeBuffer[i * 2];
 			m_readBuffer[1][i] = decodeBuffer[i * 2 + 1];
 		}
+		m_playbackPointer += totalRead;
 		m_currentBufferSize = totalRead;
 		m_remainingBufferData = totalRead;
 		return totalRead;
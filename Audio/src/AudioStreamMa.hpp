@@ -24,5 +24,6 @@ protected:
 public:
 	AudioStreamMa() = default;
 	~AudioStreamMa();
+	const char *GetName() const override { return "AudioStreamMa"; }
 	static Ref<AudioStream> Create(class Audio *audio, const String &path, bool preload);
 };
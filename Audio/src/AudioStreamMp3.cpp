@@ -1,6 +1,10 @@
 #include "stdafx.h"
 #include "AudioStreamMp3.hpp"
 
+// Frames decoded before the one containing the seek position
+// they fill the bit reservoir and the overlap of the synthesis filter, their output is dropped
+static const uint32 primingFrames = 3;
+
 // https://en.wikipedia.org/wiki/Synchsafe
 int AudioStreamMp3::m_unsynchsafe(int in)
 {
@@ -67,7 +71,11 @@ bool AudioStreamMp3::Init(Audio *audio, const String &path, bool preload)
 		}
 	}
 	// Scan MP3 frame offsets
-	uint32 sampleOffset = 0;
+	//	the first frame is not played, stream positions start at the frame after it
+	int64 sampleOffset = 0;
+	uint32 numFrames = 0;
+	// Most recent frames, to start decoding some frames before a seek position
+	SeekTable::Point recentFrames[primingFrames + 1];
 	for (size_t i = tagSize; i < m_mp3dataLength;)
 	{
 		if (m_dataSource[i] == 0xFF)
@@ -105,9 +113,21 @@ bool AudioStreamMp3::Init(Audio *audio, const String &path, bool preload)
 					continue;
 				}
 
-				i += frameLength;
 				uint32 frameSamples = (linearVersion == 0) ? 1152 : 576;
-				m_frameIndices.Add((int32)sampleOffset, i);
+				if (numFrames == 0)
+				{
+					m_seekTable.Reset(sampleRate);
+					sampleOffset = -(int64)frameSamples;
+				}
+				recentFrames[numFrames % (primingFrames + 1)] = {sampleOffset, i};
+				if (numFrames > 0)
+				{
+					uint32 first = numFrames > primingFrames ? numFrames - primingFrames : 1;
+					m_seekTable.AddBlock(sampleOffset + frameSamples, recentFrames[first % (primingFrames + 1)]);
+				}
+				numFrames++;
+
+				i += frameLength;
 				sampleOffset += frameSamples;
 				continue; // Skip header
 			}
@@ -116,14 +136,14 @@ bool AudioStreamMp3::Init(Audio *audio, const String &path, bool preload)
 	}
 
 	// No mp3 frames found
-	if (m_frameIndices.empty())
+	if (m_seekTable.IsEmpty())
 	{
 		Logf("No valid mp3 frames found in file \"%s\"", Logger::Severity::Warning, path);
 		return false;
 	}
 
 	// Total sample
-	m_samplesTotal = sampleOffset;
+	m_samplesTotal = (uint64)sampleOffset;
 
 	m_decoder = (mp3_decoder_t *)mp3_create();
 	m_preloaded = false;
@@ -166,16 +186,12 @@ void AudioStreamMp3::SetPosition_Internal(int32 pos)
 		return;
 	}
 
-	auto it = m_frameIndices.lower_bound(pos);
-	if (it == m_frameIndices.end())
-	{
-		--it; // Take the last frame
-	}
-	if (it != m_frameIndices.end())
-	{
-		m_mp3samplePosition = it->first;
-		m_mp3dataOffset = it->second;
-	}
+	// Start a few frames early and drop samples until the exact position
+	pos = Math::Max(pos, 0);
+	const SeekTable::Point *point = m_seekTable.Find(pos);
+	m_mp3samplePosition = (int32)point->sample;
+	m_mp3dataOffset = (size_t)point->offset;
+	m_skipSamples = pos - m_mp3samplePosition;
 }
 int32 AudioStreamMp3::GetStreamPosition_Internal()
 {
@@ -242,21 +258,32 @@ int32 AudioStreamMp3::DecodeData_Internal()
 	int16 buffer[MP3_MAX_SAMPLES_PER_FRAME];
 	mp3_info_t info;
 	int32 readData = 0;
+	int32 samplesGotten = 0;
+	int32 firstSample = 0;
 	while (true)
 	{
-		readData = mp3_decode(m_decoder, (uint8 *)m_dataSource + m_mp3dataOffset, (int)(m_mp3dataLength - m_mp3dataOffset), buffer, &info);
-		m_mp3dataOffset += readData;
-		if (m_mp3dataOffset >= m_mp3dataLength) // EOF
-			return -1;
-		if (readData <= 0)
-			return -1;
-		if (info.audio_bytes >= 0)
+		while (true)
+		{
+			readData = mp3_decode(m_decoder, (uint8 *)m_dataSource + m_mp3dataOffset, (int)(m_mp3dataLength - m_mp3dataOffset), buffer, &info);
+			m_mp3dataOffset += readData;
+			if (m_mp3dataOffset >= m_mp3dataLength) // EOF
+				return -1;
+			if (readData <= 0)
+				return -1;
+			if (info.audio_bytes >= 0)
+				break;
+		}
+
+		samplesGotten = info.audio_bytes / (info.channels * sizeof(short));
+		m_mp3samplePosition += samplesGotten;
+
+		// Drop samples before the position that was seeked to
+		firstSample = Math::Min(samplesGotten, m_skipSamples);
+		m_skipSamples -= firstSample;
+		if (firstSample < samplesGotten)
 			break;
 	}
 
-	int32 samplesGotten = info.audio_bytes / (info.channels * sizeof(short));
-	m_mp3samplePosition += samplesGotten;
-
 	if (m_firstFrame)
 	{
 		m_bufferSize = MP3_MAX_SAMPLES_PER_FRAME / 2;
@@ -265,17 +292,19 @@ int32 AudioStreamMp3::DecodeData_Internal()
 	}
 
 	// Copy data to read buffer
+	samplesGotten -= firstSample;
 	for (int32 i = 0; i < samplesGotten; i++)
 	{
+		int32 j = i + firstSample;
 		if (info.channels == 1)
 		{
-			m_readBuffer[0][i] = (float)buffer[i] / (float)0x7FFF;
+			m_readBuffer[0][i] = (float)buffer[j] / (float)0x7FFF;
 			m_readBuffer[1][i] = m_readBuffer[0][i];
 		}
 		else if (info.channels == 2)
 		{
-			m_readBuffer[0][i] = (float)buffer[i * 2 + 0] / (float)0x7FFF;
-			m_readBuffer[1][i] = (float)buffer[i * 2 + 1] / (float)0x7FFF;
+			m_readBuffer[0][i] = (float)buffer[j * 2 + 0] / (float)0x7FFF;
+			m_readBuffer[1][i] = (float)buffer[j * 2 + 1] / (float)0x7FFF;
 		}
 	}
 	m_currentBufferSize = samplesGotten;
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "AudioStreamBase.hpp"
+#include "SeekTable.hpp"
 extern "C"
 {
 #include "minimp3.h"
@@ -14,7 +15,9 @@ class AudioStreamMp3 : public AudioStreamBase
 	int32 m_samplingRate = 0;
 	uint8 *m_dataSource = 0;
 
-	Map<int32, size_t> m_frameIndices;
+	SeekTable m_seekTable;
+	// Decoded samples to drop to reach the position that was seeked to
+	int32 m_skipSamples = 0;
 	Vector<float> m_pcm;
 	int64 m_playPos;
 
@@ -35,5 +38,6 @@ protected:
 public:
 	AudioStreamMp3() = default;
 	~AudioStreamMp3();
+	const char *GetName() const override { return "AudioStreamMp3"; }
 	static Ref<AudioStream> Create(Audio *audio, const String &path, bool preload);
 };
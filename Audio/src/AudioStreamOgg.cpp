@@ -79,6 +79,10 @@ bool AudioStreamOgg::Init(Audio *audio, const String &path, bool preload)
 		ov_clear(&m_ovf);
 		m_playPos = 0;
 	}
+	else
+	{
+		m_BuildSeekTable();
+	}
 	m_initSampling(m_info.rate);
 	return true;
 }
@@ -94,8 +98,73 @@ void AudioStreamOgg::SetPosition_Internal(int32 pos)
 
 		return;
 	}
+
+	// Jump to an indexed page and decode up to the exact position from there
+	//	falls back to the bisection search of vorbisfile if that doesn't land before the position
+	pos = Math::Max(pos, 0);
+	m_skipSamples = 0;
+	const SeekTable::Point *point = m_seekTable.Find(pos);
+	if (point && point->sample <= pos && ov_raw_seek(&m_ovf, (ogg_int64_t)point->offset) == 0)
+	{
+		int64 position = ov_pcm_tell(&m_ovf);
+		if (position >= 0 && position <= pos)
+		{
+			m_skipSamples = pos - position;
+			return;
+		}
+	}
 	ov_pcm_seek(&m_ovf, pos);
 }
+void AudioStreamOgg::m_BuildSeekTable()
+{
+	BinaryStream &reader = m_reader();
+	const size_t restorePosition = reader.Tell();
+	const size_t size = reader.GetSize();
+	m_seekTable.Reset(m_info.rate);
+
+	// Page header, see https://xiph.org/ogg/doc/framing.html
+	uint8 header[27];
+	uint8 segments[255];
+	uint32 firstSerial = 0;
+	// Last two pages on which a packet ends
+	SeekTable::Point previous = {-1, 0};
+	SeekTable::Point beforePrevious = {-1, 0};
+	size_t offset = 0;
+	while (offset + sizeof(header) <= size)
+	{
+		reader.Seek(offset);
+		if (reader.Serialize(header, sizeof(header)) != sizeof(header) || memcmp(header, "OggS", 4) != 0)
+			break;
+		const uint8 numSegments = header[26];
+		if (reader.Serialize(segments, numSegments) != numSegments)
+			break;
+		size_t bodySize = 0;
+		for (uint8 i = 0; i < numSegments; i++)
+			bodySize += segments[i];
+
+		int64 granule;
+		uint32 serial;
+		memcpy(&granule, header + 6, sizeof(granule));
+		memcpy(&serial, header + 14, sizeof(serial));
+		if (offset == 0)
+			firstSerial = serial;
+		else if (serial != firstSerial)
+			break;
+
+		// -1 when no packet ends on this page
+		if (granule >= 0)
+		{
+			// Start two pages back, decoding from the previous page may not produce output before it ends
+			if (granule > previous.sample && beforePrevious.sample > 0)
+				m_seekTable.AddBlock(granule, {beforePrevious.sample, previous.offset});
+			beforePrevious = previous;
+			previous = {granule, offset};
+		}
+		offset += sizeof(header) + numSegments + bodySize;
+	}
+
+	reader.Seek(restorePosition);
+}
 
 int32 AudioStreamOgg::GetStreamPosition_Internal()
 {
@@ -170,7 +239,18 @@ int32 AudioStreamOgg::DecodeData_Internal()
 	}
 
 	float **readBuffer;
-	int32 r = ov_read_float(&m_ovf, &readBuffer, m_bufferSize, 0);
+	int32 r;
+	while (m_skipSamples > 0)
+	{
+		// Drop samples before the position that was seeked to
+		r = ov_read_float(&m_ovf, &readBuffer, (int)Math::Min<int64>(m_skipSamples, m_bufferSize), 0);
+		if (r == OV_HOLE)
+			continue;
+		if (r <= 0)
+			return -1;
+		m_skipSamples -= r;
+	}
+	r = ov_read_float(&m_ovf, &readBuffer, m_bufferSize, 0);
 	if (r > 0)
 	{
 		if (m_info.channels == 1)
@@ -198,13 +278,11 @@ int32 AudioStreamOgg::DecodeData_Internal()
 	else if (r == 0)
 	{
 		// EOF
-		m_playing = false;
 		return -1;
 	}
 	else
 	{
 		// Error
-		m_playing = false;
 		Logf("Ogg Stream error %d", Logger::Severity::Warning, r);
 		return -1;
 	}
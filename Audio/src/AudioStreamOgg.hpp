@@ -1,6 +1,7 @@
 #pragma once
 #include "stdafx.h"
 #include "AudioStreamBase.hpp"
+#include "SeekTable.hpp"
 #include <vorbis/vorbisfile.h>
 
 class AudioStreamOgg : public AudioStreamBase
@@ -10,6 +11,9 @@ protected:
 	vorbis_info m_info;
 	Vector<float> m_pcm;
 	int64 m_playPos;
+	SeekTable m_seekTable;
+	// Decoded samples to drop to reach the position that was seeked to
+	int64 m_skipSamples = 0;
 
 	bool Init(Audio *audio, const String &path, bool preload) override;
 	void SetPosition_Internal(int32 pos) override;
@@ -21,6 +25,8 @@ protected:
 	int32 DecodeData_Internal() override;
 
 private:
+	// Indexes the pages of the first logical stream in the file
+	void m_BuildSeekTable();
 	static size_t m_Read(void *ptr, size_t size, size_t nmemb, AudioStreamOgg *self);
 	static int m_Seek(AudioStreamOgg *self, int64 offset, int whence);
 	static long m_Tell(AudioStreamOgg *self);
@@ -28,5 +34,6 @@ private:
 public:
 	AudioStreamOgg() = default;
 	~AudioStreamOgg();
+	const char *GetName() const override { return "AudioStreamOgg"; }
 	static Ref<AudioStream> Create(class Audio *audio, const String &path, bool preload);
 };
@@ -1,5 +1,7 @@
 #include "stdafx.h"
 #include "AudioStreamPcm.hpp"
+#include "MixKernels.hpp"
+#include "DSPPreRenderer.hpp"
 
 bool AudioStreamPcm::Init(Audio *audio, const String &path, bool preload)
 {
@@ -25,40 +27,64 @@ float *AudioStreamPcm::GetPCM_Internal()
 {
     return m_pcm;
 }
+int16 *AudioStreamPcm::GetPCM16()
+{
+    return m_pcm16;
+}
+uint64 AudioStreamPcm::GetPCMMemoryUsage() const
+{
+    return m_samplesTotal * 2 * (m_pcm16 ? sizeof(int16) : sizeof(float));
+}
 uint32 AudioStreamPcm::GetSampleRate_Internal() const
 {
     return m_sampleRate;
 }
 int32 AudioStreamPcm::DecodeData_Internal()
 {
-    uint32 samplesPerRead = 128;
+    const uint32 samplesPerRead = 128;
     int32 retVal = samplesPerRead;
-    bool earlyOut = false;
-    for (size_t i = 0; i < samplesPerRead; i++)
+    uint32 i = 0;
+    for (; i < samplesPerRead && m_playPos < 0; i++)
+    {
+        m_readBuffer[0][i] = 0;
+        m_readBuffer[1][i] = 0;
+        m_playPos++;
+    }
+
+    uint32 numFrames = 0;
+    if ((uint64)m_playPos < m_samplesTotal)
+        numFrames = (uint32)Math::Min<uint64>(samplesPerRead - i, m_samplesTotal - m_playPos);
+    if (m_pcm16)
     {
-        if (m_playPos < 0)
+        // Convert to float first, then split the channels
+        float converted[samplesPerRead * 2];
+        MixKernels::Get().Int16ToFloat(converted, m_pcm16 + m_playPos * 2, numFrames * 2);
+        for (uint32 j = 0; j < numFrames; j++)
         {
-            m_readBuffer[0][i] = 0;
-            m_readBuffer[1][i] = 0;
-            m_playPos++;
-            continue;
+            m_readBuffer[0][i + j] = converted[j * 2];
+            m_readBuffer[1][i + j] = converted[j * 2 + 1];
         }
-        else if ((uint64)m_playPos >= m_samplesTotal)
+    }
+    else
+    {
+        for (uint32 j = 0; j < numFrames; j++)
+        {
+            m_readBuffer[0][i + j] = m_pcm[(m_playPos + j) * 2];
+            m_readBuffer[1][i + j] = m_pcm[(m_playPos + j) * 2 + 1];
+        }
+    }
+    m_playPos += numFrames;
+    i += numFrames;
+
+    if (i < samplesPerRead)
+    {
+        // Reached the end
+        retVal = i;
+        for (; i < samplesPerRead; i++)
         {
-            m_currentBufferSize = m_bufferSize;
-            m_remainingBufferData = m_bufferSize;
             m_readBuffer[0][i] = 0;
             m_readBuffer[1][i] = 0;
-            if (!earlyOut)
-            {
-                retVal = i;
-                earlyOut = true;
-            }
-            continue;
         }
-        m_readBuffer[0][i] = m_pcm[m_playPos * 2];
-        m_readBuffer[1][i] = m_pcm[m_playPos * 2 + 1];
-        m_playPos++;
     }
     m_currentBufferSize = samplesPerRead;
     m_remainingBufferData = samplesPerRead;
@@ -71,47 +97,29 @@ uint64 AudioStreamPcm::GetSampleCount_Internal() const
 }
 void AudioStreamPcm::PreRenderDSPs_Internal(Vector<DSP *> &DSPs)
 {
-    auto originalPlayPos = m_playPos;
     for (auto &&dsp : DSPs)
     {
-        m_playPos = ((uint64)dsp->startTime * (uint64)m_sampleRate) / 1000;
-        m_samplePos = m_playPos;
-        int64 endSamplePos = ((uint64)dsp->endTime * (uint64)m_sampleRate) / 1000;
-        endSamplePos = Math::Min(endSamplePos, (int64)m_samplesTotal);
-        if (m_playPos >= endSamplePos)
-        {
-            Logf("Effect %s at %dms not rendered", Logger::Severity::Debug, dsp->GetName(), dsp->startTime);
-            continue;
-        }
-
-        uint32 numSamples = endSamplePos - m_playPos;
-        float *buffer = new float[numSamples * 2];
-        memcpy(buffer, m_pcm + m_playPos * 2, numSamples * 2 * sizeof(float));
-        dsp->Process(buffer, numSamples);
-        memcpy(m_pcm + m_playPos * 2, buffer, numSamples * 2 * sizeof(float));
-        Logf("Rendered %s at %dms with %d samples", Logger::Severity::Debug, dsp->GetName(), dsp->startTime, numSamples);
-        delete[] buffer;
+        DSPPreRenderer::RenderDSP(this, dsp);
     }
-    m_playPos = originalPlayPos;
-    m_samplePos = m_playPos;
 }
 
 AudioStreamPcm::~AudioStreamPcm()
 {
     Deregister();
-    if (m_pcm)
+    if (!m_mapping)
     {
-        delete m_pcm;
+        delete[] m_pcm;
+        delete[] m_pcm16;
     }
 }
 
 Ref<AudioStream> AudioStreamPcm::Create(class Audio *audio, const Ref<AudioStream> &other)
 {
     AudioStreamPcm *impl = new AudioStreamPcm();
-    impl->m_pcm = nullptr;
     float *source = other->GetPCM();
+    const int16 *source16 = other->GetPCM16();
     uint64 sampleCount = other->GetPCMCount();
-    if (source == nullptr || sampleCount == 0)
+    if ((source == nullptr && source16 == nullptr) || sampleCount == 0)
     {
         delete impl;
         impl = nullptr;
@@ -119,11 +127,66 @@ Ref<AudioStream> AudioStreamPcm::Create(class Audio *audio, const Ref<AudioStrea
     else
     {
         impl->m_playPos = 0;
-        impl->m_pcm = new float[sampleCount * 2];
-        memcpy(impl->m_pcm, source, sampleCount * 2 * sizeof(float));
+        if (source16)
+        {
+            impl->m_pcm16 = new int16[sampleCount * 2];
+            memcpy(impl->m_pcm16, source16, sampleCount * 2 * sizeof(int16));
+        }
+        else if (audio->GetImpl()->compactPcm)
+        {
+            impl->m_pcm16 = new int16[sampleCount * 2];
+            MixKernels::Get().InterleaveInt16(impl->m_pcm16, source, (uint32)sampleCount, 2);
+        }
+        else
+        {
+            impl->m_pcm = new float[sampleCount * 2];
+            memcpy(impl->m_pcm, source, sampleCount * 2 * sizeof(float));
+        }
         impl->m_sampleRate = other->GetSampleRate();
         impl->m_samplesTotal = sampleCount;
         impl->Init(audio, "", false);
     }
     return Ref<AudioStream>(impl);
-}
\ No newline at end of file
+}
+Ref<AudioStream> AudioStreamPcm::Create(class Audio *audio, const Ref<MappedFile> &mapping, const PcmCacheHeader &header)
+{
+    AudioStreamPcm *impl = new AudioStreamPcm();
+    impl->m_mapping = mapping;
+    uint8 *data = mapping->GetData() + sizeof(PcmCacheHeader);
+    if (header.format == PcmCacheFormat::Int16)
+        impl->m_pcm16 = (int16 *)data;
+    else
+        impl->m_pcm = (float *)data;
+    impl->m_playPos = 0;
+    impl->m_sampleRate = header.sampleRate;
+    impl->m_samplesTotal = header.numFrames;
+    impl->Init(audio, "", false);
+    return Ref<AudioStream>(impl);
+}
+Ref<AudioStream> AudioStreamPcm::Create(class Audio *audio, AudioStreamBase *decoder, int64 start, uint64 numFrames)
+{
+    float *pcm = new float[numFrames * 2];
+    const uint64 decoded = decoder->DecodeFrames(start, numFrames, pcm);
+    if (decoded == 0)
+    {
+        delete[] pcm;
+        return Ref<AudioStream>();
+    }
+
+    AudioStreamPcm *impl = new AudioStreamPcm();
+    if (audio->GetImpl()->compactPcm)
+    {
+        impl->m_pcm16 = new int16[decoded * 2];
+        MixKernels::Get().InterleaveInt16(impl->m_pcm16, pcm, (uint32)decoded, 2);
+        delete[] pcm;
+    }
+    else
+    {
+        impl->m_pcm = pcm;
+    }
+    impl->m_playPos = 0;
+    impl->m_sampleRate = decoder->GetSampleRate();
+    impl->m_samplesTotal = decoded;
+    impl->Init(audio, "", false);
+    return Ref<AudioStream>(impl);
+}
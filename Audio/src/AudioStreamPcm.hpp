@@ -1,11 +1,16 @@
 #pragma once
 #include "stdafx.h"
 #include "AudioStreamBase.hpp"
+#include "PcmCache.hpp"
 
 class AudioStreamPcm : public AudioStreamBase
 {
 protected:
-    float *m_pcm;
+    // Only one of these is set depending on the storage format
+    float *m_pcm = nullptr;
+    int16 *m_pcm16 = nullptr;
+    // Set when the pcm data points into a cache file instead of owned memory
+    Ref<MappedFile> m_mapping;
     uint32 m_sampleRate;
     int64 m_playPos;
 
@@ -14,6 +19,8 @@ protected:
     int32 GetStreamPosition_Internal() override;
     int32 GetStreamRate_Internal() override;
     float *GetPCM_Internal() override;
+    int16 *GetPCM16() override;
+    uint64 GetPCMMemoryUsage() const override;
     void PreRenderDSPs_Internal(Vector<DSP *> &DSPs) override;
     uint32 GetSampleRate_Internal() const override;
     uint64 GetSampleCount_Internal() const override;
@@ -22,5 +29,11 @@ protected:
 public:
     AudioStreamPcm() = default;
     ~AudioStreamPcm();
+    const char *GetName() const override { return "AudioStreamPcm"; }
+    // Copies the pcm data of other, stored as 16-bit when compact pcm storage is enabled
     static Ref<AudioStream> Create(class Audio *audio, const Ref<AudioStream> &other);
+    // Plays pcm data from a mapped cache file
+    static Ref<AudioStream> Create(class Audio *audio, const Ref<MappedFile> &mapping, const struct PcmCacheHeader &header);
+    // Decodes numFrames frames from frame start of decoder
+    static Ref<AudioStream> Create(class Audio *audio, AudioStreamBase *decoder, int64 start, uint64 numFrames);
 };
\ No newline at end of file
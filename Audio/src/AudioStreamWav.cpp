@@ -275,6 +275,8 @@ bool AudioStreamWav::Init(Audio *audio, const String &path, bool preload)
 				m_fileReader.Skip(chunkHdr.nLength);
 			}
 		}
+		// The chunks after the data were skipped as well, start reading at the beginning of the data
+		m_fileReader.Seek(m_dataPosition);
 	}
 
 	m_initSampling(m_format.nSampleRate);
@@ -304,7 +306,8 @@ void AudioStreamWav::SetPosition_Internal(int32 pos)
 		int filePos = 0;
 		if (m_format.nFormat == 1)
 		{
-			filePos = m_dataPosition + pos * sizeof(short);
+			// pos counts frames, each frame has a sample for every channel
+			filePos = m_dataPosition + m_playbackPointer * m_format.nChannels * sizeof(short);
 		}
 		else if (m_format.nFormat == 2)
 		{
@@ -371,7 +374,6 @@ int32 AudioStreamWav::DecodeData_Internal()
 			int amountRead = m_fileReader.Serialize(readData.data(), m_format.nBlockAlign);
 			if (amountRead < m_format.nBlockAlign)
 			{
-				m_playing = false;
 				return 0;
 			}
 			uint32 decodedCount = m_decode_ms_adpcm(readData, &decoded, 0);
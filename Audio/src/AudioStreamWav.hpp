@@ -48,5 +48,6 @@ protected:
 public:
 	AudioStreamWav() = default;
 	~AudioStreamWav();
+	const char *GetName() const override { return "AudioStreamWav"; }
 	static Ref<AudioStream> Create(class Audio *audio, const String &path, bool preload);
 };
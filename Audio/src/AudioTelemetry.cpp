@@ -0,0 +1,122 @@
+#include "stdafx.h"
+#include "AudioTelemetry.hpp"
+#include <Shared/FileStream.hpp>
+#include <Shared/TextStream.hpp>
+
+// Relaxed max, only the audio thread writes but readers may see an older value
+static void StoreMax(std::atomic<uint64> &target, uint64 value)
+{
+	if (value > target.load(std::memory_order_relaxed))
+		target.store(value, std::memory_order_relaxed);
+}
+
+AudioTelemetry::AudioTelemetry()
+{
+}
+AudioTelemetry::~AudioTelemetry()
+{
+	SetCsvPath(String());
+}
+void AudioTelemetry::AddCost(std::array<AudioCost, maxCosts> &costs, const char *name, uint64 nanoseconds)
+{
+	for (AudioCost &cost : costs)
+	{
+		const char *costName = cost.name.load(std::memory_order_relaxed);
+		if (costName == nullptr)
+		{
+			// Only the audio thread claims slots
+			cost.name.store(name, std::memory_order_release);
+		}
+		else if (costName != name && strcmp(costName, name) != 0)
+		{
+			continue;
+		}
+		cost.numCalls.fetch_add(1, std::memory_order_relaxed);
+		cost.totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+		StoreMax(cost.maxNanoseconds, nanoseconds);
+		return;
+	}
+	// All slots are taken, this cost is not tracked
+}
+void AudioTelemetry::AddCallback(const AudioCallbackRecord &record)
+{
+	if (!m_recording.load(std::memory_order_relaxed))
+		return;
+	if (!m_records.Push(record))
+		numDroppedRecords++;
+}
+void AudioTelemetry::AddLockWait(uint64 microseconds)
+{
+	totalLockWaitMicroseconds += microseconds;
+	StoreMax(maxLockWaitMicroseconds, microseconds);
+}
+void AudioTelemetry::SetCsvPath(const String &path)
+{
+	if (m_csvOpen)
+	{
+		m_recording = false;
+		Update();
+		m_csvFile.Close();
+		m_csvOpen = false;
+	}
+	if (path.empty())
+		return;
+
+	if (!m_csvFile.OpenWrite(path))
+	{
+		Logf("Failed to open audio telemetry file \"%s\"", Logger::Severity::Warning, path);
+		return;
+	}
+	// Throw away records left over from earlier recordings
+	AudioCallbackRecord record;
+	while (m_records.Pop(record))
+		;
+
+	FileWriter writer(m_csvFile);
+	TextStream::WriteLine(writer, "time,frames,block_size,items,callback_us,period_us,margin_us,lock_misses,xrun");
+	m_csvOpen = true;
+	m_recording = true;
+	Logf("Writing audio telemetry to \"%s\"", Logger::Severity::Info, path);
+}
+void AudioTelemetry::Update()
+{
+	if (!m_csvOpen)
+		return;
+
+	FileWriter writer(m_csvFile);
+	AudioCallbackRecord record;
+	while (m_records.Pop(record))
+	{
+		const int32 margin = (int32)record.periodMicroseconds - (int32)record.callbackMicroseconds;
+		TextStream::WriteLine(writer, Utility::Sprintf("%.6f,%d,%d,%d,%d,%d,%d,%d,%d",
+			record.time, record.numFrames, record.blockSize, record.numItems,
+			record.callbackMicroseconds, record.periodMicroseconds, margin, record.numLockMisses, margin < 0 ? 1 : 0));
+	}
+}
+Vector<AudioCostStats> AudioTelemetry::GetCosts(const std::array<AudioCost, maxCosts> &costs, uint64 totalCallbackMicroseconds) const
+{
+	Vector<AudioCostStats> result;
+	for (const AudioCost &cost : costs)
+	{
+		const char *name = cost.name.load(std::memory_order_acquire);
+		if (name == nullptr)
+			break;
+		const uint64 numCalls = cost.numCalls.load(std::memory_order_relaxed);
+		const uint64 total = cost.totalNanoseconds.load(std::memory_order_relaxed);
+		AudioCostStats stats;
+		stats.name = name;
+		stats.numCalls = numCalls;
+		stats.averageMicroseconds = numCalls > 0 ? (double)total / (double)numCalls / 1000.0 : 0.0;
+		stats.maxMicroseconds = (double)cost.maxNanoseconds.load(std::memory_order_relaxed) / 1000.0;
+		stats.percent = totalCallbackMicroseconds > 0 ? (double)total / 10.0 / (double)totalCallbackMicroseconds : 0.0;
+		result.Add(stats);
+	}
+	std::sort(result.begin(), result.end(), [](const AudioCostStats &l, const AudioCostStats &r) {
+		return l.percent > r.percent;
+	});
+	return result;
+}
+double AudioTelemetry::GetTime() const
+{
+	return m_timer.SecondsAsDouble();
+}
@@ -3,6 +3,9 @@
 #include "AudioOutput.hpp"
 #include "Audio_Impl.hpp"
 
+// Number of frames modulated filters keep interpolating towards the same coefficients
+static const uint32 coefficientBlockSize = 32;
+
 void BQF::SetLowPass(float q, float freq, float sampleRate)
 {
 	// Limit q
@@ -108,6 +111,10 @@ float BQF::Update(float in)
 	return filtered;
 }
 
+String PanDSP::GetKey() const
+{
+	return DSP::GetKey() + Utility::Sprintf("|%.9g", panning);
+}
 void PanDSP::Process(float *out, uint32 numSamples)
 {
 	for (uint32 i = 0; i < numSamples; i++)
@@ -123,42 +130,42 @@ BQFDSP::BQFDSP(uint32 sampleRate) : DSP()
 {
 	SetSampleRate(sampleRate);
 }
+String BQFDSP::GetKey() const
+{
+	return DSP::GetKey() + "|" + m_filter.GetKey();
+}
 void BQFDSP::Process(float *out, uint32 numSamples)
 {
-	for (uint32 c = 0; c < 2; c++)
-	{
-		for (uint32 i = 0; i < numSamples; i++)
-		{
-			out[i * 2 + c] = m_filters[c].Update(out[i * 2 + c]);
-		}
-	}
+	m_filter.Process(out, numSamples);
 }
+// Parameter changes are interpolated over the next processed block
 void BQFDSP::SetLowPass(float q, float freq)
 {
-	for (uint32 c = 0; c < 2; c++)
-	{
-		m_filters[c].SetLowPass(q, freq, (float)m_sampleRate);
-	}
+	BQF design;
+	design.SetLowPass(q, freq, (float)m_sampleRate);
+	m_filter.SetCoefficients(design, true);
 }
 void BQFDSP::SetHighPass(float q, float freq)
 {
-	for (uint32 c = 0; c < 2; c++)
-	{
-		m_filters[c].SetHighPass(q, freq, (float)m_sampleRate);
-	}
+	BQF design;
+	design.SetHighPass(q, freq, (float)m_sampleRate);
+	m_filter.SetCoefficients(design, true);
 }
 void BQFDSP::SetPeaking(float q, float freq, float gain)
 {
-	for (uint32 c = 0; c < 2; c++)
-	{
-		m_filters[c].SetPeaking(q, freq, gain, (float)m_sampleRate);
-	}
+	BQF design;
+	design.SetPeaking(q, freq, gain, (float)m_sampleRate);
+	m_filter.SetCoefficients(design, true);
 }
 
 CombinedFilterDSP::CombinedFilterDSP(uint32 sampleRate) : DSP(), a(sampleRate), peak(sampleRate)
 {
 	SetSampleRate(sampleRate);
 }
+String CombinedFilterDSP::GetKey() const
+{
+	return DSP::GetKey() + "|" + a.GetKey() + "|" + peak.GetKey();
+}
 void CombinedFilterDSP::SetLowPass(float q, float freq, float peakQ, float peakGain)
 {
 	a.SetLowPass(q, freq);
@@ -181,6 +188,10 @@ LimiterDSP::LimiterDSP(uint32 sampleRate) : DSP()
 {
 	SetSampleRate(sampleRate);
 }
+String LimiterDSP::GetKey() const
+{
+	return DSP::GetKey() + Utility::Sprintf("|%.9g", releaseTime);
+}
 void LimiterDSP::Process(float *out, uint32 numSamples)
 {
 	const float secondsPerSample = 1.0f / (float)m_sampleRate;
@@ -214,6 +225,10 @@ BitCrusherDSP::BitCrusherDSP(uint32 sampleRate) : DSP()
 {
 	SetSampleRate(sampleRate);
 }
+String BitCrusherDSP::GetKey() const
+{
+	return DSP::GetKey() + Utility::Sprintf("|%u,%u", m_period, m_increment);
+}
 void BitCrusherDSP::SetPeriod(float period /*= 0*/)
 {
 	// Scale period with sample rate
@@ -244,6 +259,10 @@ GateDSP::GateDSP(uint32 sampleRate) : DSP()
 {
 	SetSampleRate(sampleRate);
 }
+String GateDSP::GetKey() const
+{
+	return DSP::GetKey() + Utility::Sprintf("|%u,%.9g,%.9g", m_length, m_gating, low);
+}
 void GateDSP::SetLength(double length)
 {
 	double flength = length / 1000.0 * m_sampleRate;
@@ -307,6 +326,10 @@ TapeStopDSP::TapeStopDSP(uint32 sampleRate) : DSP()
 {
 	SetSampleRate(sampleRate);
 }
+String TapeStopDSP::GetKey() const
+{
+	return DSP::GetKey() + Utility::Sprintf("|%u", m_length);
+}
 void TapeStopDSP::SetLength(double length)
 {
 	assert(m_sampleRate > 0);
@@ -353,6 +376,10 @@ RetriggerDSP::RetriggerDSP(uint32 sampleRate) : DSP()
 {
 	SetSampleRate(sampleRate);
 }
+String RetriggerDSP::GetKey() const
+{
+	return DSP::GetKey() + Utility::Sprintf("|%u,%.9g,%u", m_length, m_gating, m_resetDuration);
+}
 void RetriggerDSP::SetLength(double length)
 {
 	double flength = length / 1000.0 * m_sampleRate;
@@ -384,6 +411,13 @@ void RetriggerDSP::SetMaxLength(uint32 length)
 		m_bufferReserved = true;
 	}
 }
+uint32 RetriggerDSP::GetReadMargin() const
+{
+	if (m_sampleRate == 0)
+		return 0;
+	// Repeats audio from up to one reset period and one repeat length away
+	return static_cast<uint32>(static_cast<uint64>(m_resetDuration + m_length) * 1000 / m_sampleRate) + 1;
+}
 void RetriggerDSP::Process(float *out, uint32 numSamples)
 {
 	if (m_length == 0)
@@ -393,7 +427,12 @@ void RetriggerDSP::Process(float *out, uint32 numSamples)
 	const uint32 nowSample = GetCurrentSample();
 	const auto maxSample = m_audioBase->GetPCMCount();
 
+	// Compact streams only have 16-bit data
 	float *pcmSource = m_audioBase->GetPCM();
+	const int16 *pcmSource16 = m_audioBase->GetPCM16();
+	if (!pcmSource && !pcmSource16)
+		return;
+	const float int16Scale = 1.0f / (float)0x7FFF;
 	double rateMult = (double)m_audioBase->GetSampleRate() / m_sampleRate;
 	uint32 pcmStartSample = static_cast<uint32>(lastTimingPoint * ((double)m_audioBase->GetSampleRate() / 1000.0));
 	uint32 baseStartRepeat = static_cast<uint32>(lastTimingPoint * ((double)m_audioBase->GetSampleRate() / 1000.0));
@@ -424,8 +463,19 @@ void RetriggerDSP::Process(float *out, uint32 numSamples)
 		assert(static_cast<uint64>(pcmSample) < maxSample);
 		if (static_cast<uint64>(pcmSample) < maxSample) //TODO: Improve whatever is necessary to make sure this never happens
 		{
-			out[i * 2] = gating * pcmSource[pcmSample * 2] * mix + out[i * 2] * (1 - mix);
-			out[i * 2 + 1] = gating * pcmSource[pcmSample * 2 + 1] * mix + out[i * 2 + 1] * (1 - mix);
+			float l, r;
+			if (pcmSource)
+			{
+				l = pcmSource[pcmSample * 2];
+				r = pcmSource[pcmSample * 2 + 1];
+			}
+			else
+			{
+				l = (float)pcmSource16[pcmSample * 2] * int16Scale;
+				r = (float)pcmSource16[pcmSample * 2 + 1] * int16Scale;
+			}
+			out[i * 2] = gating * l * mix + out[i * 2] * (1 - mix);
+			out[i * 2 + 1] = gating * r * mix + out[i * 2 + 1] * (1 - mix);
 		}
 
 		// Increase index
@@ -437,6 +487,10 @@ WobbleDSP::WobbleDSP(uint32 sampleRate) : DSP()
 {
 	SetSampleRate(sampleRate);
 }
+String WobbleDSP::GetKey() const
+{
+	return DSP::GetKey() + Utility::Sprintf("|%u,%.9g,%.9g,%.9g", m_length, fmin, fmax, q);
+}
 void WobbleDSP::SetLength(double length)
 {
 	double flength = length / 1000.0 * m_sampleRate;
@@ -451,23 +505,29 @@ void WobbleDSP::Process(float *out, uint32 numSamples)
 	const uint32 startSample = GetStartSample();
 	const uint32 currentSample = GetCurrentSample();
 
-	for (uint32 i = 0; i < numSamples; i++)
+	uint32 i = currentSample < startSample ? Math::Min(startSample - currentSample, numSamples) : 0;
+	float dry[coefficientBlockSize * 2];
+	while (i < numSamples)
 	{
-		if (currentSample + i < startSample)
-		{
-			continue;
-		}
+		const uint32 blockSize = Math::Min(coefficientBlockSize, numSamples - i);
+		m_currentSample = (m_currentSample + blockSize) % m_length;
+
+		// Interpolate towards the cutoff at the end of this block
 		float f = abs(2.0f * ((float)m_currentSample / (float)m_length) - 1.0f);
 		f = easing.Sample(f);
 		float freq = fmin + (fmax - fmin) * f;
-
-		for (uint32 c = 0; c < 2; c++) {
-			m_filters[c].SetLowPass(q, freq, (float)m_sampleRate);
-			out[i * 2 + c] = m_filters[c].Update(out[i * 2 + c]) * mix + out[i * 2 + c] * (1.0f - mix);
+		BQF design;
+		design.SetLowPass(q, freq, (float)m_sampleRate);
+		m_filter.SetCoefficients(design, true);
+
+		float *block = out + i * 2;
+		memcpy(dry, block, blockSize * 2 * sizeof(float));
+		m_filter.Process(block, blockSize);
+		for (uint32 j = 0; j < blockSize * 2; j++)
+		{
+			block[j] = block[j] * mix + dry[j] * (1.0f - mix);
 		}
-
-		m_currentSample++;
-		m_currentSample %= m_length;
+		i += blockSize;
 	}
 }
 
@@ -475,6 +535,10 @@ PhaserDSP::PhaserDSP(uint32 sampleRate) : DSP()
 {
 	SetSampleRate(sampleRate);
 }
+String PhaserDSP::GetKey() const
+{
+	return DSP::GetKey() + Utility::Sprintf("|%u,%u,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g", m_length, m_stage, fmin, fmax, q, feedback, stereoWidth, hiCutGain);
+}
 void PhaserDSP::SetLength(double length)
 {
 	double flength = length / 1000.0 * m_sampleRate;
@@ -495,36 +559,44 @@ void PhaserDSP::Process(float *out, uint32 numSamples)
 
 	// logarithmic center
 	float freqCenter = sqrt(fmin*fmax);
-	for (uint32 c = 0; c < 2; c++) {
-		m_hiShelf[c].SetHighShelf(1.5f, freqCenter, hiCutGain, (float)m_sampleRate);
-	}
-
-	for (uint32 i = 0; i < numSamples; i++)
+	BQF shelfDesign;
+	shelfDesign.SetHighShelf(1.5f, freqCenter, hiCutGain, (float)m_sampleRate);
+	m_hiShelf.SetCoefficients(shelfDesign);
+	m_apf.SetNumStages(m_stage);
+
+	uint32 i = currentSample < startSample ? Math::Min(startSample - currentSample, numSamples) : 0;
+	float dry[coefficientBlockSize * 2];
+	float shelved[coefficientBlockSize * 2];
+	while (i < numSamples)
 	{
-		if (currentSample + i < startSample)
-		{
-			continue;
-		}
+		const uint32 blockSize = Math::Min(coefficientBlockSize, numSamples - i);
+		m_currentSample = (m_currentSample + blockSize) % m_length;
 
+		// Interpolate towards the all-pass frequencies at the end of this block
 		float fLeft = abs(2.0f * ((float)m_currentSample / (float)m_length) - 1.0f);
 		float fRight = abs(2.0f * fmodf((float)m_currentSample / (float)m_length + stereoWidth, 1.0f) - 1.0f);
 		float f[2] = {fLeft, fRight};
+		BQF designs[2];
 		for (uint32 c = 0; c < 2; c++) {
 			// logarithmic interpolation
 			float freq = pow(fmin, f[c]) * pow(fmax, 1-f[c]);
-			float output = feedback * za[c] + out[i * 2 + c];
-			for (uint32 j = 0; j < m_stage; j++) {
-				m_apf[j][c].SetAllPass(q, freq, (float)m_sampleRate);
-				output = m_apf[j][c].Update(output);
-			}
-			za[c] = output;
+			designs[c].SetAllPass(q, freq, (float)m_sampleRate);
+		}
+		m_apf.SetCoefficients(designs[0], designs[1], true);
+
+		float *block = out + i * 2;
+		memcpy(dry, block, blockSize * 2 * sizeof(float));
+		m_apf.Process(block, blockSize, feedback);
+		for (uint32 j = 0; j < blockSize * 2; j++) {
 			// effect strongest when mix = 0.5
-			output = (mix/2) * output + (1-mix/2) * out[i * 2 + c];
-			float shelved = m_hiShelf[c].Update(output);
-			out[i * 2 + c] = mix * shelved + (1-mix) * output;
+			block[j] = (mix/2) * block[j] + (1-mix/2) * dry[j];
 		}
-		m_currentSample++;
-		m_currentSample %= m_length;
+		memcpy(shelved, block, blockSize * 2 * sizeof(float));
+		m_hiShelf.Process(shelved, blockSize);
+		for (uint32 j = 0; j < blockSize * 2; j++) {
+			block[j] = mix * shelved[j] + (1-mix) * block[j];
+		}
+		i += blockSize;
 	}
 }
 
@@ -532,6 +604,10 @@ FlangerDSP::FlangerDSP(uint32 sampleRate) : DSP()
 {
 	SetSampleRate(sampleRate);
 }
+String FlangerDSP::GetKey() const
+{
+	return DSP::GetKey() + Utility::Sprintf("|%u,%u,%u,%.9g,%.9g,%.9g", m_length, m_min, m_max, m_feedback, m_stereoWidth, m_volume);
+}
 void FlangerDSP::SetLength(double length)
 {
 	double flength = length / 1000.0 * m_sampleRate;
@@ -619,6 +695,10 @@ EchoDSP::EchoDSP(uint32 sampleRate) : DSP()
 {
 	SetSampleRate(sampleRate);
 }
+String EchoDSP::GetKey() const
+{
+	return DSP::GetKey() + Utility::Sprintf("|%u,%.9g", m_bufferLength, feedback);
+}
 void EchoDSP::SetLength(double length)
 {
 	double flength = length / 1000.0 * m_sampleRate;
@@ -671,6 +751,10 @@ SidechainDSP::SidechainDSP(uint32 sampleRate) : DSP()
 {
 	SetSampleRate(sampleRate);
 }
+String SidechainDSP::GetKey() const
+{
+	return DSP::GetKey() + Utility::Sprintf("|%u,%u,%u,%u,%.9g", m_length, m_attackTime, m_holdTime, m_releaseTime, ratio);
+}
 void SidechainDSP::SetLength(double length)
 {
 	double flength = length / 1000.0 * m_sampleRate;
@@ -780,6 +864,10 @@ PitchShiftDSP::~PitchShiftDSP()
 {
 	delete m_impl;
 }
+String PitchShiftDSP::GetKey() const
+{
+	return DSP::GetKey() + Utility::Sprintf("|%.9g", amount);
+}
 void PitchShiftDSP::Process(float *out, uint32 numSamples)
 {
 	m_impl->pitch = Math::Clamp(amount, -48.0f, 48.0f);
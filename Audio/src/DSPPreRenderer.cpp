@@ -0,0 +1,197 @@
+#include "stdafx.h"
+#include "DSPPreRenderer.hpp"
+#include "MixKernels.hpp"
+#include <thread>
+
+DSPPreRenderer::DSPPreRenderer(Ref<AudioStream> stream, Vector<DSP *> DSPs)
+	: m_stream(stream), m_DSPs(std::move(DSPs))
+{
+	// Time ranges including the parts each DSP reads from
+	struct Range
+	{
+		int64 begin;
+		int64 end;
+		uint32 index;
+	};
+	Vector<Range> ranges;
+	for (uint32 i = 0; i < m_DSPs.size(); i++)
+	{
+		DSP *dsp = m_DSPs[i];
+		int64 margin = dsp->GetReadMargin();
+		ranges.Add({(int64)dsp->startTime - margin, (int64)dsp->endTime + margin, i});
+	}
+	std::stable_sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) { return a.begin < b.begin; });
+
+	// Merge overlapping ranges
+	Vector<Vector<uint32>> clusterIndices;
+	int64 clusterEnd = 0;
+	for (const Range &range : ranges)
+	{
+		if (clusterIndices.empty() || range.begin >= clusterEnd)
+		{
+			clusterIndices.emplace_back();
+			clusterEnd = range.end;
+		}
+		clusterIndices.back().Add(range.index);
+		clusterEnd = Math::Max(clusterEnd, range.end);
+	}
+
+	for (Vector<uint32> &indices : clusterIndices)
+	{
+		// Keep the original order within a cluster so overlapping effects are applied the same way as before
+		std::sort(indices.begin(), indices.end());
+		Cluster cluster;
+		cluster.startTime = UINT32_MAX;
+		for (uint32 i : indices)
+		{
+			cluster.DSPs.Add(m_DSPs[i]);
+			cluster.startTime = Math::Min(cluster.startTime, m_DSPs[i]->startTime);
+		}
+		m_clusters.Add(std::move(cluster));
+	}
+
+	m_done.resize(m_clusters.size(), false);
+}
+DSPPreRenderer::~DSPPreRenderer()
+{
+	m_cancel = true;
+	for (Job &job : m_jobs)
+	{
+		job->Terminate();
+	}
+	for (DSP *dsp : m_DSPs)
+	{
+		dsp->RemoveAudioBase();
+		delete dsp;
+	}
+}
+void DSPPreRenderer::Start(JobSheduler *sheduler)
+{
+	m_timer.Restart();
+	if (!sheduler || m_clusters.empty())
+		return;
+
+	uint32 numJobs = Math::Min<uint32>((uint32)m_clusters.size(), Math::Max(1u, std::thread::hardware_concurrency()));
+	for (uint32 i = 0; i < numJobs; i++)
+	{
+		Job job = JobBase::CreateLambda([this]() {
+			while (m_RenderNext())
+				;
+			return true;
+		});
+		m_jobs.Add(job);
+		sheduler->Queue(job);
+	}
+}
+bool DSPPreRenderer::m_RenderNext(uint32 time)
+{
+	if (m_cancel)
+		return false;
+	// Clusters are sorted by start time, so the next one is the earliest that isn't claimed
+	uint32 index = m_nextCluster;
+	do
+	{
+		if (index >= m_clusters.size() || m_clusters[index].startTime >= time)
+			return false;
+	} while (!m_nextCluster.compare_exchange_weak(index, index + 1));
+
+	for (DSP *dsp : m_clusters[index].DSPs)
+	{
+		RenderDSP(m_stream.get(), dsp);
+	}
+
+	bool finished;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_done[index] = true;
+		m_numDone++;
+		while (m_firstPending < m_done.size() && m_done[m_firstPending])
+			m_firstPending++;
+		finished = m_numDone == m_clusters.size();
+	}
+	m_clusterDone.notify_all();
+
+	if (finished)
+	{
+		Logf("Pre-rendered %d effects in %d clusters in %.3fs", Logger::Severity::Info,
+			 m_DSPs.size(), m_clusters.size(), m_timer.SecondsAsDouble());
+		if (onFinished)
+			onFinished();
+	}
+	return true;
+}
+void DSPPreRenderer::WaitUntil(uint32 time, const std::function<void(float)> &onProgress)
+{
+	while (GetRenderedUntil() < time)
+	{
+		// Render on this thread as well, so this also works when all job threads are busy
+		//	clusters after time are left to the jobs
+		if (!m_RenderNext(time))
+		{
+			// Clusters before time are being rendered by other threads
+			std::unique_lock<std::mutex> lock(m_lock);
+			m_clusterDone.wait_for(lock, std::chrono::milliseconds(10));
+		}
+		if (onProgress)
+			onProgress(GetProgress());
+	}
+}
+void DSPPreRenderer::Wait(const std::function<void(float)> &onProgress)
+{
+	WaitUntil(UINT32_MAX, onProgress);
+}
+uint32 DSPPreRenderer::GetRenderedUntil() const
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	if (m_firstPending >= m_clusters.size())
+		return UINT32_MAX;
+	return m_clusters[m_firstPending].startTime;
+}
+float DSPPreRenderer::GetProgress() const
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_clusters.empty() ? 1.0f : (float)m_numDone / (float)m_clusters.size();
+}
+bool DSPPreRenderer::IsFinished() const
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_numDone == m_clusters.size();
+}
+void DSPPreRenderer::RenderDSP(AudioBase *audio, DSP *dsp)
+{
+	const uint64 sampleRate = audio->GetSampleRate();
+	const uint64 numSamplesTotal = audio->GetPCMCount();
+	uint64 startSample = ((uint64)dsp->startTime * sampleRate) / 1000;
+	uint64 endSample = Math::Min(((uint64)dsp->endTime * sampleRate) / 1000, numSamplesTotal);
+	if (startSample >= endSample)
+	{
+		Logf("Effect %s at %dms not rendered", Logger::Severity::Debug, dsp->GetName(), dsp->startTime);
+		return;
+	}
+
+	uint32 numSamples = (uint32)(endSample - startSample);
+	dsp->SetPreRenderPosition(startSample);
+	if (float *pcm = audio->GetPCM())
+	{
+		if (dsp->GetReadMargin() > 0)
+		{
+			// DSPs that read the stream themselves (retrigger) need to see it unchanged while processing
+			Vector<float> buffer(pcm + startSample * 2, pcm + endSample * 2);
+			dsp->Process(buffer.data(), numSamples);
+			memcpy(pcm + startSample * 2, buffer.data(), buffer.size() * sizeof(float));
+		}
+		else
+		{
+			dsp->Process(pcm + startSample * 2, numSamples);
+		}
+	}
+	else if (int16 *pcm16 = audio->GetPCM16())
+	{
+		Vector<float> buffer(numSamples * 2);
+		MixKernels::Get().Int16ToFloat(buffer.data(), pcm16 + startSample * 2, numSamples * 2);
+		dsp->Process(buffer.data(), numSamples);
+		MixKernels::Get().InterleaveInt16(pcm16 + startSample * 2, buffer.data(), numSamples, 2);
+	}
+	dsp->SetPreRenderPosition(-1);
+	Logf("Rendered %s at %dms with %d samples", Logger::Severity::Debug, dsp->GetName(), dsp->startTime, numSamples);
+}
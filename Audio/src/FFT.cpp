@@ -0,0 +1,69 @@
+#include "stdafx.h"
+#include "FFT.hpp"
+
+FFT::FFT(uint32 size) : m_size(size)
+{
+	assert(size > 0 && (size & (size - 1)) == 0);
+
+	m_twiddles.resize(size / 2);
+	for (uint32 i = 0; i < size / 2; i++)
+	{
+		const double angle = -2.0 * 3.14159265358979323846 * (double)i / (double)size;
+		m_twiddles[i] = std::complex<float>((float)cos(angle), (float)sin(angle));
+	}
+
+	uint32 numBits = 0;
+	while ((1u << numBits) < size)
+		numBits++;
+	m_reversed.resize(size);
+	for (uint32 i = 0; i < size; i++)
+	{
+		uint32 reversed = 0;
+		for (uint32 b = 0; b < numBits; b++)
+			reversed |= ((i >> b) & 1) << (numBits - 1 - b);
+		m_reversed[i] = reversed;
+	}
+}
+void FFT::Transform(std::complex<float> *data, bool inverse) const
+{
+	for (uint32 i = 0; i < m_size; i++)
+	{
+		const uint32 j = m_reversed[i];
+		if (i < j)
+			std::swap(data[i], data[j]);
+	}
+
+	for (uint32 half = 1; half < m_size; half *= 2)
+	{
+		// Every stage uses every (size / (2 * half))th twiddle factor
+		const uint32 stride = m_size / (half * 2);
+		for (uint32 start = 0; start < m_size; start += half * 2)
+		{
+			std::complex<float> *a = data + start;
+			std::complex<float> *b = a + half;
+			for (uint32 i = 0; i < half; i++)
+			{
+				const std::complex<float> w = m_twiddles[i * stride];
+				const float wi = inverse ? -w.imag() : w.imag();
+				// Written out because std::complex multiplication checks for infinities
+				const std::complex<float> t(w.real() * b[i].real() - wi * b[i].imag(), w.real() * b[i].imag() + wi * b[i].real());
+				b[i] = a[i] - t;
+				a[i] += t;
+			}
+		}
+	}
+
+	if (inverse)
+	{
+		const float scale = 1.0f / (float)m_size;
+		for (uint32 i = 0; i < m_size; i++)
+			data[i] *= scale;
+	}
+}
+uint32 FFT::GetPowerOfTwo(uint32 size)
+{
+	uint32 result = 1;
+	while (result < size)
+		result *= 2;
+	return result;
+}
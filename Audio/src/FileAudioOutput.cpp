@@ -0,0 +1,137 @@
+#include "stdafx.h"
+#include "FileAudioOutput.hpp"
+
+// WAVE_FORMAT_IEEE_FLOAT
+static const uint16 wavFormatFloat = 3;
+static const uint32 wavHeaderSize = 44;
+
+FileAudioOutput::FileAudioOutput(uint32 sampleRate, Pacing pacing, uint32 blockSize)
+	: m_sampleRate(sampleRate), m_blockSize(blockSize), m_pacing(pacing)
+{
+	m_buffer.resize(m_blockSize * GetNumChannels());
+}
+FileAudioOutput::~FileAudioOutput()
+{
+	Stop();
+	Close();
+}
+bool FileAudioOutput::Open(const String &path)
+{
+	Close();
+	// OpenWrite doesn't truncate existing files on every platform
+	Path::Delete(path);
+	if (!m_file.OpenWrite(path))
+		return false;
+
+	m_fileOpen = true;
+	m_framesWritten = 0;
+
+	// Write a placeholder header, the sizes get filled in when the file is closed
+	m_WriteHeader();
+	return true;
+}
+void FileAudioOutput::Close()
+{
+	if (!m_fileOpen)
+		return;
+
+	m_file.Seek(0);
+	m_WriteHeader();
+	m_file.Close();
+	m_fileOpen = false;
+}
+void FileAudioOutput::m_WriteHeader()
+{
+	const uint16 numChannels = (uint16)GetNumChannels();
+	const uint16 bitsPerSample = 32;
+	const uint16 blockAlign = numChannels * bitsPerSample / 8;
+	const uint32 byteRate = m_sampleRate * blockAlign;
+	const uint32 dataSize = (uint32)(m_framesWritten * blockAlign);
+	const uint32 riffSize = wavHeaderSize - 8 + dataSize;
+	const uint32 fmtSize = 16;
+
+	uint8 header[wavHeaderSize];
+	uint8 *ptr = header;
+	auto write = [&](const void *data, size_t len) {
+		memcpy(ptr, data, len);
+		ptr += len;
+	};
+	write("RIFF", 4);
+	write(&riffSize, 4);
+	write("WAVE", 4);
+	write("fmt ", 4);
+	write(&fmtSize, 4);
+	write(&wavFormatFloat, 2);
+	write(&numChannels, 2);
+	write(&m_sampleRate, 4);
+	write(&byteRate, 4);
+	write(&blockAlign, 2);
+	write(&bitsPerSample, 2);
+	write("data", 4);
+	write(&dataSize, 4);
+	assert(ptr == header + wavHeaderSize);
+
+	m_file.Write(header, wavHeaderSize);
+}
+void FileAudioOutput::m_RenderBlock(uint32 numFrames)
+{
+	Timer t;
+	m_mixer->Mix(m_buffer.data(), numFrames);
+	m_mixTime += t.SecondsAsDouble();
+
+	if (m_fileOpen)
+	{
+		m_file.Write(m_buffer.data(), numFrames * GetNumChannels() * sizeof(float));
+		m_framesWritten += numFrames;
+	}
+	m_framesRendered += numFrames;
+}
+uint64 FileAudioOutput::Render(uint64 numFrames)
+{
+	assert(m_pacing == Pacing::Manual);
+	if (!m_mixer)
+		return 0;
+
+	uint64 rendered = 0;
+	while (rendered < numFrames)
+	{
+		uint32 blockFrames = (uint32)Math::Min<uint64>(m_blockSize, numFrames - rendered);
+		m_RenderBlock(blockFrames);
+		rendered += blockFrames;
+	}
+	return rendered;
+}
+void FileAudioOutput::m_ThreadMain()
+{
+	Timer timer;
+	const uint64 startFrame = m_framesRendered;
+	while (m_running)
+	{
+		m_RenderBlock(m_blockSize);
+
+		if (m_pacing == Pacing::RealTime)
+		{
+			// Wait until a sound card would have consumed the rendered audio
+			double target = (double)(m_framesRendered - startFrame) / (double)m_sampleRate;
+			double ahead = target - timer.SecondsAsDouble();
+			if (ahead > 0.0)
+				std::this_thread::sleep_for(std::chrono::microseconds((int64)(ahead * 1000000.0)));
+		}
+	}
+}
+void FileAudioOutput::Start(IMixer *mixer)
+{
+	m_mixer = mixer;
+	if (m_pacing != Pacing::Manual)
+	{
+		m_running = true;
+		m_thread = std::thread(&FileAudioOutput::m_ThreadMain, this);
+	}
+}
+void FileAudioOutput::Stop()
+{
+	m_running = false;
+	if (m_thread.joinable())
+		m_thread.join();
+	m_mixer = nullptr;
+}
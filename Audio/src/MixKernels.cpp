@@ -0,0 +1,396 @@
+#include "stdafx.h"
+#include "MixKernels.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MIX_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define MIX_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Allows compiling functions for instruction sets that are not enabled for the whole project
+#if defined(__GNUC__) || defined(__clang__)
+#define MIX_TARGET(x) __attribute__((target(x)))
+#else
+#define MIX_TARGET(x)
+#endif
+
+/*
+	Scalar fallback, also used for the tails of the vectorized versions
+*/
+static void Accumulate_Scalar(float *dst, const float *src, float gain, uint32 count)
+{
+	for (uint32 i = 0; i < count; i++)
+	{
+		dst[i] += src[i] * gain;
+	}
+}
+static void GainClamp_Scalar(float *buffer, float gain, uint32 count)
+{
+	for (uint32 i = 0; i < count; i++)
+	{
+		// Safety clamp to [-1, 1] that should help protect speakers a bit in case of corruption
+		// this will clip, but so will values outside [-1, 1] anyway
+		buffer[i] = fmin(fmax(buffer[i] * gain, -1.f), 1.f);
+	}
+}
+static void InterleaveFloat_Scalar(float *dst, const float *src, uint32 numFrames, uint32 numChannels)
+{
+	if (numChannels == 2)
+	{
+		memcpy(dst, src, numFrames * 2 * sizeof(float));
+		return;
+	}
+	for (uint32 i = 0; i < numFrames; i++)
+	{
+		for (uint32 c = 0; c < 2 && c < numChannels; c++)
+		{
+			dst[i * numChannels + c] = src[i * 2 + c];
+		}
+	}
+}
+static inline int16 ToInt16(float v)
+{
+	return (int16)(0x7FFF * Math::Clamp(v, -1.f, 1.f));
+}
+static void InterleaveInt16_Scalar(int16 *dst, const float *src, uint32 numFrames, uint32 numChannels)
+{
+	for (uint32 i = 0; i < numFrames; i++)
+	{
+		for (uint32 c = 0; c < 2 && c < numChannels; c++)
+		{
+			dst[i * numChannels + c] = ToInt16(src[i * 2 + c]);
+		}
+	}
+}
+static const float int16Scale = 1.0f / (float)0x7FFF;
+static void Int16ToFloat_Scalar(float *dst, const int16 *src, uint32 count)
+{
+	for (uint32 i = 0; i < count; i++)
+	{
+		dst[i] = (float)src[i] * int16Scale;
+	}
+}
+
+#if MIX_X86
+/*
+	SSE2, 4 floats at a time
+*/
+MIX_TARGET("sse2")
+static void Accumulate_SSE2(float *dst, const float *src, float gain, uint32 count)
+{
+	const __m128 g = _mm_set1_ps(gain);
+	uint32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 d = _mm_loadu_ps(dst + i);
+		d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+		_mm_storeu_ps(dst + i, d);
+	}
+	Accumulate_Scalar(dst + i, src + i, gain, count - i);
+}
+MIX_TARGET("sse2")
+static void GainClamp_SSE2(float *buffer, float gain, uint32 count)
+{
+	const __m128 g = _mm_set1_ps(gain);
+	const __m128 lo = _mm_set1_ps(-1.f);
+	const __m128 hi = _mm_set1_ps(1.f);
+	uint32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		// max returns the second operand for NaN so this behaves the same as fmin(fmax(x, -1), 1)
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(buffer + i), g);
+		v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+		_mm_storeu_ps(buffer + i, v);
+	}
+	GainClamp_Scalar(buffer + i, gain, count - i);
+}
+MIX_TARGET("sse2")
+static void InterleaveInt16_SSE2(int16 *dst, const float *src, uint32 numFrames, uint32 numChannels)
+{
+	if (numChannels != 2)
+	{
+		InterleaveInt16_Scalar(dst, src, numFrames, numChannels);
+		return;
+	}
+
+	const __m128 scale = _mm_set1_ps((float)0x7FFF);
+	const __m128 lo = _mm_set1_ps(-1.f);
+	const __m128 hi = _mm_set1_ps(1.f);
+	const uint32 count = numFrames * 2;
+	uint32 i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), lo), hi);
+		__m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), lo), hi);
+		// Truncating conversion, same as the scalar cast
+		__m128i ia = _mm_cvttps_epi32(_mm_mul_ps(a, scale));
+		__m128i ib = _mm_cvttps_epi32(_mm_mul_ps(b, scale));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(ia, ib));
+	}
+	for (; i < count; i++)
+	{
+		dst[i] = ToInt16(src[i]);
+	}
+}
+MIX_TARGET("sse2")
+static void Int16ToFloat_SSE2(float *dst, const int16 *src, uint32 count)
+{
+	const __m128 scale = _mm_set1_ps(int16Scale);
+	uint32 i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		// Sign extend by placing the values in the upper halves and shifting them back down
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+	Int16ToFloat_Scalar(dst + i, src + i, count - i);
+}
+
+/*
+	AVX2, 8 floats at a time
+	multiply and add are kept separate (no FMA) so that all implementations produce identical output
+*/
+MIX_TARGET("avx2")
+static void Accumulate_AVX2(float *dst, const float *src, float gain, uint32 count)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+	uint32 i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 d = _mm256_loadu_ps(dst + i);
+		d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps(src + i), g));
+		_mm256_storeu_ps(dst + i, d);
+	}
+	Accumulate_Scalar(dst + i, src + i, gain, count - i);
+}
+MIX_TARGET("avx2")
+static void GainClamp_AVX2(float *buffer, float gain, uint32 count)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+	const __m256 lo = _mm256_set1_ps(-1.f);
+	const __m256 hi = _mm256_set1_ps(1.f);
+	uint32 i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 v = _mm256_mul_ps(_mm256_loadu_ps(buffer + i), g);
+		v = _mm256_min_ps(_mm256_max_ps(v, lo), hi);
+		_mm256_storeu_ps(buffer + i, v);
+	}
+	GainClamp_Scalar(buffer + i, gain, count - i);
+}
+MIX_TARGET("avx2")
+static void InterleaveInt16_AVX2(int16 *dst, const float *src, uint32 numFrames, uint32 numChannels)
+{
+	if (numChannels != 2)
+	{
+		InterleaveInt16_Scalar(dst, src, numFrames, numChannels);
+		return;
+	}
+
+	const __m256 scale = _mm256_set1_ps((float)0x7FFF);
+	const __m256 lo = _mm256_set1_ps(-1.f);
+	const __m256 hi = _mm256_set1_ps(1.f);
+	const uint32 count = numFrames * 2;
+	uint32 i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), lo), hi);
+		__m256i iv = _mm256_cvttps_epi32(_mm256_mul_ps(v, scale));
+		// Pack the two 128-bit halves in order
+		__m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(iv), _mm256_extracti128_si256(iv, 1));
+		_mm_storeu_si128((__m128i *)(dst + i), packed);
+	}
+	for (; i < count; i++)
+	{
+		dst[i] = ToInt16(src[i]);
+	}
+}
+MIX_TARGET("avx2")
+static void Int16ToFloat_AVX2(float *dst, const int16 *src, uint32 count)
+{
+	const __m256 scale = _mm256_set1_ps(int16Scale);
+	uint32 i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+		_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+	}
+	Int16ToFloat_Scalar(dst + i, src + i, count - i);
+}
+
+static bool CpuSupportsSSE2()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+	return true;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+static bool CpuSupportsAVX2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx)
+		return false;
+	// Check if the OS saves the ymm registers
+	if ((_xgetbv(0) & 0x6) != 0x6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#if MIX_NEON
+/*
+	NEON, 4 floats at a time
+*/
+static void Accumulate_NEON(float *dst, const float *src, float gain, uint32 count)
+{
+	const float32x4_t g = vdupq_n_f32(gain);
+	uint32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t d = vld1q_f32(dst + i);
+		d = vaddq_f32(d, vmulq_f32(vld1q_f32(src + i), g));
+		vst1q_f32(dst + i, d);
+	}
+	Accumulate_Scalar(dst + i, src + i, gain, count - i);
+}
+static void GainClamp_NEON(float *buffer, float gain, uint32 count)
+{
+	const float32x4_t g = vdupq_n_f32(gain);
+	const float32x4_t lo = vdupq_n_f32(-1.f);
+	const float32x4_t hi = vdupq_n_f32(1.f);
+	uint32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t v = vmulq_f32(vld1q_f32(buffer + i), g);
+		// vmaxq returns NaN if either operand is NaN, replace NaN with -1 first to match fmin(fmax(x, -1), 1)
+		v = vbslq_f32(vceqq_f32(v, v), v, lo);
+		v = vminq_f32(vmaxq_f32(v, lo), hi);
+		vst1q_f32(buffer + i, v);
+	}
+	GainClamp_Scalar(buffer + i, gain, count - i);
+}
+static void InterleaveInt16_NEON(int16 *dst, const float *src, uint32 numFrames, uint32 numChannels)
+{
+	if (numChannels != 2)
+	{
+		InterleaveInt16_Scalar(dst, src, numFrames, numChannels);
+		return;
+	}
+
+	const float32x4_t scale = vdupq_n_f32((float)0x7FFF);
+	const float32x4_t lo = vdupq_n_f32(-1.f);
+	const float32x4_t hi = vdupq_n_f32(1.f);
+	const uint32 count = numFrames * 2;
+	uint32 i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		float32x4_t a = vminq_f32(vmaxq_f32(vld1q_f32(src + i), lo), hi);
+		float32x4_t b = vminq_f32(vmaxq_f32(vld1q_f32(src + i + 4), lo), hi);
+		// vcvtq truncates towards zero, same as the scalar cast
+		int16x4_t ia = vqmovn_s32(vcvtq_s32_f32(vmulq_f32(a, scale)));
+		int16x4_t ib = vqmovn_s32(vcvtq_s32_f32(vmulq_f32(b, scale)));
+		vst1q_s16(dst + i, vcombine_s16(ia, ib));
+	}
+	for (; i < count; i++)
+	{
+		dst[i] = ToInt16(src[i]);
+	}
+}
+static void Int16ToFloat_NEON(float *dst, const int16 *src, uint32 count)
+{
+	const float32x4_t scale = vdupq_n_f32(int16Scale);
+	uint32 i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		int16x8_t v = vld1q_s16(src + i);
+		vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+		vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+	}
+	Int16ToFloat_Scalar(dst + i, src + i, count - i);
+}
+#endif
+
+static const MixKernels scalarKernels = {
+	"Scalar",
+	&Accumulate_Scalar,
+	&GainClamp_Scalar,
+	&InterleaveFloat_Scalar,
+	&InterleaveInt16_Scalar,
+	&Int16ToFloat_Scalar,
+};
+#if MIX_X86
+static const MixKernels sse2Kernels = {
+	"SSE2",
+	&Accumulate_SSE2,
+	&GainClamp_SSE2,
+	&InterleaveFloat_Scalar,
+	&InterleaveInt16_SSE2,
+	&Int16ToFloat_SSE2,
+};
+static const MixKernels avx2Kernels = {
+	"AVX2",
+	&Accumulate_AVX2,
+	&GainClamp_AVX2,
+	&InterleaveFloat_Scalar,
+	&InterleaveInt16_AVX2,
+	&Int16ToFloat_AVX2,
+};
+#endif
+#if MIX_NEON
+static const MixKernels neonKernels = {
+	"NEON",
+	&Accumulate_NEON,
+	&GainClamp_NEON,
+	&InterleaveFloat_Scalar,
+	&InterleaveInt16_NEON,
+	&Int16ToFloat_NEON,
+};
+#endif
+
+Vector<const MixKernels *> MixKernels::GetSupported()
+{
+	Vector<const MixKernels *> ret;
+	ret.Add(&scalarKernels);
+#if MIX_X86
+	if (CpuSupportsSSE2())
+		ret.Add(&sse2Kernels);
+	if (CpuSupportsAVX2())
+		ret.Add(&avx2Kernels);
+#endif
+#if MIX_NEON
+	ret.Add(&neonKernels);
+#endif
+	return ret;
+}
+const MixKernels &MixKernels::Get()
+{
+	// The last supported implementation is the fastest one
+	static const MixKernels *selected = GetSupported().back();
+	return *selected;
+}
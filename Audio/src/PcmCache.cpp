@@ -0,0 +1,368 @@
+#include "stdafx.h"
+#include "PcmCache.hpp"
+#include <Shared/Files.hpp>
+#include <ctime>
+
+static const char cacheMagic[4] = {'U', 'P', 'C', 'M'};
+static const char *indexFileName = "index.txt";
+
+// FNV-1a, used to turn a key into a cache file name
+static uint64 HashString(const String &str)
+{
+	uint64 hash = 14695981039346656037ull;
+	for (char c : str)
+	{
+		hash ^= (uint8)c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+// FNV-1a over 8 bytes at a time, identifies source files by their contents
+static uint64 HashData(const uint8 *data, size_t size)
+{
+	uint64 hash = 14695981039346656037ull;
+	size_t i = 0;
+	for (; i + sizeof(uint64) <= size; i += sizeof(uint64))
+	{
+		uint64 word;
+		memcpy(&word, data + i, sizeof(uint64));
+		hash ^= word;
+		hash *= 1099511628211ull;
+	}
+	for (; i < size; i++)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+PcmCache::~PcmCache()
+{
+	Configure(String(), 0);
+}
+void PcmCache::Configure(const String &directory, uint64 maxSize)
+{
+	// Finish writing to the old location first
+	if (m_writer.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_stop = true;
+		}
+		m_signal.notify_all();
+		m_writer.join();
+	}
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_stop = false;
+	m_entries.clear();
+	m_directory.clear();
+	m_maxSize = 0;
+	if (directory.empty() || maxSize == 0)
+		return;
+
+	if (!Path::IsDirectory(directory))
+		Path::CreateDirRecursive(directory);
+	if (!Path::IsDirectory(directory))
+	{
+		Logf("Failed to create audio cache folder %s", Logger::Severity::Warning, directory);
+		return;
+	}
+	// Same form as the paths returned by the file scanner
+	m_directory = Path::Normalize(directory);
+	m_maxSize = maxSize;
+	m_LoadIndex();
+	m_Evict();
+
+	m_writer = std::thread(&PcmCache::m_WriterMain, this);
+}
+bool PcmCache::IsEnabled() const
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_maxSize > 0;
+}
+String PcmCache::m_GetFilePath(const String &name) const
+{
+	// Not normalized, the file might not exist yet
+	return m_directory + Path::sep + name;
+}
+bool PcmCache::m_MakeHeader(const String &path, uint32 outputRate, PcmCacheFormat format, const String &variant, const String &variantKey, PcmCacheHeader &header, String &name) const
+{
+	MappedFile source;
+	if (!source.Open(path))
+		return false;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = PcmCacheHeader::currentVersion;
+	header.format = format;
+	header.numChannels = 2;
+	header.outputRate = outputRate;
+	header.sourceSize = source.GetSize();
+	header.sourceHash = HashData(source.GetData(), source.GetSize());
+	header.variantHash = variantKey.empty() ? 0 : HashString(variantKey);
+
+	// Copies of the same file share their entries, edits to it result in a new one
+	String key = Utility::Sprintf("%016llx|%llu|%u|%u", header.sourceHash, header.sourceSize, outputRate, (uint32)format);
+	if (!variant.empty())
+		key += "|" + variant;
+	name = Utility::Sprintf("%016llx.pcm", HashString(key));
+	return true;
+}
+Ref<MappedFile> PcmCache::Load(const String &path, uint32 outputRate, PcmCacheFormat format, PcmCacheHeader &header, const String &variant, const String &variantKey)
+{
+	if (!IsEnabled())
+		return Ref<MappedFile>();
+
+	PcmCacheHeader expected;
+	String name;
+	if (!m_MakeHeader(path, outputRate, format, variant, variantKey, expected, name))
+		return Ref<MappedFile>();
+
+	String filePath = m_GetFilePath(name);
+	if (!Path::FileExists(filePath))
+		return Ref<MappedFile>();
+
+	// Mapped as copy on write since preloaded pcm data may be modified by pre-rendered effects
+	Ref<MappedFile> file = std::make_shared<MappedFile>();
+	if (!file->Open(filePath, true) || file->GetSize() < sizeof(PcmCacheHeader))
+		return Ref<MappedFile>();
+
+	memcpy(&header, file->GetData(), sizeof(PcmCacheHeader));
+	// Superseded variant, replaced when the new one is stored
+	if (header.version == PcmCacheHeader::currentVersion && header.variantHash != expected.variantHash)
+		return Ref<MappedFile>();
+	bool valid = memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 &&
+				 header.version == PcmCacheHeader::currentVersion &&
+				 header.format == format &&
+				 header.numChannels == 2 &&
+				 header.outputRate == outputRate &&
+				 header.sourceSize == expected.sourceSize &&
+				 header.sourceHash == expected.sourceHash &&
+				 file->GetSize() >= sizeof(PcmCacheHeader) + header.numFrames * 2 * GetPcmSampleSize(format);
+	if (!valid)
+	{
+		// Stale or damaged, it would never become valid again
+		Logf("Removing invalid audio cache entry %s", Logger::Severity::Warning, name);
+		file.reset();
+		Path::Delete(filePath);
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_entries.erase(name);
+			m_indexDirty = true;
+		}
+		m_signal.notify_all();
+		return Ref<MappedFile>();
+	}
+
+	// Mark as recently used and keep it from being evicted while mapped
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		Entry &entry = m_entries.FindOrAdd(name, {file->GetSize(), 0});
+		entry.lastUsed = (uint64)time(nullptr);
+		m_mapped.FindOrAdd(filePath, 0)++;
+		m_indexDirty = true;
+	}
+	m_signal.notify_all();
+
+	// The file is unmapped before it is released so it can be deleted right away
+	return Ref<MappedFile>(file.get(), [this, filePath, file](MappedFile *) mutable {
+		file.reset();
+		m_Release(filePath);
+	});
+}
+void PcmCache::m_Release(const String &filePath)
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		uint32 *count = m_mapped.Find(filePath);
+		assert(count);
+		if (--*count > 0)
+			return;
+		m_mapped.erase(filePath);
+
+		// Might have been skipped while it was mapped
+		m_Evict();
+	}
+	m_signal.notify_all();
+}
+void PcmCache::Store(const String &path, uint32 outputRate, PcmCacheFormat format, const void *pcm, uint64 numFrames, uint32 sampleRate, Ref<void> owner, const String &variant, const String &variantKey)
+{
+	if (!IsEnabled() || !pcm || numFrames == 0)
+		return;
+
+	// Hashed on the writer thread so storing doesn't hold up loading
+	PendingWrite write = {path, outputRate, format, variant, variantKey, pcm, numFrames, sampleRate, std::move(owner)};
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_pending.push_back(std::move(write));
+	}
+	m_signal.notify_all();
+}
+void PcmCache::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_written.wait(lock, [this]() { return m_pending.empty() && !m_writing; });
+}
+void PcmCache::m_WriterMain()
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	while (true)
+	{
+		m_signal.wait(lock, [this]() { return m_stop || !m_pending.empty() || m_indexDirty; });
+
+		if (!m_pending.empty())
+		{
+			PendingWrite write = std::move(m_pending.front());
+			m_pending.erase(m_pending.begin());
+			m_writing = true;
+			lock.unlock();
+
+			PcmCacheHeader header;
+			String name;
+			uint64 size = 0;
+			if (m_MakeHeader(write.path, write.outputRate, write.format, write.variant, write.variantKey, header, name))
+			{
+				header.sampleRate = write.sampleRate;
+				header.numFrames = write.numFrames;
+				lock.lock();
+				bool exists = m_entries.Contains(name);
+				// Superseded entries are replaced, unless they are still mapped
+				bool mapped = m_mapped.Contains(m_GetFilePath(name));
+				lock.unlock();
+				if (!exists || (!mapped && !m_IsSameEntry(name, header)))
+					size = m_Write(write, name, header);
+			}
+			// Released without holding the lock, it might be the last reference to a stream
+			write.owner.reset();
+
+			lock.lock();
+			m_writing = false;
+			if (size > 0)
+			{
+				m_entries.Add(name, {size, (uint64)time(nullptr)});
+				m_Evict();
+				m_indexDirty = true;
+			}
+			m_written.notify_all();
+			continue;
+		}
+
+		if (m_indexDirty)
+		{
+			m_SaveIndex();
+			m_indexDirty = false;
+		}
+
+		// Queued writes are always finished before stopping
+		if (m_stop)
+			break;
+	}
+}
+bool PcmCache::m_IsSameEntry(const String &name, const PcmCacheHeader &header) const
+{
+	File file;
+	PcmCacheHeader stored;
+	if (!file.OpenRead(m_GetFilePath(name)) || file.Read(&stored, sizeof(PcmCacheHeader)) != sizeof(PcmCacheHeader))
+		return false;
+	stored.numFrames = header.numFrames;
+	stored.sampleRate = header.sampleRate;
+	return memcmp(&stored, &header, sizeof(PcmCacheHeader)) == 0;
+}
+uint64 PcmCache::m_Write(const PendingWrite &write, const String &name, const PcmCacheHeader &header)
+{
+	// Written to a temporary file first so a partially written entry is never loaded
+	String filePath = m_GetFilePath(name);
+	String tempPath = filePath + ".tmp";
+	Path::Delete(tempPath);
+
+	File file;
+	if (!file.OpenWrite(tempPath))
+		return 0;
+	size_t dataSize = (size_t)(write.numFrames * 2 * GetPcmSampleSize(write.format));
+	bool ok = file.Write(&header, sizeof(PcmCacheHeader)) == sizeof(PcmCacheHeader) &&
+			  file.Write(write.pcm, dataSize) == dataSize;
+	file.Close();
+
+	if (!ok || !Path::Rename(tempPath, filePath, true))
+	{
+		Logf("Failed to write audio cache entry %s", Logger::Severity::Warning, name);
+		Path::Delete(tempPath);
+		return 0;
+	}
+	Logf("Cached decoded audio in %s (%.1f MB)", Logger::Severity::Info, name, (double)dataSize / (1024.0 * 1024.0));
+	return sizeof(PcmCacheHeader) + dataSize;
+}
+void PcmCache::m_Evict()
+{
+	uint64 totalSize = 0;
+	for (auto &entry : m_entries)
+		totalSize += entry.second.size;
+
+	while (totalSize > m_maxSize)
+	{
+		auto oldest = m_entries.end();
+		for (auto it = m_entries.begin(); it != m_entries.end(); it++)
+		{
+			// Deleting a mapped file fails on Windows, it is removed once released instead
+			if (m_mapped.Contains(m_GetFilePath(it->first)))
+				continue;
+			if (oldest == m_entries.end() || it->second.lastUsed < oldest->second.lastUsed)
+				oldest = it;
+		}
+		if (oldest == m_entries.end())
+			break;
+
+		Logf("Removing audio cache entry %s", Logger::Severity::Info, oldest->first);
+		Path::Delete(m_GetFilePath(oldest->first));
+		totalSize -= oldest->second.size;
+		m_entries.erase(oldest);
+		m_indexDirty = true;
+	}
+}
+void PcmCache::m_LoadIndex()
+{
+	// Usage times from previous sessions
+	Map<String, uint64> lastUsed;
+	File indexFile;
+	String indexPath = m_GetFilePath(indexFileName);
+	if (Path::FileExists(indexPath) && indexFile.OpenRead(indexPath) && indexFile.GetSize() > 0)
+	{
+		String text;
+		text.resize(indexFile.GetSize());
+		indexFile.Read(&text.front(), text.size());
+		for (const String &line : text.Explode("\n"))
+		{
+			char name[64];
+			unsigned long long time;
+			if (sscanf(*line, "%63s %llu", name, &time) == 2)
+				lastUsed.Add(name, time);
+		}
+	}
+
+	// Files on disk are the actual contents of the cache
+	for (const FileInfo &info : Files::ScanFiles(m_directory, "pcm"))
+	{
+		File file;
+		if (!file.OpenRead(info.fullPath))
+			continue;
+		String name;
+		Path::RemoveLast(info.fullPath, &name);
+
+		uint64 *time = lastUsed.Find(name);
+		m_entries.Add(name, {file.GetSize(), time ? *time : File::FileTimeToUnixTimestamp(info.lastWriteTime)});
+	}
+}
+void PcmCache::m_SaveIndex()
+{
+	String text;
+	for (auto &entry : m_entries)
+		text += Utility::Sprintf("%s %llu\n", entry.first, entry.second.lastUsed);
+
+	File indexFile;
+	String indexPath = m_GetFilePath(indexFileName);
+	Path::Delete(indexPath);
+	if (indexFile.OpenWrite(indexPath))
+		indexFile.Write(text.data(), text.size());
+}
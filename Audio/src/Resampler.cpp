@@ -0,0 +1,269 @@
+#include "stdafx.h"
+#include "Resampler.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RESAMPLER_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RESAMPLER_NEON
+#endif
+
+static_assert(Resampler::numTaps % 4 == 0, "Tap count must be a multiple of the vector width");
+
+// Cutoffs are rounded to this many steps so streams with similar ratios share a table
+static const double cutoffSteps = 4096.0;
+
+static uint32 GetCutoffKey(double ratio)
+{
+	// Lower the cutoff when downsampling to prevent aliasing, keep some headroom for the filter transition band
+	const double cutoff = Math::Min(1.0, 1.0 / ratio) * 0.9;
+	return (uint32)Math::Max(1.0, floor(cutoff * cutoffSteps + 0.5));
+}
+static Resampler::Table* BuildTable(uint32 key)
+{
+	const uint32 numTaps = Resampler::numTaps;
+	const uint32 numPhases = Resampler::numPhases;
+	Resampler::Table* table = new Resampler::Table();
+	table->cutoff = (double)key / cutoffSteps;
+
+	const double halfTaps = numTaps / 2;
+	table->coefficients.resize((numPhases + 1) * numTaps);
+	for (uint32 p = 0; p <= numPhases; p++)
+	{
+		double fraction = (double)p / (double)numPhases;
+		float *row = table->coefficients.data() + p * numTaps;
+		double sum = 0.0;
+		for (uint32 k = 0; k < numTaps; k++)
+		{
+			// Distance of this tap to the interpolated position
+			double d = (double)k - (halfTaps - 1.0) - fraction;
+			double x = Math::pi * table->cutoff * d;
+			double sinc = fabs(x) < 1e-9 ? 1.0 : sin(x) / x;
+			// Blackman window
+			double w = Math::Clamp(d / halfTaps, -1.0, 1.0);
+			double window = 0.42 + 0.5 * cos(Math::pi * w) + 0.08 * cos(2.0 * Math::pi * w);
+			double coefficient = sinc * window;
+			row[k] = (float)coefficient;
+			sum += coefficient;
+		}
+		// Normalize to unity gain at DC
+		for (uint32 k = 0; k < numTaps; k++)
+			row[k] = (float)(row[k] / sum);
+	}
+	return table;
+}
+
+/*
+	Filter tables of all resamplers, tables are never freed so the audio thread only has to swap a pointer
+	Tables requested by the audio thread are built on a separate thread
+*/
+class ResamplerTables
+{
+public:
+	ResamplerTables()
+	{
+		m_requests.reserve(32);
+		m_thread = std::thread(&ResamplerTables::m_Run, this);
+	}
+	~ResamplerTables()
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_stop = true;
+		}
+		m_signal.notify_one();
+		m_thread.join();
+		for (auto &it : m_tables)
+			delete it.second;
+	}
+
+	// Returns the table for key, builds it on the calling thread if it doesn't exist yet
+	const Resampler::Table *Get(uint32 key)
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			Resampler::Table **found = m_tables.Find(key);
+			if (found)
+				return *found;
+		}
+
+		Resampler::Table *table = BuildTable(key);
+		std::lock_guard<std::mutex> guard(m_lock);
+		Resampler::Table **found = m_tables.Find(key);
+		if (found)
+		{
+			// Built by another thread in the meantime
+			delete table;
+			return *found;
+		}
+		m_tables.Add(key, table);
+		return table;
+	}
+	// Returns the table for key without blocking, nullptr if it isn't built yet
+	//	missing tables are requested from the builder thread
+	const Resampler::Table *TryGet(uint32 key)
+	{
+		std::unique_lock<std::mutex> guard(m_lock, std::try_to_lock);
+		if (!guard.owns_lock())
+			return nullptr;
+		Resampler::Table **found = m_tables.Find(key);
+		if (found)
+			return *found;
+		if (m_requests.Contains(key))
+			return nullptr;
+		m_requests.Add(key);
+		guard.unlock();
+		m_signal.notify_one();
+		return nullptr;
+	}
+
+private:
+	void m_Run()
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		while (true)
+		{
+			m_signal.wait(guard, [this]() { return m_stop || !m_requests.empty(); });
+			if (m_stop)
+				return;
+
+			const uint32 key = m_requests.front();
+			guard.unlock();
+			Get(key);
+			guard.lock();
+			m_requests.Remove(key);
+		}
+	}
+
+	std::mutex m_lock;
+	std::condition_variable m_signal;
+	Map<uint32, Resampler::Table *> m_tables;
+	Vector<uint32> m_requests;
+	bool m_stop = false;
+	std::thread m_thread;
+};
+static ResamplerTables &GetTables()
+{
+	static ResamplerTables tables;
+	return tables;
+}
+
+Resampler::Resampler()
+{
+	Reset();
+}
+void Resampler::Prepare(double ratio)
+{
+	if (ratio != 1.0)
+		GetTables().Get(GetCutoffKey(ratio));
+}
+void Resampler::Reset()
+{
+	memset(m_history, 0, sizeof(m_history));
+	m_writePos = 0;
+}
+void Resampler::SetQuality(ResamplerQuality quality)
+{
+	m_quality = quality;
+	m_UpdateTable();
+}
+void Resampler::SetRatio(double ratio)
+{
+	m_bypass = ratio == 1.0;
+	m_cutoff = (double)GetCutoffKey(ratio) / cutoffSteps;
+	m_UpdateTable();
+}
+void Resampler::m_UpdateTable()
+{
+	if (m_quality != ResamplerQuality::Sinc || m_bypass)
+		return;
+	if (m_table && m_table->cutoff == m_cutoff)
+		return;
+
+	const Resampler::Table *table = GetTables().TryGet((uint32)(m_cutoff * cutoffSteps + 0.5));
+	if (table)
+		m_table = table;
+}
+void Resampler::Interpolate(float fraction, float *out) const
+{
+	const float *left = m_history[0] + m_writePos + 1;
+	const float *right = m_history[1] + m_writePos + 1;
+
+	if (m_quality == ResamplerQuality::Fast)
+	{
+		out[0] = left[numTaps - 1];
+		out[1] = right[numTaps - 1];
+		return;
+	}
+	if (m_quality == ResamplerQuality::Linear)
+	{
+		out[0] = left[numTaps - 2] + (left[numTaps - 1] - left[numTaps - 2]) * fraction;
+		out[1] = right[numTaps - 2] + (right[numTaps - 1] - right[numTaps - 2]) * fraction;
+		return;
+	}
+
+	if (m_bypass || !m_table)
+	{
+		// Same delay as the filter so switching between them doesn't shift the audio
+		const uint32 center = numTaps / 2 - 1;
+		out[0] = left[center] + (left[center + 1] - left[center]) * fraction;
+		out[1] = right[center] + (right[center + 1] - right[center]) * fraction;
+		return;
+	}
+
+	// Blend between the two closest filter phases
+	float phase = fraction * (float)numPhases;
+	uint32 phaseIndex = Math::Min((uint32)phase, numPhases - 1);
+	float blend = phase - (float)phaseIndex;
+	const float *row0 = m_table->coefficients.data() + phaseIndex * numTaps;
+	const float *row1 = row0 + numTaps;
+
+#if defined(RESAMPLER_SSE)
+	__m128 vblend = _mm_set1_ps(blend);
+	__m128 accL = _mm_setzero_ps();
+	__m128 accR = _mm_setzero_ps();
+	for (uint32 k = 0; k < numTaps; k += 4)
+	{
+		__m128 c0 = _mm_loadu_ps(row0 + k);
+		__m128 c1 = _mm_loadu_ps(row1 + k);
+		__m128 c = _mm_add_ps(c0, _mm_mul_ps(_mm_sub_ps(c1, c0), vblend));
+		accL = _mm_add_ps(accL, _mm_mul_ps(c, _mm_loadu_ps(left + k)));
+		accR = _mm_add_ps(accR, _mm_mul_ps(c, _mm_loadu_ps(right + k)));
+	}
+	// Horizontal sums of both accumulators
+	__m128 lo = _mm_unpacklo_ps(accL, accR); // L0 R0 L1 R1
+	__m128 hi = _mm_unpackhi_ps(accL, accR); // L2 R2 L3 R3
+	__m128 sum = _mm_add_ps(lo, hi);
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	_mm_storel_pi((__m64 *)out, sum);
+#elif defined(RESAMPLER_NEON)
+	float32x4_t accL = vdupq_n_f32(0.0f);
+	float32x4_t accR = vdupq_n_f32(0.0f);
+	for (uint32 k = 0; k < numTaps; k += 4)
+	{
+		float32x4_t c0 = vld1q_f32(row0 + k);
+		float32x4_t c1 = vld1q_f32(row1 + k);
+		float32x4_t c = vmlaq_n_f32(c0, vsubq_f32(c1, c0), blend);
+		accL = vmlaq_f32(accL, c, vld1q_f32(left + k));
+		accR = vmlaq_f32(accR, c, vld1q_f32(right + k));
+	}
+	float32x2_t sumL = vadd_f32(vget_low_f32(accL), vget_high_f32(accL));
+	float32x2_t sumR = vadd_f32(vget_low_f32(accR), vget_high_f32(accR));
+	vst1_f32(out, vpadd_f32(sumL, sumR));
+#else
+	float accL = 0.0f;
+	float accR = 0.0f;
+	for (uint32 k = 0; k < numTaps; k++)
+	{
+		float c = row0[k] + (row1[k] - row0[k]) * blend;
+		accL += c * left[k];
+		accR += c * right[k];
+	}
+	out[0] = accL;
+	out[1] = accR;
+#endif
+}
@@ -2,6 +2,7 @@
 #include "Sample.hpp"
 #include "Audio_Impl.hpp"
 #include "Audio.hpp"
+#include "MixKernels.hpp"
 
 #include "extras/dr_wav.h"   // Enables WAV decoding.
 #include "extras/dr_flac.h"  // Enables FLAC decoding.
@@ -14,16 +15,56 @@
 class Sample_Impl : public SampleRes
 {
 public:
+	static const uint32 voiceLimit = 16;
+
 	Buffer m_data;
 	Audio *m_audio;
+	// Only one of these is set depending on Audio_Impl::compactPcm
 	float *m_pcm = nullptr;
+	int16 *m_pcm16 = nullptr;
+	uint64 m_length = 0;
 
-	mutex m_lock;
+	struct Voice
+	{
+		uint64 position = 0;
+		// Order in which voices were started, used to pick the oldest one to cut off
+		uint64 startIndex = 0;
+		bool active = false;
+		bool looping = false;
+	};
+	// Only touched by the audio thread
+	Voice m_voices[voiceLimit];
+	uint64 m_numStarted = 0;
+	std::atomic<uint32> m_maxVoices = { 8 };
+	// Voices playing or waiting for their clock
+	std::atomic<uint32> m_numActive = { 0 };
 
-	uint64 m_playbackPointer = 0;
-	uint64 m_length = 0;
-	bool m_playing = false;
-	bool m_looping = false;
+	enum class CommandType : uint8
+	{
+		Play,
+		PlayLooping,
+	};
+	struct Command
+	{
+		CommandType type;
+		// Audio whose position samplePos refers to, nullptr to run the command right away
+		AudioBase *clock;
+		// Generation of clock when the play was scheduled
+		uint64 clockGeneration;
+		int64 samplePos;
+		// Number of calls to Stop before this command
+		uint32 numStops;
+	};
+	// Requests from Play, picked up by the audio thread on the next block
+	CommandQueue<Command, 64> m_commands;
+	// Stop bypasses the queue so it can never be dropped, commands are ordered against it by their numStops
+	std::atomic<uint32> m_numStops = { 0 };
+	// Only touched by the audio thread
+	uint32 m_numStopsApplied = 0;
+	// Plays waiting for their clock, only touched by the audio thread
+	static const uint32 maxScheduled = 16;
+	Command m_scheduled[maxScheduled];
+	uint32 m_numScheduled = 0;
 
 public:
 	~Sample_Impl()
@@ -33,62 +74,205 @@ public:
 		{
 			ma_free(m_pcm);
 		}
+		if (m_pcm16)
+		{
+			ma_free(m_pcm16);
+		}
+	}
+	void m_PushCommand(CommandType type, AudioBase *clock = nullptr, int64 samplePos = 0)
+	{
+		// When full, more triggers within a single block than there are voices can't be heard anyway
+		m_commands.Push({type, clock, clock ? clock->GetClockGeneration() : 0, samplePos, m_numStops.load(std::memory_order_relaxed)});
+	}
+	void m_StartVoice(bool looping)
+	{
+		const uint32 maxVoices = m_maxVoices;
+		Voice *voice = nullptr;
+		for (uint32 i = 0; i < maxVoices; i++)
+		{
+			Voice &candidate = m_voices[i];
+			if (!candidate.active)
+			{
+				voice = &candidate;
+				break;
+			}
+			if (!voice || candidate.startIndex < voice->startIndex)
+				voice = &candidate;
+		}
+		voice->position = 0;
+		voice->startIndex = m_numStarted++;
+		voice->active = true;
+		voice->looping = looping;
+	}
+	void m_RunCommand(CommandType type)
+	{
+		if (type == CommandType::PlayLooping)
+		{
+			// Looping plays restart the sample instead of overlapping
+			for (Voice &voice : m_voices)
+				voice.active = false;
+		}
+		m_StartVoice(type == CommandType::PlayLooping);
+	}
+	void m_ApplyStop(uint32 numStops)
+	{
+		for (Voice &voice : m_voices)
+			voice.active = false;
+		m_numScheduled = 0;
+		m_numStopsApplied = numStops;
+	}
+	void m_ProcessCommands()
+	{
+		Command command;
+		while (m_commands.Pop(command))
+		{
+			// Stopped after the previous command
+			if (command.numStops != m_numStopsApplied)
+				m_ApplyStop(command.numStops);
+
+			if (command.clock && m_numScheduled < maxScheduled)
+				m_scheduled[m_numScheduled++] = command;
+			else
+				m_RunCommand(command.type);
+		}
+
+		// Stopped after the last command
+		const uint32 numStops = m_numStops.load(std::memory_order_acquire);
+		if (numStops != m_numStopsApplied)
+			m_ApplyStop(numStops);
+	}
+	// Starts scheduled plays reached at offset in this block
+	//	returns the offset of the next one within numSamples, or numSamples if there is none
+	uint32 m_RunScheduled(uint32 offset, uint32 numSamples)
+	{
+		uint32 next = numSamples;
+		for (uint32 i = 0; i < m_numScheduled;)
+		{
+			const Command &command = m_scheduled[i];
+			// Only look at the clock while it's being mixed, that keeps it alive until the end of the block
+			if (!m_audio->GetImpl()->IsMixing(command.clock) || command.clock->GetClockGeneration() != command.clockGeneration)
+			{
+				// Removed or seeked, the position doesn't refer to the same audio anymore
+				m_scheduled[i] = m_scheduled[--m_numScheduled];
+				continue;
+			}
+			int64 commandOffset = command.clock->GetMixOffset(command.samplePos);
+			if (commandOffset <= (int64)offset)
+			{
+				CommandType type = command.type;
+				m_scheduled[i] = m_scheduled[--m_numScheduled];
+				m_RunCommand(type);
+				continue;
+			}
+			if (commandOffset < (int64)next)
+				next = (uint32)commandOffset;
+			i++;
+		}
+		return next;
 	}
 	virtual void Play(bool looping) override
 	{
-		m_lock.lock();
-		m_playing = true;
-		m_playbackPointer = 0;
-		m_looping = looping;
-		m_lock.unlock();
+		m_PushCommand(looping ? CommandType::PlayLooping : CommandType::Play);
+	}
+	virtual void PlayAt(AudioBase *clock, int64 samplePos, bool looping) override
+	{
+		m_PushCommand(looping ? CommandType::PlayLooping : CommandType::Play, clock, samplePos);
 	}
 	virtual void Stop() override
 	{
-		m_lock.lock();
-		m_playing = false;
-		m_looping = false;
-		m_lock.unlock();
+		m_numStops.fetch_add(1, std::memory_order_release);
+	}
+	virtual void SetMaxVoices(uint32 maxVoices) override
+	{
+		m_maxVoices = Math::Clamp(maxVoices, 1u, voiceLimit);
 	}
 	bool Init(const String &path)
 	{
 
-		ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 2, g_audio->GetSampleRate());
+		const bool compact = m_audio->GetImpl()->compactPcm;
+		// Decoded at the output rate so playing needs no resampling
+		ma_decoder_config config = ma_decoder_config_init(compact ? ma_format_s16 : ma_format_f32, 2, g_audio->GetSampleRate());
 		ma_result result;
-		result = ma_decode_file(*path, &config, &m_length, (void **)&m_pcm);
+		result = ma_decode_file(*path, &config, &m_length, compact ? (void **)&m_pcm16 : (void **)&m_pcm);
 
 		if (result != MA_SUCCESS)
 			return false;
 
 		return true;
 	}
-	virtual void Process(float *out, uint32 numSamples) override
+	// Adds frames of a single voice to out
+	void m_MixVoice(Voice &voice, float *out, uint32 numSamples)
 	{
-		if (!m_playing)
-			return;
-
-		m_lock.lock();
-
-		for (uint32 i = 0; i < numSamples; i++)
+		const MixKernels &kernels = MixKernels::Get();
+		uint32 i = 0;
+		while (i < numSamples)
 		{
-			if (m_playbackPointer >= m_length)
+			if (voice.position >= m_length)
 			{
-				if (m_looping)
-				{
-					m_playbackPointer = 0;
-				}
-				else
+				if (!voice.looping)
 				{
 					// Playback ended
-					m_playing = false;
+					voice.active = false;
 					break;
 				}
+				voice.position = 0;
 			}
 
-			out[i * 2] = m_pcm[m_playbackPointer * 2];
-			out[i * 2 + 1] = m_pcm[m_playbackPointer * 2 + 1];
-			m_playbackPointer++;
+			// Mix up to the end of the sample at once
+			uint32 numFrames = (uint32)Math::Min<uint64>(numSamples - i, m_length - voice.position);
+			if (m_pcm16)
+			{
+				float converted[256 * 2];
+				numFrames = Math::Min(numFrames, 256u);
+				kernels.Int16ToFloat(converted, m_pcm16 + voice.position * 2, numFrames * 2);
+				kernels.Accumulate(out + i * 2, converted, 1.0f, numFrames * 2);
+			}
+			else
+			{
+				kernels.Accumulate(out + i * 2, m_pcm + voice.position * 2, 1.0f, numFrames * 2);
+			}
+			voice.position += numFrames;
+			i += numFrames;
 		}
-		m_lock.unlock();
+	}
+	virtual void Process(float *out, uint32 numSamples) override
+	{
+		m_ProcessCommands();
+		if (m_length == 0)
+			return;
+
+		// Mix up to each scheduled play so it starts at its exact frame
+		uint32 offset = 0;
+		while (offset < numSamples)
+		{
+			uint32 end = m_RunScheduled(offset, numSamples);
+			// The mixer clears out before calling this, every voice is added on top
+			for (Voice &voice : m_voices)
+			{
+				if (voice.active)
+					m_MixVoice(voice, out + offset * 2, end - offset);
+			}
+			offset = end;
+		}
+
+		uint32 numActive = m_numScheduled;
+		for (const Voice &voice : m_voices)
+		{
+			if (voice.active)
+				numActive++;
+		}
+		m_numActive = numActive;
+	}
+	// Most recently started voice
+	const Voice *m_GetNewestVoice() const
+	{
+		const Voice *newest = nullptr;
+		for (const Voice &voice : m_voices)
+		{
+			if (voice.active && (!newest || voice.startIndex > newest->startIndex))
+				newest = &voice;
+		}
+		return newest;
 	}
 	const Buffer &GetData() const override
 	{
@@ -104,7 +288,7 @@ public:
 	}
 	int32 GetPosition() const override
 	{
-		return m_playbackPointer;
+		return (int32)GetSamplePos();
 	}
 	float *GetPCM() override
 	{
@@ -114,18 +298,28 @@ public:
 	{
 		return 0;
 	}
+	const char *GetName() const override
+	{
+		return "Sample";
+	}
+	uint64 GetPCMMemoryUsage() const override
+	{
+		return m_length * 2 * (m_pcm16 ? sizeof(int16) : sizeof(float));
+	}
 	uint32 GetSampleRate() const override
 	{
 		return g_audio->GetSampleRate();
 	}
 	bool IsPlaying() const override
 	{
-		return m_playing;
+		// Plays that weren't picked up by the audio thread yet count as well
+		return m_numActive > 0 || !m_commands.IsEmpty();
 	}
 	void PreRenderDSPs(Vector<DSP *> &DSPs) override {}
 	uint64 GetSamplePos() const override
 	{
-		return m_playbackPointer;
+		const Voice *voice = m_GetNewestVoice();
+		return voice ? voice->position : 0;
 	}
 };
 
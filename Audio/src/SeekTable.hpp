@@ -0,0 +1,51 @@
+#pragma once
+
+/*
+	Maps stream positions to places in compressed data where decoding can start
+	Points are stored at a fixed interval of samples so looking up a position is a single index
+*/
+class SeekTable
+{
+public:
+	struct Point
+	{
+		// First sample produced when decoding from offset
+		int64 sample;
+		// Byte offset in the compressed data
+		uint64 offset;
+	};
+
+	// Distance between points
+	static constexpr uint32 intervalMs = 100;
+
+	// Clears the table for a stream with the given sample rate
+	void Reset(uint32 sampleRate)
+	{
+		m_interval = Math::Max(1u, sampleRate * intervalMs / 1000);
+		m_points.clear();
+	}
+
+	// Adds the next block of samples, ending at end, that can be reached by decoding from point
+	//	blocks should be added in order without gaps, point.sample should not be past the start of the block
+	void AddBlock(int64 end, const Point &point)
+	{
+		while ((int64)m_points.size() * m_interval < end)
+			m_points.Add(point);
+	}
+
+	// Point to start decoding from to reach sample, nullptr if the table is empty
+	const Point *Find(int64 sample) const
+	{
+		if (m_points.empty())
+			return nullptr;
+		int64 index = Math::Clamp<int64>(sample / m_interval, 0, (int64)m_points.size() - 1);
+		return &m_points[(size_t)index];
+	}
+
+	bool IsEmpty() const { return m_points.empty(); }
+	size_t GetSize() const { return m_points.size(); }
+
+private:
+	uint32 m_interval = 1;
+	Vector<Point> m_points;
+};
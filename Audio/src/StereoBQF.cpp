@@ -0,0 +1,165 @@
+#include "stdafx.h"
+#include "StereoBQF.hpp"
+#include "DSP.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <emmintrin.h>
+#define STEREOBQF_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define STEREOBQF_NEON
+#endif
+
+// A single stereo frame, left in the first lane and right in the second one
+#if defined(STEREOBQF_SSE)
+typedef __m128 Frame;
+static inline Frame Load(const float *p) { return _mm_castpd_ps(_mm_load_sd((const double *)p)); }
+static inline void Store(float *p, Frame v) { _mm_store_sd((double *)p, _mm_castps_pd(v)); }
+static inline Frame Broadcast(float v) { return _mm_set1_ps(v); }
+static inline Frame Add(Frame a, Frame b) { return _mm_add_ps(a, b); }
+static inline Frame Sub(Frame a, Frame b) { return _mm_sub_ps(a, b); }
+static inline Frame Mul(Frame a, Frame b) { return _mm_mul_ps(a, b); }
+#elif defined(STEREOBQF_NEON)
+typedef float32x2_t Frame;
+static inline Frame Load(const float *p) { return vld1_f32(p); }
+static inline void Store(float *p, Frame v) { vst1_f32(p, v); }
+static inline Frame Broadcast(float v) { return vdup_n_f32(v); }
+static inline Frame Add(Frame a, Frame b) { return vadd_f32(a, b); }
+static inline Frame Sub(Frame a, Frame b) { return vsub_f32(a, b); }
+static inline Frame Mul(Frame a, Frame b) { return vmul_f32(a, b); }
+#else
+struct Frame
+{
+	float v[2];
+};
+static inline Frame Load(const float *p) { return {{p[0], p[1]}}; }
+static inline void Store(float *p, Frame f)
+{
+	p[0] = f.v[0];
+	p[1] = f.v[1];
+}
+static inline Frame Broadcast(float v) { return {{v, v}}; }
+static inline Frame Add(Frame a, Frame b) { return {{a.v[0] + b.v[0], a.v[1] + b.v[1]}}; }
+static inline Frame Sub(Frame a, Frame b) { return {{a.v[0] - b.v[0], a.v[1] - b.v[1]}}; }
+static inline Frame Mul(Frame a, Frame b) { return {{a.v[0] * b.v[0], a.v[1] * b.v[1]}}; }
+#endif
+
+void StereoBQF::SetNumStages(uint32 numStages)
+{
+	numStages = Math::Min(numStages, maxStages);
+	// New stages start without history
+	for (uint32 i = m_numStages; i < numStages; i++)
+	{
+		m_z1[i][0] = m_z1[i][1] = 0.0f;
+		m_z2[i][0] = m_z2[i][1] = 0.0f;
+	}
+	m_numStages = numStages;
+}
+void StereoBQF::SetCoefficients(const BQF &left, const BQF &right, bool interpolate)
+{
+	const BQF *designs[2] = {&left, &right};
+	for (uint32 c = 0; c < 2; c++)
+	{
+		const BQF &design = *designs[c];
+		m_target.b0[c] = design.b0 / design.a0;
+		m_target.b1[c] = design.b1 / design.a0;
+		m_target.b2[c] = design.b2 / design.a0;
+		m_target.a1[c] = design.a1 / design.a0;
+		m_target.a2[c] = design.a2 / design.a0;
+	}
+
+	// The first coefficients have nothing to interpolate from
+	m_interpolate = interpolate && m_initialized;
+	if (!m_interpolate)
+		m_current = m_target;
+	m_initialized = true;
+}
+void StereoBQF::SetCoefficients(const BQF &both, bool interpolate)
+{
+	SetCoefficients(both, both, interpolate);
+}
+String StereoBQF::GetKey() const
+{
+	String key = Utility::Sprintf("%u", m_numStages);
+	for (uint32 c = 0; c < 2; c++)
+	{
+		key += Utility::Sprintf(",%.9g,%.9g,%.9g,%.9g,%.9g", m_target.b0[c], m_target.b1[c], m_target.b2[c], m_target.a1[c], m_target.a2[c]);
+	}
+	return key;
+}
+void StereoBQF::Process(float *out, uint32 numFrames, float feedback)
+{
+	if (numFrames == 0)
+		return;
+
+	Frame b0 = Load(m_current.b0);
+	Frame b1 = Load(m_current.b1);
+	Frame b2 = Load(m_current.b2);
+	Frame a1 = Load(m_current.a1);
+	Frame a2 = Load(m_current.a2);
+
+	// Per frame steps towards the target coefficients
+	Frame db0 = Broadcast(0.0f), db1 = Broadcast(0.0f), db2 = Broadcast(0.0f), da1 = Broadcast(0.0f), da2 = Broadcast(0.0f);
+	if (m_interpolate)
+	{
+		Frame step = Broadcast(1.0f / (float)numFrames);
+		db0 = Mul(Sub(Load(m_target.b0), b0), step);
+		db1 = Mul(Sub(Load(m_target.b1), b1), step);
+		db2 = Mul(Sub(Load(m_target.b2), b2), step);
+		da1 = Mul(Sub(Load(m_target.a1), a1), step);
+		da2 = Mul(Sub(Load(m_target.a2), a2), step);
+	}
+
+	Frame z1[maxStages];
+	Frame z2[maxStages];
+	for (uint32 s = 0; s < m_numStages; s++)
+	{
+		z1[s] = Load(m_z1[s]);
+		z2[s] = Load(m_z2[s]);
+	}
+	const Frame fb = Broadcast(feedback);
+	Frame y = Load(m_lastOutput);
+
+	for (uint32 i = 0; i < numFrames; i++)
+	{
+		if (m_interpolate)
+		{
+			b0 = Add(b0, db0);
+			b1 = Add(b1, db1);
+			b2 = Add(b2, db2);
+			a1 = Add(a1, da1);
+			a2 = Add(a2, da2);
+		}
+
+		Frame x = Add(Load(out + i * 2), Mul(fb, y));
+		for (uint32 s = 0; s < m_numStages; s++)
+		{
+			y = Add(Mul(b0, x), z1[s]);
+			z1[s] = Add(Sub(Mul(b1, x), Mul(a1, y)), z2[s]);
+			z2[s] = Sub(Mul(b2, x), Mul(a2, y));
+			x = y;
+		}
+		y = x;
+		Store(out + i * 2, y);
+	}
+
+	for (uint32 s = 0; s < m_numStages; s++)
+	{
+		Store(m_z1[s], z1[s]);
+		Store(m_z2[s], z2[s]);
+	}
+	Store(m_lastOutput, y);
+
+	// Land exactly on the target instead of accumulating rounding errors
+	if (m_interpolate)
+	{
+		m_current = m_target;
+		m_interpolate = false;
+	}
+}
+void StereoBQF::Reset()
+{
+	memset(m_z1, 0, sizeof(m_z1));
+	memset(m_z2, 0, sizeof(m_z2));
+	m_lastOutput[0] = m_lastOutput[1] = 0.0f;
+}
@@ -132,6 +132,11 @@ double AudioOutput::GetBufferLength() const
 {
 	return 0;
 }
+double AudioOutput::GetLatency() const
+{
+	// SDL doesn't report the device latency, the callback buffer is queued before it is played
+	return (double)m_impl->m_audioSpec.samples / (double)m_impl->m_audioSpec.freq;
+}
 void AudioOutput::Start(IMixer* mixer)
 {
 	m_impl->m_mixer = mixer;
@@ -66,6 +66,9 @@ public:
 	NotificationClient m_notificationClient;
 
 	double m_bufferLength;
+	// Latency of the audio stream and of the frames still queued in the buffer at the last Begin, in seconds
+	double m_streamLatency = 0.0;
+	double m_latency = 0.0;
 
 	// Dummy audio output
 	static const uint32 m_dummyChannelCount = 2;
@@ -296,6 +299,10 @@ public:
 
 		m_bufferLength = (double)m_numBufferFrames / (double)m_format.nSamplesPerSec;
 
+		REFERENCE_TIME streamLatency = 0;
+		m_audioClient->GetStreamLatency(&streamLatency);
+		m_streamLatency = (double)streamLatency * 1e-7;
+
 		res = m_audioClient->Start();
 		return true;
 	}
@@ -342,6 +349,7 @@ public:
 		uint32_t numFramesPadding;
 		m_audioClient->GetCurrentPadding(&numFramesPadding);
 		numSamples = m_numBufferFrames - numFramesPadding;
+		m_latency = m_streamLatency + (double)numFramesPadding / (double)m_format.nSamplesPerSec;
 
 		if(numSamples > 0)
 		{
@@ -454,6 +462,10 @@ double AudioOutput::GetBufferLength() const
 {
 	return m_impl->m_bufferLength;
 }
+double AudioOutput::GetLatency() const
+{
+	return m_impl->m_latency;
+}
 bool AudioOutput::IsIntegerFormat() const
 {
 	///TODO: check more cases?
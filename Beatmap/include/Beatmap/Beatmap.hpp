@@ -70,6 +70,8 @@ public:
 
 public:
 	bool Load(BinaryStream& input, bool metadataOnly = false);
+	// Same as Load with metadataOnly set for a chart in memory, only the header of the chart is read
+	bool LoadMetadata(const char* data, size_t size);
 
 	/// Returns the settings of the map, contains metadata + song/image paths.
 	const BeatmapSettings& GetMapSettings() const;
@@ -156,7 +158,7 @@ public:
 	float GetScrollSpeedAt(MapTime mapTime) const;
 
 private:
-	bool m_ProcessKShootMap(BinaryStream& input, bool metadataOnly);
+	bool m_ProcessKShootMap(class KShootMap& kshootMap, bool metadataOnly);
 
 	Map<EffectType, AudioEffect> m_customAudioEffects;
 	Map<EffectType, AudioEffect> m_customAudioFilters;
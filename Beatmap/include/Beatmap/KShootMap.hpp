@@ -1,4 +1,5 @@
 #pragma once
+#include <Shared/StringEncoding.hpp>
 
 using Utility::Sprintf;
 
@@ -75,6 +76,8 @@ public:
 	KShootMap();
 	~KShootMap();
 	bool Init(BinaryStream& input, bool metadataOnly);
+	// Only reads the settings in the header of a chart in memory, stops at the first measure
+	bool InitHeader(const char* data, size_t size);
 	bool GetBlock(const KShootTime& time, KShootBlock*& tickOut);
 	bool GetTick(const KShootTime& time, KShootTick*& tickOut);
 	float TimeToFloat(const KShootTime& time) const;
@@ -86,6 +89,9 @@ public:
 	Map<String, KShootEffectDefinition> fxDefines;
 
 private:
+	// Converts the settings from the encoding that was detected for the chart to UTF-8
+	void m_ConvertSettings(StringEncoding chartEncoding);
+
 	static const char* c_sep;
 
 };
@@ -240,8 +240,12 @@ public:
 	
 	void RemoveSearchPath(const String& path);
 	void UpdateChartOffset(const ChartIndex* chart);
+	// Writes the offsets of many charts in a single transaction
+	void UpdateChartOffsets(const Vector<ChartIndex*>& charts);
 
 	void SetChartUpdateBehavior(bool transferScores);
+	// Threads that read charts during a search, 0 picks a number from the hardware
+	void SetChartReadThreads(uint32 numThreads);
 
 	Delegate<String> OnSearchStatusUpdated;
 	// (mapId, mapIndex)
@@ -266,4 +270,5 @@ public:
 private:
 	class MapDatabase_Impl* m_impl;
 	bool m_transferScores = false;
+	uint32 m_chartReadThreads = 0;
 };
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "Beatmap.hpp"
+#include "KShootMap.hpp"
 #include "Shared/Profiling.hpp"
 
 #include <array>
@@ -11,7 +12,19 @@ bool Beatmap::Load(BinaryStream& input, bool metadataOnly)
 {
 	ProfilerScope $("Load Beatmap");
 
-	return m_ProcessKShootMap(input, metadataOnly);
+	KShootMap kshootMap;
+	if (!kshootMap.Init(input, metadataOnly))
+		return false;
+	return m_ProcessKShootMap(kshootMap, metadataOnly);
+}
+bool Beatmap::LoadMetadata(const char* data, size_t size)
+{
+	ProfilerScope $("Load Beatmap Metadata");
+
+	KShootMap kshootMap;
+	if (!kshootMap.InitHeader(data, size))
+		return false;
+	return m_ProcessKShootMap(kshootMap, true);
 }
 
 const BeatmapSettings& Beatmap::GetMapSettings() const
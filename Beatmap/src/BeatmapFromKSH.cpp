@@ -396,12 +396,8 @@ AudioEffect ParseCustomEffect(const KShootEffectDefinition &def, Vector<String>
 	return effect;
 };
 
-bool Beatmap::m_ProcessKShootMap(BinaryStream &input, bool metadataOnly)
+bool Beatmap::m_ProcessKShootMap(KShootMap &kshootMap, bool metadataOnly)
 {
-	KShootMap kshootMap;
-	if (!kshootMap.Init(input, metadataOnly))
-		return false;
-
 	EffectTypeMap effectTypeMap;
 	EffectTypeMap filterTypeMap;
 	Map<EffectType, int16> defaultEffectParams;
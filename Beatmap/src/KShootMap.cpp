@@ -158,6 +158,78 @@ KShootMap::KShootMap()
 KShootMap::~KShootMap()
 {
 
+}
+void KShootMap::m_ConvertSettings(StringEncoding chartEncoding)
+{
+	if (chartEncoding != StringEncoding::Unknown)
+		Logf("Chart encoding is assumed to be %s", Logger::Severity::Info, GetDisplayString(chartEncoding));
+	else
+		Log("Chart encoding couldn't be assumed. (Assuming UTF-8)", Logger::Severity::Warning);
+
+	if (chartEncoding != StringEncoding::Unknown)
+	{
+		for (auto& it : settings)
+		{
+			const String& value = it.second;
+			if (value.empty()) continue;
+
+			it.second = StringEncodingConverter::ToUTF8(chartEncoding, value);
+		}
+	}
+}
+bool KShootMap::InitHeader(const char* data, size_t size)
+{
+	ProfilerScope $("Load KShootMap Header");
+
+	const char* const end = data + size;
+	const char* pos = data;
+
+	// Same Byte Order Mark handling as Init
+	bool hasBom = size >= 3 && memcmp(data, "\xef\xbb\xbf", 3) == 0;
+	if (hasBom)
+		pos += 3;
+
+	// Lines are split on \r\n and trimmed like TextStream::ReadLine and String::Trim do in Init
+	//	only keys and values are copied out of the data
+	while (pos < end)
+	{
+		const char* lineStart = pos;
+		const char* lineEnd = end;
+		for (const char* c = lineStart; c + 1 < end; c++)
+		{
+			if (c[0] == '\r' && c[1] == '\n')
+			{
+				lineEnd = c;
+				break;
+			}
+		}
+		pos = lineEnd == end ? end : lineEnd + 2;
+
+		while (lineStart < lineEnd && *lineStart == ' ')
+			lineStart++;
+		while (lineEnd > lineStart && lineEnd[-1] == ' ')
+			lineEnd--;
+		const size_t length = lineEnd - lineStart;
+
+		// First measure
+		if (length == 2 && lineStart[0] == '-' && lineStart[1] == '-')
+			break;
+		if (length == 0)
+			continue;
+		if (length >= 2 && lineStart[0] == '/' && lineStart[1] == '/')
+			continue;
+
+		const char* split = (const char*)memchr(lineStart, '=', length);
+		if (!split)
+			return false;
+		settings.FindOrAdd(String(lineStart, split)) = String(split + 1, lineEnd);
+	}
+
+	// The header ends after the separator line, or at the end of the data if there is none
+	if (!hasBom)
+		m_ConvertSettings(pos > data ? StringEncodingDetector::Detect(data, pos - data) : StringEncoding::Unknown);
+
+	return true;
 }
 bool KShootMap::Init(BinaryStream& input, bool metadataOnly)
 {
@@ -206,25 +278,7 @@ bool KShootMap::Init(BinaryStream& input, bool metadataOnly)
 	}
 
 	if (chartEncoding == StringEncoding::Unknown)
-	{
-		chartEncoding = StringEncodingDetector::Detect(input, 0, input.Tell());
-
-		if (chartEncoding != StringEncoding::Unknown)
-			Logf("Chart encoding is assumed to be %s", Logger::Severity::Info, GetDisplayString(chartEncoding));
-		else
-			Log("Chart encoding couldn't be assumed. (Assuming UTF-8)", Logger::Severity::Warning);
-
-		if (chartEncoding != StringEncoding::Unknown)
-		{
-			for (auto& it : settings)
-			{
-				const String& value = it.second;
-				if (value.empty()) continue;
-
-				it.second = StringEncodingConverter::ToUTF8(chartEncoding, value);
-			}
-		}
-	}
+		m_ConvertSettings(StringEncodingDetector::Detect(input, 0, input.Tell()));
 
 	if(metadataOnly)
 		return true;
@@ -5,6 +5,8 @@
 #include "TinySHA1.hpp"
 #include "Shared/Profiling.hpp"
 #include "Shared/Files.hpp"
+#include "Shared/FileWatcher.hpp"
+#include "Shared/Sha1.hpp"
 #include "Shared/Time.hpp"
 #include "KShootMap.hpp"
 #include <thread>
@@ -86,11 +88,88 @@ public:
 		BeatmapSettings* mapData = nullptr;
 		nlohmann::json json;
 		String hash;
+		// Set by the file watcher, which doesn't know if the file is in the database
+		//	the id and action are looked up when the change is applied
+		bool resolvePath = false;
 	};
 	List<Event> m_pendingChanges;
 	mutex m_pendingChangesLock;
 
+	/*
+		Charts read by the read threads of a search
+	*/
+	struct ChartIngestion
+	{
+		struct Entry
+		{
+			String path;
+			// Filled by the thread that read the chart
+			Event evt;
+			bool valid = false;
+			bool done = false;
+		};
+
+		ChartIngestion(uint32 window) : window(window)
+		{
+		}
+		~ChartIngestion()
+		{
+			// Charts that were read but never handed to the database
+			for (size_t i = nextToAdd; i < entries.size(); i++)
+			{
+				if (entries[i].evt.mapData)
+					delete entries[i].evt.mapData;
+			}
+		}
+
+		// Takes the next chart to read, waits while too many charts are read ahead of the search thread or the search is paused
+		//	returns false when all charts are taken or the search stopped
+		bool Take(size_t& index)
+		{
+			unique_lock<mutex> guard(lock);
+			condition.wait(guard, [this] { return cancelled || nextToRead >= entries.size() || (!paused && nextToRead < nextToAdd + window); });
+			if (cancelled || nextToRead >= entries.size())
+				return false;
+			index = nextToRead++;
+			return true;
+		}
+		void Finish(size_t index)
+		{
+			lock_guard<mutex> guard(lock);
+			entries[index].done = true;
+			condition.notify_all();
+		}
+		void Cancel()
+		{
+			lock_guard<mutex> guard(lock);
+			cancelled = true;
+			condition.notify_all();
+		}
+		void SetPaused(bool pause)
+		{
+			lock_guard<mutex> guard(lock);
+			paused = pause;
+			condition.notify_all();
+		}
+
+		// Only resized before the read threads start
+		Vector<Entry> entries;
+		mutex lock;
+		condition_variable condition;
+		// Next chart a thread will read and the next chart the search thread adds to the database
+		size_t nextToRead = 0;
+		size_t nextToAdd = 0;
+		// Maximum number of charts read ahead
+		uint32 window;
+		bool cancelled = false;
+		bool paused = false;
+	};
+
 	static const int32 m_version = 20;
+	// Maximum number of charts the read threads read ahead of the search thread
+	static const uint32 chartReadWindow = 64;
+	// Threads that read charts besides the search thread, 0 uses half of the hardware threads
+	std::atomic<uint32> m_chartReadThreads{0};
 
 public:
 	MapDatabase_Impl(MapDatabase& outer, bool transferScores) : m_outer(outer)
@@ -465,6 +544,9 @@ public:
 		if(m_searching)
 			return;
 
+		// Stop watching files, a search finds all changes
+		m_interruptSearch = true;
+		ResumeSearching();
 		if(m_thread.joinable())
 			m_thread.join();
 		// Apply previous diff to prevent duplicated entry 
@@ -478,9 +560,10 @@ public:
 	}
 	void StopSearching()
 	{
-		ResumeSearching();
+		// Stop before resuming so a paused search doesn't add more charts
 		m_interruptSearch = true;
 		m_searching = false;
+		ResumeSearching();
 		if(m_thread.joinable())
 		{
 			m_thread.join();
@@ -874,6 +957,13 @@ public:
 		m_database.Exec("BEGIN");
 		for(Event& e : changes)
 		{
+			if (e.resolvePath && !m_ResolveWatchedChange(e))
+			{
+				if (e.mapData)
+					delete e.mapData;
+				continue;
+			}
+
 			if (e.type == Event::Challenge && (e.action == Event::Added || e.action == Event::Updated))
 			{
 				ChallengeIndex* chal;
@@ -1427,6 +1517,23 @@ public:
 		m_database.Exec(Utility::Sprintf("UPDATE Charts SET custom_offset=%d WHERE hash LIKE '%s'", chart->custom_offset, *chart->hash));
 	}
 
+	void UpdateChartOffsets(const Vector<ChartIndex*>& charts)
+	{
+		if (charts.empty())
+			return;
+
+		DBStatement update = m_database.Query("UPDATE Charts SET custom_offset=? WHERE hash LIKE ?");
+		m_database.Exec("BEGIN");
+		for (const ChartIndex* chart : charts)
+		{
+			update.BindInt(1, chart->custom_offset);
+			update.BindString(2, chart->hash);
+			update.Step();
+			update.Rewind();
+		}
+		m_database.Exec("END");
+	}
+
 	void AddOrRemoveToCollection(const String& name, int32 mapid)
 	{
 		DBStatement addColl = m_database.Query("INSERT INTO Collections(folderid,collection) VALUES(?,?)");
@@ -1486,13 +1593,20 @@ public:
 		if (!m_paused.load())
 			return;
 
-		m_paused.store(false);
+		{
+			// Stored under the lock so a search that is about to wait can't miss the notification
+			lock_guard<mutex> lock(m_pauseMutex);
+			m_paused.store(false);
+		}
 		m_cvPause.notify_all();
 	}
 
 	void SetChartUpdateBehavior(bool transferScores) {
 		m_transferScores = transferScores;
 	}
+	void SetChartReadThreads(uint32 numThreads) {
+		m_chartReadThreads = numThreads;
+	}
 
 private:
 	void m_CleanupMapIndex()
@@ -1880,6 +1994,171 @@ private:
 	}
 
 	// Main search thread
+	// Reads the metadata and hash of the chart at path into evt, returns false if it isn't a valid chart
+	static bool m_ReadChart(const String& path, Event& evt)
+	{
+		// The file is read once, the metadata is parsed from and the hash computed over the same buffer
+		File fileStream;
+		if(!fileStream.OpenRead(path))
+			return false;
+		Buffer data;
+		data.resize(fileStream.GetSize());
+		if(fileStream.Read(data.data(), data.size()) != data.size())
+			return false;
+		fileStream.Close();
+
+		// Only the header is parsed, the body of the chart isn't needed here
+		Beatmap map;
+		if(!map.LoadMetadata((const char*)data.data(), data.size()))
+			return false;
+
+		evt.mapData = new BeatmapSettings(map.GetMapSettings());
+
+		ProfilerScope $("Chart Database - Hash Chart");
+		evt.hash = Sha1::HashHex(data.data(), data.size());
+		return true;
+	}
+	// Reads the settings and hash of the challenge at path into evt, returns false if it isn't a valid challenge
+	static bool m_ReadChallenge(const String& path, Event& evt)
+	{
+		// TODO support old style courses
+		File chalFile;
+		if (!chalFile.OpenRead(path))
+			return false;
+
+		Buffer jsonBuf;
+		jsonBuf.resize(chalFile.GetSize());
+		chalFile.Read(jsonBuf.data(), jsonBuf.size());
+		nlohmann::json settings = ChallengeIndex::LoadJson(jsonBuf, path);
+		if (!ChallengeIndex::BasicValidate(settings, path))
+			return false;
+
+		evt.hash = Sha1::HashHex(jsonBuf.data(), jsonBuf.size());
+		evt.json = settings;
+		return true;
+	}
+
+	// Looks up a change reported by the file watcher in the database
+	//	returns false if there is nothing to change
+	bool m_ResolveWatchedChange(Event& e)
+	{
+		int32 id = -1;
+		uint64 lwt = 0;
+		if (e.type == Event::Chart)
+		{
+			FolderIndex** folder = m_foldersByPath.Find(Path::RemoveLast(e.path, nullptr));
+			if (folder)
+			{
+				for (ChartIndex* chart : (*folder)->charts)
+				{
+					if (chart->path == e.path)
+					{
+						id = chart->id;
+						lwt = chart->lwt;
+						break;
+					}
+				}
+			}
+		}
+		else
+		{
+			for (auto& chal : m_challenges)
+			{
+				if (chal.second->path == e.path)
+				{
+					id = chal.first;
+					lwt = chal.second->lwt;
+					break;
+				}
+			}
+		}
+
+		if (id < 0)
+		{
+			// Unknown files can only be added
+			if (e.action != Event::Added)
+				return false;
+			return true;
+		}
+
+		e.id = id;
+		if (e.action == Event::Added)
+		{
+			if (lwt == e.lwt)
+				return false;
+			e.action = Event::Updated;
+		}
+		return true;
+	}
+	// Creates the change for a chart or challenge the file watcher reported
+	void m_ProcessWatchedFile(const String& path)
+	{
+		Event evt;
+		evt.type = Path::GetExtension(path) == "chal" ? Event::Challenge : Event::Chart;
+		evt.path = path;
+		evt.resolvePath = true;
+		evt.lwt = File::GetLastWriteTime(path);
+		evt.action = Event::Added;
+
+		if (evt.lwt == 0)
+		{
+			evt.action = Event::Removed;
+		}
+		else
+		{
+			Logf("Detected change to [%s]", Logger::Severity::Info, path);
+			m_outer.OnSearchStatusUpdated.Call(Utility::Sprintf("Detected change to [%s]", path));
+			bool valid = evt.type == Event::Chart ? m_ReadChart(path, evt) : m_ReadChallenge(path, evt);
+			// Invalid files get removed from the database
+			if (!valid)
+				evt.action = Event::Removed;
+		}
+		AddChange(evt);
+	}
+	bool m_HasPendingChanges()
+	{
+		lock_guard<mutex> guard(m_pendingChangesLock);
+		return !m_pendingChanges.empty();
+	}
+	// Keeps the search paths under watch after the initial search so changed files are picked up without a rescan
+	//	legacy courses are only converted by a full search
+	void m_WatchFiles()
+	{
+		FileWatcher watcher({ "ksh", "chal" });
+		for (const String& rootSearchPath : m_searchPaths)
+			watcher.AddFolder(rootSearchPath);
+		if (watcher.IsPolling())
+			Logf("Watching chart folders by scanning them every %ds", Logger::Severity::Info, watcher.pollInterval / 1000);
+
+		Set<String> changes;
+		while (!m_interruptSearch)
+		{
+			if (m_paused.load())
+			{
+				// Don't rely on the notification, the game might resume before this waits
+				unique_lock<mutex> lock(m_pauseMutex);
+				m_cvPause.wait_for(lock, chrono::milliseconds(500));
+				continue;
+			}
+
+			Set<String> newChanges = watcher.Wait(500);
+			changes.insert(newChanges.begin(), newChanges.end());
+
+			// Wait until files stop changing and the previous changes are applied, so they are looked up in an up to date database
+			if (changes.empty() || !newChanges.empty() || m_HasPendingChanges())
+				continue;
+
+			for (const String& path : changes)
+			{
+				if (m_interruptSearch)
+					return;
+				m_ProcessWatchedFile(path);
+			}
+			changes.clear();
+			m_outer.OnSearchStatusUpdated.Call("");
+		}
+	}
+
 	void m_SearchThread()
 	{
 		Map<String, FileInfo> fileList;
@@ -1936,21 +2215,14 @@ private:
 			ProfilerScope $("Chart Database - Process New Charts");
 			m_outer.OnSearchStatusUpdated.Call("[START] Chart Database - Process New Charts");
 			// Process scanned files
+			ChartIngestion ingestion(chartReadWindow);
 			for(auto f : fileList)
 			{
-				if (m_paused.load())
-				{
-					unique_lock<mutex> lock(m_pauseMutex);
-					m_cvPause.wait(lock);
-				}
-
-				if(!m_searching)
-					break;
-
 				uint64 mylwt = f.second.lastWriteTime;
 				Event evt;
 				evt.type = Event::Chart;
 				evt.lwt = mylwt;
+				evt.path = f.first;
 
 				SearchState::ExistingFileEntry* existing = m_searchState.difficulties.Find(f.first);
 				if(existing)
@@ -1972,67 +2244,102 @@ private:
 					// Map added
 					evt.action = Event::Added;
 				}
+				ingestion.entries.emplace_back();
+				ingestion.entries.back().path = f.first;
+				ingestion.entries.back().evt = evt;
+			}
 
-				Logf("Discovered Chart [%s]", Logger::Severity::Info, f.first);
-				m_outer.OnSearchStatusUpdated.Call(Utility::Sprintf("Discovered Chart [%s]", f.first));
-				// Try to read map metadata
-				bool mapValid = false;
-				File fileStream;
-				Beatmap map;
-				if(fileStream.OpenRead(f.first))
-				{
-					FileReader reader(fileStream);
-
-					if(map.Load(reader, true))
+			// Charts are read on a few threads of this search, this thread adds them to the database in the order they were found
+			//	the job sheduler isn't used so loading a game, jackets and previews never wait behind a search
+			uint32 numThreads = m_chartReadThreads.load();
+			if (numThreads == 0)
+				numThreads = Math::Max(1u, std::thread::hardware_concurrency() / 2);
+			// More threads than charts read ahead would only wait
+			numThreads = Math::Min<uint32>((uint32)ingestion.entries.size(), Math::Min(numThreads, chartReadWindow));
+			Vector<thread> readThreads;
+			for(uint32 i = 0; i < numThreads; i++)
+			{
+				readThreads.emplace_back([&ingestion]() {
+					size_t index;
+					while(ingestion.Take(index))
 					{
-						mapValid = true;
+						ChartIngestion::Entry& entry = ingestion.entries[index];
+						entry.valid = m_ReadChart(entry.path, entry.evt);
+						ingestion.Finish(index);
 					}
-				}
+				});
+			}
 
-				if(mapValid)
+			for(size_t i = 0; i < ingestion.entries.size(); i++)
+			{
+				if (m_paused.load())
 				{
-					fileStream.Seek(0);
-					evt.mapData = new BeatmapSettings(map.GetMapSettings());
+					// The read threads stop with the search so they don't take cpu time from the game
+					ingestion.SetPaused(true);
+					unique_lock<mutex> lock(m_pauseMutex);
+					m_cvPause.wait(lock, [this] { return !m_paused.load(); });
+					lock.unlock();
+					ingestion.SetPaused(false);
+				}
 
-					ProfilerScope $("Chart Database - Hash Chart");
-					char data_buffer[0x80];
-					uint32_t digest[5];
-					sha1::SHA1 s;
+				if(!m_searching)
+					break;
 
-					size_t amount_read = 0;
-					size_t read_size;
-					do
+				ChartIngestion::Entry& entry = ingestion.entries[i];
+				bool readHere = false;
+				{
+					unique_lock<mutex> guard(ingestion.lock);
+					// Read it here if no read thread took it yet, so the search doesn't wait on busy threads
+					if (ingestion.nextToRead == i)
 					{
-						read_size = fileStream.Read(data_buffer, sizeof(data_buffer));
-						amount_read += read_size;
-						s.processBytes(data_buffer, read_size);
+						ingestion.nextToRead++;
+						readHere = true;
+					}
+					else
+					{
+						ingestion.condition.wait(guard, [&entry] { return entry.done; });
 					}
-					while (read_size != 0);
-						
-					s.getDigest(digest);
-
-					evt.hash = Utility::Sprintf("%08x%08x%08x%08x%08x", digest[0], digest[1], digest[2], digest[3], digest[4]);
 				}
-
-				if (!mapValid)
+				if (readHere)
+					entry.valid = m_ReadChart(entry.path, entry.evt);
+
+				Event& evt = entry.evt;
+				Logf("Discovered Chart [%s]", Logger::Severity::Info, evt.path);
+				m_outer.OnSearchStatusUpdated.Call(Utility::Sprintf("Discovered Chart [%s]", evt.path));
+				bool handOver = true;
+				if (!entry.valid)
 				{
-					if(!existing) // Never added
+					if(evt.action == Event::Added) // Never added
 					{
-						Logf("Skipping corrupted chart [%s]", Logger::Severity::Warning, f.first);
-						m_outer.OnSearchStatusUpdated.Call(Utility::Sprintf("Skipping corrupted chart [%s]", f.first));
+						Logf("Skipping corrupted chart [%s]", Logger::Severity::Warning, evt.path);
+						m_outer.OnSearchStatusUpdated.Call(Utility::Sprintf("Skipping corrupted chart [%s]", evt.path));
 						if(evt.mapData)
 							delete evt.mapData;
 						evt.mapData = nullptr;
-						continue;
+						handOver = false;
+					}
+					else
+					{
+						// XXX does remove actually use / free mapData
+						// Invalid maps get removed from the database
+						evt.action = Event::Removed;
 					}
-					// XXX does remove actually use / free mapData
-					// Invalid maps get removed from the database
-					evt.action = Event::Removed;
 				}
-				evt.path = f.first;
-				AddChange(evt);
-				continue;
+				if (handOver)
+				{
+					AddChange(evt);
+					// Owned by the change now
+					evt.mapData = nullptr;
+				}
+
+				lock_guard<mutex> guard(ingestion.lock);
+				ingestion.nextToAdd = i + 1;
+				ingestion.condition.notify_all();
 			}
+			// Threads that are still waiting give up, charts they read but weren't added are freed with the ingestion
+			ingestion.Cancel();
+			for(thread& readThread : readThreads)
+				readThread.join();
 			m_outer.OnSearchStatusUpdated.Call("[END] Chart Database - Process New Charts");
 		}
 		m_outer.OnSearchStatusUpdated.Call("");
@@ -2186,42 +2493,9 @@ private:
 					Logf("Discovered Challenge [%s]", Logger::Severity::Info, f.first);
 				m_outer.OnSearchStatusUpdated.Call(Utility::Sprintf("Discovered Challenge [%s]", f.first));
 
-				bool chalValid = true;
-				// TODO support old style courses
-				nlohmann::json settings;
-
-				File chalFile;
-				if (!chalFile.OpenRead(f.first))
-					chalValid = false;
-
-				if (chalValid)
-				{
-					// TODO support old style courses
-					Buffer jsonBuf;
-					jsonBuf.resize(chalFile.GetSize());
-					chalFile.Read(jsonBuf.data(), jsonBuf.size());
-					settings = ChallengeIndex::LoadJson(jsonBuf, f.first);
-					chalValid = ChallengeIndex::BasicValidate(settings, f.first);
-
-					if (chalValid)
-					{
-						sha1::SHA1 s;
-
-						s.processBytes(jsonBuf.data(), jsonBuf.size());
-
-						uint32_t digest[5];
-						s.getDigest(digest);
-
-						evt.hash = Utility::Sprintf("%08x%08x%08x%08x%08x", digest[0], digest[1], digest[2], digest[3], digest[4]);
-
-					}
-				}
-
+				bool chalValid = m_ReadChallenge(f.first, evt);
 				if (!chalValid)
 				{
-					// Reset json entry
-					evt.json = nlohmann::json();
-
 					if(!existing) // Never added
 					{
 						Logf("Skipping corrupted challenge [%s]", Logger::Severity::Warning, f.first);
@@ -2231,10 +2505,6 @@ private:
 					// Invalid chals get removed from the database
 					evt.action = Event::Removed;
 				}
-				else
-				{
-					evt.json = settings;
-				}
 				evt.path = f.first;
 				AddChange(evt);
 				continue;
@@ -2244,6 +2514,7 @@ private:
 		m_outer.OnSearchStatusUpdated.Call("");
 
 		m_searching = false;
+		m_WatchFiles();
 	}
 
 };
@@ -2252,6 +2523,7 @@ void MapDatabase::FinishInit()
 {
 	assert(!m_impl);
 	m_impl = new MapDatabase_Impl(*this, m_transferScores);
+	m_impl->SetChartReadThreads(m_chartReadThreads);
 }
 MapDatabase::MapDatabase(bool postponeInit)
 {
@@ -2358,6 +2630,10 @@ void MapDatabase::UpdateChartOffset(const ChartIndex* chart)
 {
 	m_impl->UpdateChartOffset(chart);
 }
+void MapDatabase::UpdateChartOffsets(const Vector<ChartIndex*>& charts)
+{
+	m_impl->UpdateChartOffsets(charts);
+}
 void MapDatabase::AddScore(ScoreIndex* score)
 {
 	m_impl->AddScore(score);
@@ -2391,6 +2667,12 @@ void MapDatabase::SetChartUpdateBehavior(bool transferScores) {
 	if (m_impl != NULL)
 		m_impl->SetChartUpdateBehavior(transferScores);
 }
+void MapDatabase::SetChartReadThreads(uint32 numThreads)
+{
+	m_chartReadThreads = numThreads;
+	if (m_impl != NULL)
+		m_impl->SetChartReadThreads(numThreads);
+}
 ChartIndex* MapDatabase::FindFirstChartByPath(const String& s)
 {
 	return m_impl->FindFirstChartByPath(s);
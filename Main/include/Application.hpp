@@ -142,6 +142,7 @@ private:
 	void m_unpackSkins();
 	void m_loadResponsiveInputSetting();
 	void m_InitLightPlugins();
+	void m_ApplyAudioTelemetry();
 
 	RenderState m_renderStateBase;
 	RenderQueue m_renderQueueBase;
@@ -153,6 +154,8 @@ private:
 	Material m_guiTex;
 	Map<String, CachedJacketImage*> m_jacketImages;
 	String m_lastMapPath;
+	// Whether a telemetry csv is written for this session
+	bool m_audioTelemetry = false;
 	Thread m_updateThread;
 	Thread m_fontBakeThread;
 	class Beatmap* m_currentMap = nullptr;
@@ -2,6 +2,8 @@
 #include <Beatmap/Beatmap.hpp>
 #include <Beatmap/AudioEffects.hpp>
 #include <Audio/AudioStream.hpp>
+#include <Audio/Sample.hpp>
+#include <functional>
 
 /*
 	Audio effect with customized parameters
@@ -36,7 +38,12 @@ public:
 	~AudioPlayback();
 	// Loads audio for beatmap
 	//	specify the root path for the map in order to let this class find the audio files
-	bool Init(class BeatmapPlayback &playback, const String &mapRootPath, bool preRender);
+	//	chartHash identifies the chart for caching pre-rendered effects, leave empty to not cache them
+	bool Init(class BeatmapPlayback &playback, const String &mapRootPath, bool preRender, const String &chartHash = String());
+
+	// Waits until pre-rendered effects are ready for playing from time, the rest is rendered in the background
+	//	onProgress is called with the fraction of effects rendered so far
+	void WaitForPreRender(MapTime time, const std::function<void(float)> &onProgress = nullptr);
 
 	// Updates effects
 	void Tick(float deltaTime);
@@ -57,7 +64,8 @@ public:
 	// Sets either button effect 0 or 1
 	void SetEffect(uint32 index, HoldObjectState *object, class BeatmapPlayback &playback);
 	// Sets the hearability of the currently active button effect on 'index'
-	void SetEffectEnabled(uint32 index, bool enabled);
+	//	time is the music time at which this happens, right away by default
+	void SetEffectEnabled(uint32 index, bool enabled, MapTime time = INT32_MIN);
 	void ClearEffect(uint32 index, HoldObjectState *object);
 
 	// Sets the effect to be used for lasers
@@ -86,23 +94,37 @@ public:
 	float GetPlaybackSpeed() const;
 	void SetVolume(float volume);
 
+	// Plays sample at the exact frame where the music reaches time, right away if that already happened
+	void PlaySampleAt(SampleRes *sample, MapTime time);
+
 	Ref<AudioStream> GetMusic() const { return m_music; }
 
 private:
 	// Returns the track that should have effects applied to them
 	Ref<AudioStream> m_GetDSPTrack();
+	// Position in samples of track at time, INT32_MIN maps to a position that is always reached
+	int64 m_GetSamplePos(const AudioStream *track, MapTime time) const;
 	void m_CleanupDSP(class DSP *&ptr);
 	void m_SetLaserEffectParameter(float input);
 	void m_PreRenderDSPTrack();
+	// Makes sure effects are rendered some time ahead of time, blocks so only used when starting or seeking
+	void m_KeepPreRenderAhead(MapTime time);
 
 	// Map player
 	class BeatmapPlayback *m_playback;
 	const class Beatmap *m_beatmap;
 	// Root path of where the map was loaded from
 	String m_beatmapRootPath;
+	// Path of the track without effects
+	String m_musicPath;
+	String m_chartHash;
 
 	Ref<AudioStream> m_music;
 	Ref<AudioStream> m_fxtrack;
+	// Renders effects into m_fxtrack in the background
+	Ref<class DSPPreRenderer> m_preRenderer;
+	// Whether the play position has passed the rendered effects
+	bool m_preRenderBehind = false;
 	Vector<SwitchableAudio> m_switchables;
 	Vector<int32> m_enabledSwitchables;
 	int32 m_laserSwitchable = -1;
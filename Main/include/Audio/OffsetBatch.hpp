@@ -0,0 +1,84 @@
+#pragma once
+#include <Audio/AudioStream.hpp>
+#include <Shared/Jobs.hpp>
+#include <atomic>
+#include <mutex>
+
+class MapDatabase;
+
+/*
+	Computes the offset of every chart without a custom offset in the background
+	Every folder is analysed by its own job and only a few of them are queued at a time,
+	 which keeps the job sheduler free for other work and bounds the memory use
+	Results are written to the database from the main thread in batches
+*/
+class OffsetBatch : Unique
+{
+public:
+	OffsetBatch(MapDatabase* database);
+	// Stops analysing and waits for running jobs
+	~OffsetBatch();
+
+	// Queues the first folders, returns the number of charts that will be analysed
+	uint32 Start(JobSheduler* sheduler);
+	// Stops after the charts that are being analysed
+	void Cancel();
+	// Stops queueing folders until Resume is called, e.g. while a song is being played
+	void Pause();
+	void Resume();
+
+	// Writes finished offsets to the database, queues the next folders and reports progress through OnSearchStatusUpdated
+	//	call from the main thread
+	void Update();
+
+	bool IsFinished() const;
+	uint32 GetNumCharts() const { return m_numCharts; }
+	uint32 GetNumAnalysed() const { return m_numAnalysed; }
+
+	// Called from Update once every chart is analysed or the batch was cancelled
+	Delegate<> OnFinished;
+
+private:
+	struct Entry
+	{
+		int32 chartId;
+		String path;
+	};
+	struct Result
+	{
+		int32 chartId;
+		int offset;
+	};
+
+	// Queues jobs for the next folders until the maximum number of jobs is running
+	void m_QueueFolders();
+	// Analyses every chart in the folder at index
+	void m_AnalyseFolder(uint32 index);
+	// Computes the offset of a single chart, music is reused while the chart uses the song at musicPath
+	//	returns false if the chart couldn't be analysed or the estimate isn't confident enough
+	bool m_Analyse(const Entry& entry, String& musicPath, Ref<AudioStream>& music, int& outOffset);
+	// Writes the finished offsets to the database
+	void m_WriteResults();
+
+	MapDatabase* m_database;
+	// Charts grouped by folder so difficulties sharing a song decode it once
+	Vector<Vector<Entry>> m_folders;
+	uint32 m_nextFolder = 0;
+	std::atomic<bool> m_cancel = { false };
+	bool m_paused = false;
+	JobSheduler* m_sheduler = nullptr;
+	uint32 m_maxJobs = 1;
+	// Jobs of the folders that are being analysed
+	Vector<Job> m_jobs;
+	Timer m_timer;
+
+	uint32 m_numCharts = 0;
+	std::atomic<uint32> m_numAnalysed = { 0 };
+	uint32 m_numWritten = 0;
+	uint32 m_lastReported = UINT32_MAX;
+	bool m_finished = false;
+
+	// Offsets that still have to be written, guarded by m_resultLock
+	std::mutex m_resultLock;
+	Vector<Result> m_results;
+};
@@ -6,6 +6,10 @@ class AudioPlayback;
 class Beatmap;
 struct ChartIndex;
 
+/*
+	Estimates the offset of a chart from its audio
+	A spectral flux onset function of the whole song is cross-correlated with the beats of the chart
+*/
 class OffsetComputer
 {
 public:
@@ -17,9 +21,18 @@ public:
 	OffsetComputer& operator= (const OffsetComputer&) = delete;
 	OffsetComputer& operator= (OffsetComputer&&) = delete;
 
+	// Only succeeds when the confidence is at least MIN_CONFIDENCE
 	bool Compute(int& outOffset);
 	static bool Compute(const ChartIndex* chart, int& outOffset);
 
+	// outOffset is also the center of the search
+	// outConfidence is between 0 (another offset fits as well) and 1 (the offset clearly stands out)
+	bool Compute(int& outOffset, float& outConfidence);
+	static bool Compute(const ChartIndex* chart, int& outOffset, float& outConfidence);
+
+	// Estimates below this confidence are considered guesses
+	static constexpr float MIN_CONFIDENCE = 0.1f;
+
 private:
 	struct Beat {
 		Beat(MapTime time, float weight) noexcept : time(time), weight(weight) {}
@@ -29,17 +42,15 @@ private:
 		float weight;
 	};
 
-	// Length of the region to use for offset computation
-	static constexpr MapTime COMPUTE_WINDOW = 25'000;
-
-	// Maximal # of beats for consideration
-	// (would never be achieved in practice)
-	static constexpr int MAX_BEATS = 5'000;
-
-	// Maximal absolute value for offset
+	// Maximal distance of the offset from the search center
 	static constexpr MapTime MAX_OFFSET = 50;
 
+	// Range around the search center used as the baseline of the correlation
+	static constexpr MapTime BASELINE_RANGE = 250;
+
+	// Only one of these is set depending on how the stream stores its data
 	const float* m_pcm = nullptr;
+	const int16* m_pcm16 = nullptr;
 	uint64 m_pcmCount = 0;
 	uint32 m_sampleRate = 0;
 	const Beatmap& m_beatmap;
@@ -48,16 +59,21 @@ private:
 
 	// Reads the beats from the chart
 	void ReadBeats();
-	// Most dense 30 seconds of the chart
+	// Every beat of the chart
 	Vector<Beat> m_beats;
 
-	// Computes the energy and likelihood of onset being present in the 30 seconds window
-	void ComputeEnergy();
-	MapTime m_energyOffset;
-	// Energy and onset likelihood, stored ms-by-ms
-	Vector<float> m_energy;
-	Vector<float> m_onsetScore;
+	// Mono sample at ind
+	float GetSample(int64 ind) const;
+
+	// Computes the onset strength of the whole song
+	void ComputeOnsets();
+	// Onset strength, stored ms-by-ms
+	Vector<float> m_onsets;
 
-	int ComputeFitness(MapTime offset);
-	float GetOnsetScore(MapTime time);
-};
\ No newline at end of file
+	// Correlates the onsets with the beats for every offset within BASELINE_RANGE of the search center
+	void Correlate();
+	float GetCorrelation(MapTime offset) const;
+	MapTime m_maxLag = 0;
+	// Correlation of lag l is stored at l for positive lags and at the end for negative ones
+	Vector<float> m_correlation;
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include "Shared/Config.hpp"
 #include "Input.hpp"
+#include "Audio/Resampler.hpp"
 
 #ifdef Always
 #undef Always
@@ -166,6 +167,13 @@ DefineEnum(GameConfigKeys,
 		   WASAPI_Exclusive,
 		   MuteUnfocused,
 		   PrerenderEffects,
+		   ResamplerQuality,
+		   StreamReadAhead,
+		   MixBlockSize,
+		   PcmCacheSize,
+		   CompactAudio,
+		   AudioLatencyCompensation,
+		   AudioTelemetry,
            UseLightPlugins,
 		   LightPlugin,
 
@@ -214,6 +222,7 @@ DefineEnum(GameConfigKeys,
 		   GameplaySettingsDialogLastTab,
 		   SettingsLastTab,
 		   TransferScoresOnChartUpdate,
+		   ChartReadThreads,
 
 		   KeepFontTexture,
 
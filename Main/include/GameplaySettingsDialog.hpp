@@ -19,6 +19,7 @@ public:
     Delegate<> onPressPractice;
     Delegate<int> onSongOffsetChange;
     Delegate<> onPressComputeSongOffset;
+    Delegate<> onPressComputeAllSongOffsets;
 
 private:
     SongSelect* m_songSelectScreen = nullptr;
@@ -421,6 +421,24 @@ public:
 		return nullptr;
 	}
 
+	// Item offset places away from the selection in the current sort, wrapping around like AdvanceSelection
+	DBIndex *GetSelectionAt(int32 offset) const
+	{
+		uint32 vecLen = m_sortVec.size();
+		if (vecLen == 0)
+			return nullptr;
+
+		int32 index = ((int32)m_selectedSortIndex + offset) % (int32)vecLen;
+		if (index < 0)
+			index += vecLen;
+
+		ItemSelectIndex const *item = m_SourceCollection().Find(m_sortVec[index]);
+		if (item)
+			return m_getDBEntryFromItemIndex(item);
+
+		return nullptr;
+	}
+
 	friend class TextInput;
 	virtual void SetSearchFieldLua(Ref<TextInput> search) = 0;
 
@@ -0,0 +1,55 @@
+#pragma once
+#include "PreviewPlayer.hpp"
+#include <atomic>
+
+class AudioStream;
+
+/*
+	Opens song previews on job threads so scrolling through the song wheel doesn't wait for the disk
+	Only the preview window of the song is decoded, previews that are no longer wanted are dropped before they are decoded
+*/
+class PreviewLoader
+{
+public:
+	~PreviewLoader();
+
+	// Loads the preview that should play next, it is handed to OnLoaded once it is decoded
+	void Select(const PreviewParams& params);
+	// Previews that are likely to be selected soon, replaces the previous list
+	void Prefetch(const Vector<PreviewParams>& params);
+	// Drops every request, including the selected one
+	void Clear();
+
+	// Hands over the selected preview once it is loaded, call from the main thread
+	void Update();
+
+	// Called from Update with the selected preview, stream is null if it couldn't be loaded
+	//	the stream starts at the preview offset and ends after the preview duration
+	Delegate<const PreviewParams&, Ref<AudioStream>> OnLoaded;
+
+	// Length that is decoded for charts that don't specify a preview duration
+	static const uint32 defaultDuration;
+
+private:
+	// Shared with the job, so it outlives the loader while decoding
+	struct Request
+	{
+		PreviewParams params;
+		std::atomic<bool> cancelled = { false };
+		Ref<AudioStream> stream;
+	};
+	struct Entry
+	{
+		Ref<Request> request;
+		Job job;
+	};
+
+	void m_Load(const PreviewParams& params);
+	// Cancels requests that are neither selected nor prefetched
+	void m_Prune();
+
+	Vector<Entry> m_entries;
+	PreviewParams m_selected = { "", 0, 0 };
+	bool m_hasSelected = false;
+	Vector<PreviewParams> m_prefetch;
+};
@@ -28,8 +28,12 @@ typedef struct PreviewParams
 	uint32 offset;
 	uint32 duration;
 
-	bool operator!=(const PreviewParams& rhs)
+	bool operator!=(const PreviewParams& rhs) const
 	{
 		return filepath != rhs.filepath || offset != rhs.offset || duration != rhs.duration;
 	}
+	bool operator==(const PreviewParams& rhs) const
+	{
+		return !(*this != rhs);
+	}
 } PreviewParams;
@@ -8,6 +8,7 @@
 #include <Audio/Audio.hpp>
 #include <Graphics/ResourceManagers.hpp>
 #include <Shared/Profiling.hpp>
+#include <Shared/Time.hpp>
 #include "GameConfig.hpp"
 #include "GuiUtils.hpp"
 #include "Input.hpp"
@@ -137,8 +138,27 @@ void Application::ApplySettings()
 		}
 	}
 
+	m_ApplyAudioTelemetry();
+
 	m_SaveConfig();
 }
+void Application::m_ApplyAudioTelemetry()
+{
+	const bool enabled = g_gameConfig.GetBool(GameConfigKeys::AudioTelemetry);
+	if (!g_audio || enabled == m_audioTelemetry)
+		return;
+
+	m_audioTelemetry = enabled;
+	if (enabled)
+	{
+		Path::CreateDir(Path::Absolute("telemetry"));
+		g_audio->SetTelemetryCsv(Path::Absolute("telemetry/audio_" + Shared::Time::Now().ToString() + ".csv"));
+	}
+	else
+	{
+		g_audio->SetTelemetryCsv(String());
+	}
+}
 int32 Application::Run()
 {
 	if (!m_Init())
@@ -1183,6 +1203,14 @@ bool Application::m_Init()
 			}
 		}
 
+		g_audio->SetResamplerQuality(g_gameConfig.GetEnum<Enum_ResamplerQuality>(GameConfigKeys::ResamplerQuality));
+		g_audio->SetStreamReadAhead(g_gameConfig.GetInt(GameConfigKeys::StreamReadAhead));
+		g_audio->SetMixBlockSize(g_gameConfig.GetInt(GameConfigKeys::MixBlockSize));
+		g_audio->SetPcmCache(Path::Absolute("cache/audio"), (uint64)g_gameConfig.GetInt(GameConfigKeys::PcmCacheSize) * 1024 * 1024);
+		g_audio->SetCompactPcm(g_gameConfig.GetBool(GameConfigKeys::CompactAudio));
+		g_audio->SetLatencyCompensation(g_gameConfig.GetBool(GameConfigKeys::AudioLatencyCompensation));
+		m_ApplyAudioTelemetry();
+
 		// Debug Mute?
 		// Test tracks may get annoying when continously debugging ;)
 		if (debugMute)
@@ -1370,6 +1398,9 @@ void Application::m_MainLoop()
 		// processed callbacks for finished tasks
 		g_jobSheduler->Update();
 
+		// Write the audio callbacks of this frame
+		if (m_audioTelemetry)
+			g_audio->UpdateTelemetry();
 
 
 		m_deltaTime = m_frameTimer.SecondsAsFloat();
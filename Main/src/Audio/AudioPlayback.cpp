@@ -4,20 +4,28 @@
 #include <Beatmap/Beatmap.hpp>
 #include <Audio/Audio.hpp>
 #include <Audio/DSP.hpp>
+#include <Audio/DSPPreRenderer.hpp>
 #include <Shared/Profiling.hpp>
+#include "Application.hpp"
+
+// Amount of audio that should have its effects rendered ahead of the play position
+static const MapTime preRenderLead = 10000;
 
 AudioPlayback::AudioPlayback()
 {
 }
 AudioPlayback::~AudioPlayback()
 {
+	m_preRenderer.reset();
 	m_CleanupDSP(m_buttonDSPs[0]);
 	m_CleanupDSP(m_buttonDSPs[1]);
 	m_CleanupDSP(m_laserDSP);
 }
-bool AudioPlayback::Init(class BeatmapPlayback &playback, const String &mapRootPath, bool preRender)
+bool AudioPlayback::Init(class BeatmapPlayback &playback, const String &mapRootPath, bool preRender, const String &chartHash)
 {
 	// Cleanup exising DSP's
+	m_preRenderer.reset();
+	m_preRenderBehind = false;
 	m_currentHoldEffects[0] = nullptr;
 	m_currentHoldEffects[1] = nullptr;
 	m_CleanupDSP(m_buttonDSPs[0]);
@@ -27,6 +35,7 @@ bool AudioPlayback::Init(class BeatmapPlayback &playback, const String &mapRootP
 	m_playback = &playback;
 	m_beatmap = &playback.GetBeatmap();
 	m_beatmapRootPath = mapRootPath;
+	m_chartHash = chartHash;
 	assert(m_beatmap != nullptr);
 
 	// Set default effect type
@@ -40,6 +49,7 @@ bool AudioPlayback::Init(class BeatmapPlayback &playback, const String &mapRootP
 		Logf("Audio file for beatmap does not exists at: \"%s\"", Logger::Severity::Error, audioPath);
 		return false;
 	}
+	m_musicPath = audioPath;
 	m_music = g_audio->CreateStream(audioPath, true);
 	if (!m_music)
 	{
@@ -78,9 +88,8 @@ bool AudioPlayback::Init(class BeatmapPlayback &playback, const String &mapRootP
 
 	if (preRender)
 	{
-		m_fxtrack = AudioStream::Clone(g_audio, m_music);
-		assert(m_fxtrack);
 		m_PreRenderDSPTrack();
+		assert(m_fxtrack);
 		return true;
 	}
 
@@ -117,11 +126,42 @@ bool AudioPlayback::Init(class BeatmapPlayback &playback, const String &mapRootP
 
 	return true;
 }
+void AudioPlayback::WaitForPreRender(MapTime time, const std::function<void(float)> &onProgress)
+{
+	if (m_preRenderer)
+		m_preRenderer->WaitUntil((uint32)Math::Max(0, time + preRenderLead), onProgress);
+}
+void AudioPlayback::m_KeepPreRenderAhead(MapTime time)
+{
+	if (!m_preRenderer)
+		return;
+	if (m_preRenderer->IsFinished())
+	{
+		m_preRenderer.reset();
+		return;
+	}
+	// Only blocks when the background jobs fall behind or after seeking past them
+	WaitForPreRender(time);
+}
 void AudioPlayback::Tick(float deltaTime)
 {
+	if (!m_preRenderer)
+		return;
+	if (m_preRenderer->IsFinished())
+	{
+		m_preRenderer.reset();
+		return;
+	}
+
+	// Never wait during play, the jobs keep going and the effects are missing until they catch up
+	const bool behind = m_preRenderer->GetRenderedUntil() <= (uint32)Math::Max(0, GetPosition());
+	if (behind && !m_preRenderBehind)
+		Logf("Pre-rendering effects fell behind the play position", Logger::Severity::Warning);
+	m_preRenderBehind = behind;
 }
 void AudioPlayback::Play()
 {
+	m_KeepPreRenderAhead(GetPosition());
 	m_music->Play();
 	if (m_fxtrack)
 		m_fxtrack->Play();
@@ -141,6 +181,7 @@ MapTime AudioPlayback::GetPosition() const
 }
 void AudioPlayback::SetPosition(MapTime time)
 {
+	m_KeepPreRenderAhead(time);
 	m_music->SetPosition(time);
 	if (m_fxtrack)
 		m_fxtrack->SetPosition(time);
@@ -218,7 +259,7 @@ void AudioPlayback::SetEffect(uint32 index, HoldObjectState *object, class Beatm
 	// Add the DSP to the track
 	audioTrack->AddDSP(dsp);
 }
-void AudioPlayback::SetEffectEnabled(uint32 index, bool enabled)
+void AudioPlayback::SetEffectEnabled(uint32 index, bool enabled, MapTime time)
 {
 	assert(index <= 1);
 	m_effectMix[index] = enabled ? m_buttonEffects[index].mix.Sample() : 0.0f;
@@ -231,7 +272,9 @@ void AudioPlayback::SetEffectEnabled(uint32 index, bool enabled)
 
 	if (m_buttonDSPs[index])
 	{
-		m_buttonDSPs[index]->mix = m_effectMix[index];
+		// Also when changing right away, so a change that is still pending can't override it
+		Ref<AudioStream> audioTrack = m_GetDSPTrack();
+		audioTrack->ScheduleDSPMix(m_buttonDSPs[index], m_effectMix[index], m_GetSamplePos(audioTrack.get(), time));
 	}
 }
 void AudioPlayback::ClearEffect(uint32 index, HoldObjectState *object)
@@ -331,6 +374,16 @@ Ref<AudioStream> AudioPlayback::m_GetDSPTrack()
 		return m_fxtrack;
 	return m_music;
 }
+int64 AudioPlayback::m_GetSamplePos(const AudioStream *track, MapTime time) const
+{
+	if (time == INT32_MIN)
+		return INT64_MIN;
+	return (int64)time * track->GetSampleRate() / 1000;
+}
+void AudioPlayback::PlaySampleAt(SampleRes *sample, MapTime time)
+{
+	sample->PlayAt(m_music.get(), m_GetSamplePos(m_music.get(), time));
+}
 void AudioPlayback::SetFXTrackEnabled(bool enabled)
 {
 	if (!m_fxtrack)
@@ -534,14 +587,13 @@ void AudioPlayback::m_PreRenderDSPTrack()
 				GameAudioEffect effect = m_beatmap->GetEffect(holdObj->effectType);
 				DSP *dsp = effect.CreateDSP(*m_playback->GetTimingPointAt(chartObj->time),
 											1.0f,
-											m_fxtrack->GetSampleRate(),
+											m_music->GetSampleRate(),
 											1.0f);
 				if (dsp != nullptr)
 				{
 					effect.SetParams(dsp, *this, holdObj);
 					dsp->startTime = chartObj->time;
 					dsp->endTime = dsp->startTime + holdObj->duration;
-					dsp->SetAudioBase(m_fxtrack.get());
 					dsp->priority = GameAudioEffect::GetDefaultEffectPriority(effect.type);
 					Logf("Added %s at %dms", Logger::Severity::Debug, dsp->GetName(), dsp->startTime);
 					DSPs.Add(dsp);
@@ -550,7 +602,47 @@ void AudioPlayback::m_PreRenderDSPTrack()
 		}
 	}
 	DSPs.Sort(DSP::Sorter);
-	m_fxtrack->PreRenderDSPs(DSPs);
+
+	// One rendered track is kept per chart, the keys of its effects include all their parameters and the DSP version
+	String variant, variantKey;
+	if (!m_chartHash.empty())
+	{
+		variant = "fx|" + m_chartHash;
+		for (DSP *dsp : DSPs)
+		{
+			variantKey += dsp->GetKey() + ";";
+		}
+
+		m_fxtrack = AudioStream::LoadVariant(g_audio, m_musicPath, variant, variantKey);
+		if (m_fxtrack)
+		{
+			Logf("Loaded pre-rendered effects from cache", Logger::Severity::Info);
+			for (DSP *dsp : DSPs)
+			{
+				delete dsp;
+			}
+			return;
+		}
+	}
+
+	m_fxtrack = AudioStream::Clone(g_audio, m_music);
+	for (DSP *dsp : DSPs)
+	{
+		dsp->SetAudioBase(m_fxtrack.get());
+	}
+
+	// Rendered in the background, playback waits for the parts it needs
+	m_preRenderer = std::make_shared<DSPPreRenderer>(m_fxtrack, std::move(DSPs));
+	if (!variant.empty())
+	{
+		// Stored from the rendering thread so the copy doesn't stall the game
+		Ref<AudioStream> track = m_fxtrack;
+		String musicPath = m_musicPath;
+		m_preRenderer->onFinished = [track, musicPath, variant, variantKey]() {
+			AudioStream::StoreVariant(g_audio, musicPath, variant, variantKey, track);
+		};
+	}
+	m_preRenderer->Start(g_jobSheduler);
 }
 
 GameAudioEffect::GameAudioEffect(const AudioEffect &other)
@@ -0,0 +1,203 @@
+#include "stdafx.h"
+#include "Audio/OffsetBatch.hpp"
+#include "Audio/OffsetComputer.hpp"
+#include "Application.hpp"
+
+#include <Audio/Audio.hpp>
+#include <Beatmap/Beatmap.hpp>
+#include <Beatmap/MapDatabase.hpp>
+#include <algorithm>
+#include <thread>
+
+// Every running job holds one decoded song at a time
+static const uint32 maxJobs = 4;
+// Number of offsets written to the database in one transaction
+static const uint32 writeBatchSize = 32;
+
+OffsetBatch::OffsetBatch(MapDatabase* database) : m_database(database)
+{
+}
+OffsetBatch::~OffsetBatch()
+{
+	m_cancel = true;
+	for (Job& job : m_jobs)
+	{
+		job->Terminate();
+	}
+	m_WriteResults();
+}
+uint32 OffsetBatch::Start(JobSheduler* sheduler)
+{
+	m_timer.Restart();
+
+	Map<int32, Vector<Entry>> folders;
+	for (const auto& it : m_database->GetChartMap())
+	{
+		const ChartIndex* chart = it.second;
+		if (chart->custom_offset != 0)
+			continue;
+
+		folders[chart->folderId].Add({ chart->id, Path::Normalize(chart->path) });
+		++m_numCharts;
+	}
+	for (auto& it : folders)
+	{
+		m_folders.Add(std::move(it.second));
+	}
+
+	Logf("OffsetBatch: Computing the offsets of %u charts in %u folders", Logger::Severity::Info, m_numCharts, (uint32)m_folders.size());
+	m_sheduler = sheduler;
+	if (!m_sheduler)
+		return m_numCharts;
+
+	// Leave at least half of the sheduler threads free for loading charts, songs and textures
+	const uint32 numThreads = Math::Max(2u, std::thread::hardware_concurrency()) - 2;
+	m_maxJobs = Math::Max(1u, Math::Min(numThreads / 2, maxJobs));
+	m_QueueFolders();
+
+	return m_numCharts;
+}
+void OffsetBatch::Cancel()
+{
+	m_cancel = true;
+}
+void OffsetBatch::Pause()
+{
+	m_paused = true;
+}
+void OffsetBatch::Resume()
+{
+	m_paused = false;
+	m_QueueFolders();
+}
+void OffsetBatch::Update()
+{
+	if (m_finished)
+		return;
+
+	m_jobs.erase(std::remove_if(m_jobs.begin(), m_jobs.end(), [](const Job& job) { return job->IsFinished(); }), m_jobs.end());
+	m_QueueFolders();
+	const bool jobsDone = m_jobs.empty() && (m_cancel || !m_sheduler || m_nextFolder >= m_folders.size());
+
+	bool write;
+	{
+		std::lock_guard<std::mutex> guard(m_resultLock);
+		write = jobsDone || m_results.size() >= writeBatchSize;
+	}
+	if (write)
+		m_WriteResults();
+
+	const uint32 numAnalysed = m_numAnalysed;
+	if (numAnalysed != m_lastReported)
+	{
+		m_lastReported = numAnalysed;
+		m_database->OnSearchStatusUpdated.Call(Utility::Sprintf("Computing chart offsets [%u / %u]", numAnalysed, m_numCharts));
+	}
+
+	if (jobsDone)
+	{
+		m_finished = true;
+		Logf("OffsetBatch: Set the offset of %u / %u charts in %.1f s", Logger::Severity::Info, m_numWritten, m_numCharts, m_timer.SecondsAsDouble());
+		m_database->OnSearchStatusUpdated.Call("");
+		OnFinished.Call();
+	}
+}
+bool OffsetBatch::IsFinished() const
+{
+	return m_finished;
+}
+void OffsetBatch::m_QueueFolders()
+{
+	if (!m_sheduler || m_paused)
+		return;
+
+	while (!m_cancel && m_jobs.size() < m_maxJobs && m_nextFolder < m_folders.size())
+	{
+		const uint32 index = m_nextFolder++;
+		Job job = JobBase::CreateLambda([this, index]() {
+			m_AnalyseFolder(index);
+			return true;
+		});
+		m_jobs.Add(job);
+		m_sheduler->Queue(job);
+	}
+}
+void OffsetBatch::m_AnalyseFolder(uint32 index)
+{
+	String musicPath;
+	Ref<AudioStream> music;
+	for (const Entry& entry : m_folders[index])
+	{
+		if (m_cancel)
+			break;
+
+		int offset = 0;
+		if (m_Analyse(entry, musicPath, music, offset) && offset != 0)
+		{
+			std::lock_guard<std::mutex> guard(m_resultLock);
+			m_results.Add({ entry.chartId, offset });
+		}
+		++m_numAnalysed;
+	}
+}
+bool OffsetBatch::m_Analyse(const Entry& entry, String& musicPath, Ref<AudioStream>& music, int& outOffset)
+{
+	Beatmap beatmap;
+	File mapFile;
+	if (!mapFile.OpenRead(entry.path))
+		return false;
+
+	FileReader reader(mapFile);
+	if (!beatmap.Load(reader))
+		return false;
+
+	String audioPath = Path::Normalize(Path::RemoveLast(entry.path, nullptr) + Path::sep + beatmap.GetMapSettings().audioNoFX);
+	audioPath.TrimBack(' ');
+	if (audioPath != musicPath)
+	{
+		// Release the previous song before decoding the next one
+		music.reset();
+		musicPath = audioPath;
+		if (!Path::FileExists(audioPath))
+			return false;
+
+		// Decoded without the pcm cache or the mixer, every song is only used once
+		music = g_audio->DecodeStream(audioPath);
+	}
+	if (!music)
+		return false;
+
+	float confidence = 0.0f;
+	outOffset = 0;
+	if (!OffsetComputer(music, beatmap).Compute(outOffset, confidence))
+		return false;
+
+	return confidence >= OffsetComputer::MIN_CONFIDENCE;
+}
+void OffsetBatch::m_WriteResults()
+{
+	Vector<Result> results;
+	{
+		std::lock_guard<std::mutex> guard(m_resultLock);
+		results = std::move(m_results);
+		m_results.clear();
+	}
+	if (results.empty())
+		return;
+
+	Vector<ChartIndex*> charts;
+	const auto& chartMap = m_database->GetChartMap();
+	for (const Result& result : results)
+	{
+		// Skip charts that were removed or got an offset in the meantime
+		auto it = chartMap.find(result.chartId);
+		if (it == chartMap.end() || it->second->custom_offset != 0)
+			continue;
+
+		it->second->custom_offset = result.offset;
+		charts.Add(it->second);
+	}
+
+	m_database->UpdateChartOffsets(charts);
+	m_numWritten += (uint32)charts.size();
+}
@@ -2,12 +2,26 @@
 #include "Audio/AudioPlayback.hpp"
 #include "Audio/OffsetComputer.hpp"
 
-#include <Audio/Audio_Impl.hpp>
+#include <Audio/FFT.hpp>
 #include <Beatmap/Beatmap.hpp>
 #include <Beatmap/BeatmapPlayback.hpp>
 #include <Beatmap/MapDatabase.hpp>
 #include <Shared/Profiling.hpp>
-#include <array>
+
+// The audio is reduced to about this rate before computing onsets
+static constexpr uint32 ONSET_SAMPLE_RATE = 11025;
+// STFT frame size and hop of the onset function, the hop is in ms
+static constexpr uint32 ONSET_FRAME_SIZE = 128;
+static constexpr double ONSET_HOP = 4.0;
+// Log compression of the power spectrum, makes quiet onsets count too
+static constexpr float ONSET_COMPRESSION = 1000.0f;
+// The local mean of the flux within this many ms is subtracted
+static constexpr MapTime ONSET_MEAN_RADIUS = 50;
+
+// Width of a peak of the correlation, in ms
+static constexpr MapTime PEAK_WIDTH = 5;
+// Peaks this many standard deviations above the baseline are fully confident
+static constexpr float PROMINENCE_SCALE = 4.0f;
 
 static inline double GetBeatWeight(double d)
 {
@@ -16,18 +30,41 @@ static inline double GetBeatWeight(double d)
 	return 1.0 - d;
 }
 
+static bool IsConfident(int offset, float confidence)
+{
+	if (confidence >= OffsetComputer::MIN_CONFIDENCE)
+		return true;
+
+	Logf("OffsetComputer::Compute: Ignoring offset %d, the confidence is too low (%.3f)", Logger::Severity::Warning, offset, confidence);
+	return false;
+}
+
 OffsetComputer::OffsetComputer(AudioPlayback& audioPlayback)
 	: OffsetComputer(audioPlayback.GetMusic(), audioPlayback.GetBeatmap())
 {
 }
 
 OffsetComputer::OffsetComputer(Ref<AudioStream> music, const Beatmap& beatmap)
-	: m_pcm(music->GetPCM()), m_pcmCount(music->GetPCMCount()), m_sampleRate(music->GetSampleRate()),
+	: m_pcm(music->GetPCM()), m_pcm16(music->GetPCM16()), m_pcmCount(music->GetPCMCount()), m_sampleRate(music->GetSampleRate()),
 	m_beatmap(beatmap)
 {
 }
 
 bool OffsetComputer::Compute(const ChartIndex* chart, int& outOffset)
+{
+	float confidence = 0.0f;
+	int offset = outOffset;
+	if (!Compute(chart, offset, confidence))
+		return false;
+
+	if (!IsConfident(offset, confidence))
+		return false;
+
+	outOffset = offset;
+	return true;
+}
+
+bool OffsetComputer::Compute(const ChartIndex* chart, int& outOffset, float& outConfidence)
 {
 	const String chartPath = Path::Normalize(chart->path);
 	const String chartRootPath = Path::RemoveLast(chartPath, nullptr);
@@ -49,14 +86,29 @@ bool OffsetComputer::Compute(const ChartIndex* chart, int& outOffset)
 	if (!audioPlayback.Init(beatmapPlayback, chartRootPath, false))
 		return false;
 
-	return OffsetComputer(audioPlayback).Compute(outOffset);
+	return OffsetComputer(audioPlayback).Compute(outOffset, outConfidence);
 }
 
 bool OffsetComputer::Compute(int& outOffset)
+{
+	float confidence = 0.0f;
+	int offset = outOffset;
+	if (!Compute(offset, confidence))
+		return false;
+
+	if (!IsConfident(offset, confidence))
+		return false;
+
+	outOffset = offset;
+	return true;
+}
+
+bool OffsetComputer::Compute(int& outOffset, float& outConfidence)
 {
 	ProfilerScope $("OffsetComputer::Compute");
+	Timer timer;
 
-	if (!m_pcm || m_pcmCount <= 0 || m_sampleRate <= 0)
+	if ((!m_pcm && !m_pcm16) || m_pcmCount <= 0 || m_sampleRate <= 0)
 	{
 		Log("OffsetComputer::Compute: The stream is not loaded!", Logger::Severity::Warning);
 		return false;
@@ -75,36 +127,23 @@ bool OffsetComputer::Compute(int& outOffset)
 
 	m_offsetCenter = outOffset;
 
-	ComputeEnergy();
-	
-	if (m_energy.empty())
+	ComputeOnsets();
+
+	if (m_onsets.empty())
 	{
 		Log("OffsetComputer::Compute: Insufficient data...", Logger::Severity::Warning);
 		return false;
 	}
 
-	std::array<int, MAX_OFFSET*2 + 1> fitnesses;
-
-	// This O(MAX_OFFSET*MAX_BEATS) is sub-optimal for computing convolution,
-	// but it's simple and doesn't matter a lot in practice.
-	for(MapTime offset = -MAX_OFFSET; offset <= MAX_OFFSET; ++offset)
-	{
-		fitnesses[MAX_OFFSET + offset] = ComputeFitness(offset+m_offsetCenter);
-	}
+	Correlate();
 
 	std::vector<MapTime> peaks;
-
-	for (MapTime offset = -MAX_OFFSET; offset <= MAX_OFFSET; ++offset)
+	for (MapTime offset = m_offsetCenter - MAX_OFFSET; offset <= m_offsetCenter + MAX_OFFSET; ++offset)
 	{
-		// Only consider the peaks of fitnesses
-		if (-MAX_OFFSET < offset && offset < MAX_OFFSET)
-		{
-			const int index = static_cast<int>(offset + MAX_OFFSET);
-			if (!(fitnesses[index - 1] < fitnesses[index] && fitnesses[index] >= fitnesses[index + 1]))
-				continue;
-		}
-
-		peaks.emplace_back(offset);
+		// Only consider the peaks of the correlation, a peak just outside of the range doesn't count
+		const float correlation = GetCorrelation(offset);
+		if (GetCorrelation(offset - 1) < correlation && correlation >= GetCorrelation(offset + 1))
+			peaks.emplace_back(offset);
 	}
 
 	if (peaks.empty())
@@ -113,18 +152,53 @@ bool OffsetComputer::Compute(int& outOffset)
 		return false;
 	}
 
-	std::sort(peaks.begin(), peaks.end(), [&fitnesses](MapTime a, MapTime b) {
-		return fitnesses[a + MAX_OFFSET] > fitnesses[b + MAX_OFFSET];
+	std::sort(peaks.begin(), peaks.end(), [this](MapTime a, MapTime b) {
+		return GetCorrelation(a) > GetCorrelation(b);
 	});
 
 	for (size_t i = 0; i < 5 && i < peaks.size(); ++i)
 	{
-		Logf("offset %3d | score = %d", Logger::Severity::Info, peaks[i]+m_offsetCenter, fitnesses[peaks[i] + MAX_OFFSET]);
+		Logf("offset %3d | score = %.3f", Logger::Severity::Info, peaks[i], GetCorrelation(peaks[i]));
 	}
 
-	Logf("OffsetComputer::Compute: Determined offset: %d (fitness = %d)", Logger::Severity::Info, peaks[0]+m_offsetCenter, fitnesses[peaks[0] + MAX_OFFSET]);
+	// Baseline of the correlation, the offsets around the search range mostly miss the beats
+	double sum = 0.0, sumSq = 0.0;
+	for (MapTime offset = m_offsetCenter - BASELINE_RANGE; offset <= m_offsetCenter + BASELINE_RANGE; ++offset)
+	{
+		const double correlation = GetCorrelation(offset);
+		sum += correlation;
+		sumSq += correlation * correlation;
+	}
+	const double count = static_cast<double>(BASELINE_RANGE * 2 + 1);
+	const float mean = static_cast<float>(sum / count);
+	const float deviation = static_cast<float>(sqrt(Math::Max(sumSq / count - (sum / count) * (sum / count), 0.0)));
+
+	// Confidence drops when another peak comes close to the best one, or when the best one barely stands out
+	const MapTime best = peaks[0];
+	float runnerUp = mean;
+	for (size_t i = 1; i < peaks.size(); ++i)
+	{
+		if (std::abs(peaks[i] - best) > PEAK_WIDTH)
+		{
+			runnerUp = Math::Max(runnerUp, GetCorrelation(peaks[i]));
+			break;
+		}
+	}
 
-	outOffset = static_cast<int>(peaks[0]+m_offsetCenter);
+	const float height = GetCorrelation(best) - mean;
+	float confidence = 0.0f;
+	if (height > 0.0f && deviation > 0.0f)
+	{
+		const float separation = (GetCorrelation(best) - runnerUp) / height;
+		const float prominence = height / deviation / PROMINENCE_SCALE;
+		confidence = Math::Clamp(separation, 0.0f, 1.0f) * Math::Clamp(prominence, 0.0f, 1.0f);
+	}
+
+	Logf("OffsetComputer::Compute: Determined offset: %d (confidence = %.3f) in %.1f ms", Logger::Severity::Info,
+		best, confidence, timer.SecondsAsDouble() * 1000.0);
+
+	outOffset = static_cast<int>(best);
+	outConfidence = confidence;
 	return true;
 }
 
@@ -135,12 +209,6 @@ void OffsetComputer::ReadBeats()
 
 	MapTime lastBeat = -1;
 
-	int regionBeginInd = 0;
-	int regionEndInd = 0;
-
-	int maxBeatsBeginInd = 0;
-	int maxBeatsCount = 0;
-
 	const Vector<TimingPoint>& timingPoints = m_beatmap.GetTimingPoints();
 	int timingPointInd = 0;
 
@@ -160,20 +228,12 @@ void OffsetComputer::ReadBeats()
 
 		if (currBeat == lastBeat) continue;
 
-		while (regionBeginInd < regionEndInd && COMPUTE_WINDOW <= currBeat - m_beats[regionBeginInd].time)
-		{
-			++regionBeginInd;
-		}
-
 		// Compute weight based on beats
 		float weight = 1.0f;
 		if (!timingPoints.empty())
 		{
-			if (timingPointInd + 1 < static_cast<int>(timingPoints.size()))
-			{
-				if (timingPoints[timingPointInd + 1].time <= currBeat)
-					++timingPointInd;
-			}
+			while (timingPointInd + 1 < static_cast<int>(timingPoints.size()) && timingPoints[timingPointInd + 1].time <= currBeat)
+				++timingPointInd;
 
 			const TimingPoint& timingPoint = timingPoints[timingPointInd];
 			const double barDuration = timingPoint.GetBarDuration();
@@ -185,142 +245,170 @@ void OffsetComputer::ReadBeats()
 		}
 
 		m_beats.emplace_back(currBeat, weight);
-		++regionEndInd;
-
-		if (regionEndInd - regionBeginInd > maxBeatsCount)
-		{
-			maxBeatsCount = regionEndInd - regionBeginInd;
-			maxBeatsBeginInd = regionBeginInd;
-		}
 
 		lastBeat = currBeat;
 	}
-
-	if (m_beats.empty()) return;
-	assert(maxBeatsCount > 0);
-
-	if (maxBeatsCount > MAX_BEATS)
-	{
-		Logf("The chart contains too much # of beats (%d / max %d)", Logger::Severity::Warning,
-			maxBeatsCount, MAX_BEATS);
-
-		maxBeatsCount = MAX_BEATS;
-	}
-
-	for (int i = 0; i < maxBeatsCount; ++i)
-	{
-		m_beats[i] = m_beats[maxBeatsBeginInd + i];
-	}
-
-	m_beats.resize(maxBeatsCount);
 }
 
-void OffsetComputer::ComputeEnergy()
+float OffsetComputer::GetSample(int64 ind) const
 {
-	constexpr MapTime ENERGY_MARGIN = MAX_OFFSET + 5;
-	constexpr MapTime ENERGY_COUNT = COMPUTE_WINDOW + ENERGY_MARGIN * 2;
-	constexpr float ENERGY_EPSILON = 0.000'001f;
+	if (m_pcm16)
+		return (m_pcm16[2*ind] + m_pcm16[2*ind + 1]) / 65534.0f;
+	return (m_pcm[2*ind] + m_pcm[2*ind + 1]) * 0.5f;
+}
 
-	m_energy.clear();
-	m_energy.resize(ENERGY_COUNT, 0);
-	
-	m_onsetScore.clear();
-	m_onsetScore.resize(ENERGY_COUNT, 0);
+void OffsetComputer::ComputeOnsets()
+{
+	m_onsets.clear();
 
-	if (m_beats.empty())
+	// Mono and downsampled, averaging is a rough low-pass but the onsets survive it
+	const uint32 decimation = Math::Max(1u, (m_sampleRate + ONSET_SAMPLE_RATE / 2) / ONSET_SAMPLE_RATE);
+	const double rate = static_cast<double>(m_sampleRate) / decimation;
+	Vector<float> mono(static_cast<size_t>(m_pcmCount / decimation));
+	for (size_t i = 0; i < mono.size(); ++i)
 	{
-		m_energyOffset = 0;
-		return;
+		float sum = 0.0f;
+		for (uint32 j = 0; j < decimation; ++j)
+			sum += GetSample(static_cast<int64>(i * decimation + j));
+		mono[i] = sum / decimation;
 	}
 
-	m_energyOffset = m_beats[0].time + m_offsetCenter - ENERGY_MARGIN;
-
-	int64 ind = (static_cast<int64>(m_energyOffset) * m_sampleRate) / 1000;
-	if (ind >= static_cast<int64>(m_pcmCount))
-	{
-		m_energy.clear();
-		m_energyOffset = 0;
-		m_onsetScore.clear();
-
+	if (mono.size() < ONSET_FRAME_SIZE * 2)
 		return;
-	}
 
-	const int64 endInd = ((static_cast<int64>(m_energyOffset) + ENERGY_COUNT) * m_sampleRate) / 1000;
-	int64 nextInd = (static_cast<int64>(m_energyOffset + 1) * m_sampleRate) / 1000;
-	int64 intervalSize = nextInd - ind;
+	const size_t hop = Math::Max<size_t>(1, static_cast<size_t>(rate * ONSET_HOP / 1000.0));
+	const size_t numFrames = (mono.size() - ONSET_FRAME_SIZE) / hop + 1;
+	const uint32 numBins = ONSET_FRAME_SIZE / 2;
+
+	float window[ONSET_FRAME_SIZE];
+	for (uint32 i = 0; i < ONSET_FRAME_SIZE; ++i)
+		window[i] = 0.5f - 0.5f * cosf(2.0f * Math::pi * i / ONSET_FRAME_SIZE);
 
-	int64 energyInd = 0;
-	
-	float prevAmp = ind <= 0 ? 0 : std::hypotf(m_pcm[2*ind - 2], m_pcm[2*ind - 1]);
-	float currAmp = ind < 0 ? 0 : std::hypotf(m_pcm[2*ind], m_pcm[2*ind + 1]);
+	// Spectral flux, the sum of the increases of the (compressed) magnitude of every bin
+	FFT fft(ONSET_FRAME_SIZE);
+	std::complex<float> spectrum[ONSET_FRAME_SIZE];
+	Vector<float> magnitude(numBins + 1, 0.0f);
+	Vector<float> flux(numFrames, 0.0f);
+	bool isQuiet = true;
 
-	for (; ind < endInd; ++ind)
+	// The frames are real, so two of them are transformed at once as the real and imaginary part
+	for (size_t frame = 0; frame < numFrames; frame += 2)
 	{
-		if (ind >= nextInd)
+		const float* first = &mono[frame * hop];
+		const float* second = frame + 1 < numFrames ? &mono[(frame + 1) * hop] : nullptr;
+		for (uint32 i = 0; i < ONSET_FRAME_SIZE; ++i)
+			spectrum[i] = std::complex<float>(first[i] * window[i], second ? second[i] * window[i] : 0.0f);
+
+		fft.Transform(spectrum);
+
+		for (size_t k = 0; k < 2 && frame + k < numFrames; ++k)
 		{
-			++energyInd;
-			nextInd = ((static_cast<int64>(m_energyOffset) + energyInd + 1) * m_sampleRate) / 1000;
-			intervalSize = nextInd - ind;
+			float sum = 0.0f;
+			for (uint32 bin = 1; bin <= numBins; ++bin)
+			{
+				// Separates the spectra of both frames, X[k] + conj(X[N-k]) for the first and (X[k] - conj(X[N-k])) / i for the second
+				const std::complex<float> x = spectrum[bin];
+				const std::complex<float> y = spectrum[(ONSET_FRAME_SIZE - bin) % ONSET_FRAME_SIZE];
+				const float re = k == 0 ? x.real() + y.real() : x.imag() + y.imag();
+				const float im = k == 0 ? x.imag() - y.imag() : y.real() - x.real();
+
+				const float curr = std::log1p(ONSET_COMPRESSION * (re * re + im * im));
+				sum += Math::Max(curr - magnitude[bin], 0.0f);
+				magnitude[bin] = curr;
+			}
 
-			// Check for abnormal cases
-			if (intervalSize <= 0) intervalSize = 0;
-			if (energyInd >= COMPUTE_WINDOW) break;
+			// The first frame is compared against silence
+			if (frame + k > 0)
+				flux[frame + k] = sum;
+			if (sum > 0.0f)
+				isQuiet = false;
 		}
+	}
 
-		const float nextAmp = ind < -1 || ind + 1 >= static_cast<int64>(m_pcmCount) ? 0 : std::hypotf(m_pcm[2*ind + 2], m_pcm[2*ind + 3]);
-
-		// Compute energy based on Newton's laws (?)
-		const float v = (nextAmp - prevAmp) / 2;
-		const float a = (prevAmp + nextAmp - 2 * currAmp);
-		const float energySq = v * v - currAmp * a;
-		m_energy[energyInd] += std::sqrt(energySq < 0 ? 0 : energySq) / intervalSize;
+	if (isQuiet)
+		return;
 
-		prevAmp = currAmp;
-		currAmp = nextAmp;
+	// Keeps only the flux standing out from its surroundings
+	const size_t meanRadius = Math::Max<size_t>(1, static_cast<size_t>(ONSET_MEAN_RADIUS / ONSET_HOP));
+	Vector<double> prefix(numFrames + 1, 0.0);
+	for (size_t i = 0; i < numFrames; ++i)
+		prefix[i + 1] = prefix[i] + flux[i];
 
-		if (ind + 1 >= static_cast<int64>(m_pcmCount)) break;
+	Vector<float> onsets(numFrames);
+	for (size_t i = 0; i < numFrames; ++i)
+	{
+		const size_t begin = i > meanRadius ? i - meanRadius : 0;
+		const size_t end = Math::Min(i + meanRadius + 1, numFrames);
+		const float mean = static_cast<float>((prefix[end] - prefix[begin]) / (end - begin));
+		onsets[i] = Math::Max(flux[i] - mean, 0.0f);
 	}
 
-	bool isQuiet = true;
+	// Because of the log compression an onset raises the flux most when it is about three quarters into the frame
+	const double frameOffset = ONSET_FRAME_SIZE * 0.75 - hop * 0.5 + (decimation - 1) * 0.5 / decimation;
 
-	// This is an experimentally-determined formula.
-	for (ind = 1; ind < ENERGY_COUNT; ++ind)
+	const size_t length = static_cast<size_t>(m_pcmCount * 1000 / m_sampleRate) + 1;
+	m_onsets.resize(length, 0.0f);
+	for (size_t time = 0; time < length; ++time)
 	{
-		const float min_energy = m_energy[ind - 1] * 0.995f;
-		if (m_energy[ind] < min_energy) m_energy[ind] = min_energy;
-
-		if (m_energy[ind] > ENERGY_EPSILON)
-			isQuiet = false;
-
-		const float prevEnergy = std::log(std::max(m_energy[ind - 1], ENERGY_EPSILON));
-		const float currEnergy = std::log(std::max(m_energy[ind], ENERGY_EPSILON));
+		const double position = (time * rate / 1000.0 - frameOffset) / hop;
+		if (position < 0.0)
+			continue;
 
-		m_onsetScore[ind] = (currEnergy - prevEnergy) * m_energy[ind];
-	}
+		const size_t frame = static_cast<size_t>(position);
+		if (frame + 1 >= numFrames)
+			break;
 
-	if (isQuiet)
-	{
-		m_energy.clear();
-		m_onsetScore.clear();
+		const float t = static_cast<float>(position - frame);
+		m_onsets[time] = onsets[frame] * (1.0f - t) + onsets[frame + 1] * t;
 	}
 }
 
-int OffsetComputer::ComputeFitness(MapTime offset)
+void OffsetComputer::Correlate()
 {
-	float fitness = 0;
+	// The padding keeps lags up to m_maxLag from wrapping around
+	m_maxLag = std::abs(m_offsetCenter) + BASELINE_RANGE + 1;
+	const size_t size = FFT::GetPowerOfTwo(static_cast<uint32>(m_onsets.size() + m_maxLag * 2 + 1));
+
+	// Onsets in the real part, the beat impulses in the imaginary part
+	Vector<std::complex<float>> signal(size);
+	for (size_t i = 0; i < m_onsets.size(); ++i)
+		signal[i] = m_onsets[i];
+
 	for (const Beat& beat : m_beats)
 	{
-		fitness += 10.0f * GetOnsetScore(beat.time + offset) * beat.weight;
+		// Beats this far out can't line up with any onset
+		if (beat.time < 0 || static_cast<size_t>(beat.time) >= m_onsets.size() + m_maxLag)
+			continue;
+		signal[beat.time] += std::complex<float>(0.0f, beat.weight);
 	}
 
-	return static_cast<int>(fitness);
+	FFT fft(static_cast<uint32>(size));
+	fft.Transform(signal.data());
+
+	// Separates both spectra and multiplies the onsets with the conjugate of the beats
+	Vector<std::complex<float>> product(size);
+	for (size_t k = 0; k < size; ++k)
+	{
+		const std::complex<float> x = signal[k];
+		const std::complex<float> y = signal[(size - k) % size];
+		const float onsetsRe = (x.real() + y.real()) * 0.5f, onsetsIm = (x.imag() - y.imag()) * 0.5f;
+		const float beatsRe = (x.imag() + y.imag()) * 0.5f, beatsIm = (y.real() - x.real()) * 0.5f;
+		product[k] = std::complex<float>(onsetsRe * beatsRe + onsetsIm * beatsIm, onsetsIm * beatsRe - onsetsRe * beatsIm);
+	}
+
+	fft.Transform(product.data(), true);
+
+	m_correlation.resize(size);
+	for (size_t i = 0; i < size; ++i)
+		m_correlation[i] = product[i].real();
 }
 
-float OffsetComputer::GetOnsetScore(MapTime time)
+float OffsetComputer::GetCorrelation(MapTime offset) const
 {
-	time -= m_energyOffset;
-	if (time < 0 || time >= static_cast<MapTime>(m_onsetScore.size()))
-		return 0;
+	if (std::abs(offset) > m_maxLag || m_correlation.empty())
+		return 0.0f;
 
-	return Math::Clamp(100 * m_onsetScore[time], -100.0f, 100.0f);
+	if (offset < 0)
+		return m_correlation[m_correlation.size() + offset];
+	return m_correlation[offset];
 }
@@ -767,6 +767,7 @@ public:
 		m_mapDatabase->OnDatabaseUpdateDone.Add(this, &ChallengeSelect_Impl::m_onDatabaseUpdateDone);
 		m_mapDatabase->OnDatabaseUpdateProgress.Add(this, &ChallengeSelect_Impl::m_onDatabaseUpdateProgress);
 		m_mapDatabase->SetChartUpdateBehavior(g_gameConfig.GetBool(GameConfigKeys::TransferScoresOnChartUpdate));
+		m_mapDatabase->SetChartReadThreads(g_gameConfig.GetInt(GameConfigKeys::ChartReadThreads));
 		m_mapDatabase->FinishInit();
 
 		// Setup the map database
@@ -444,7 +444,7 @@ public:
 			return false;
 
 		// Load beatmap audio
-		if(!m_audioPlayback.Init(m_playback, m_chartRootPath, g_gameConfig.GetBool(GameConfigKeys::PrerenderEffects)))
+		if(!m_audioPlayback.Init(m_playback, m_chartRootPath, g_gameConfig.GetBool(GameConfigKeys::PrerenderEffects), m_chartIndex ? m_chartIndex->hash : String()))
 			return false;
 
 		m_songOffset = 0;
@@ -468,6 +468,18 @@ public:
 
 		m_lastMapTime = GetPlayStartTime();
 
+		// Only the start of the song needs its effects rendered before playing
+		int32 preRenderPercent = -1;
+		m_audioPlayback.WaitForPreRender(m_lastMapTime, [&](float progress)
+		{
+			int32 percent = (int32)(progress * 10.0f) * 10;
+			if (percent != preRenderPercent)
+			{
+				Logf("Pre-rendering effects: %d%%", Logger::Severity::Debug, percent);
+				preRenderPercent = percent;
+			}
+		});
+
 		// Load audio offset
 		m_globalOffset = g_gameConfig.GetInt(GameConfigKeys::GlobalOffset);
 		m_tempOffset = 0;
@@ -1994,7 +2006,39 @@ public:
 				m_globalOffset, m_songOffset, m_tempOffset, GetAudioOffset(), g_audio->audioLatency
 			), textPos, Color::Green).y;
 
+			AudioClockStats clockStats = g_audio->GetClockStats();
+			textPos.y += RenderText(Utility::Sprintf(
+				"Audio clock: latency=%.1fms jitter=%.2fms (max %.2fms) drift=%.0fppm resyncs=%d",
+				clockStats.latencyMs, clockStats.jitterMs, clockStats.maxJitterMs, clockStats.driftPpm, clockStats.numResyncs
+			), textPos, Color::Green).y;
+
+			const AudioMixerStats mixStats = g_audio->GetMixerStats();
+			const int64 minMargin = mixStats.minMarginMicroseconds;
+			textPos.y += RenderText(Utility::Sprintf(
+				"Mixer: block=%d worst block=%lluus worst margin=%lldus xruns=%llu",
+				mixStats.blockSize, mixStats.maxBlockMicroseconds, minMargin == INT64_MAX ? 0 : minMargin, mixStats.numXruns
+			), textPos, mixStats.numXruns > 0 ? Color::Red : Color::Green).y;
+
+			// Most expensive parts of the mix, as a share of the time spent in callbacks
+			for (const Vector<AudioCostStats>* costStats : { &mixStats.itemCosts, &mixStats.dspCosts })
+			{
+				String line = costStats == &mixStats.itemCosts ? "Audio items:" : "Audio DSPs:";
+				for (size_t i = 0; i < Math::Min<size_t>(costStats->size(), 3); i++)
+				{
+					const AudioCostStats& cost = (*costStats)[i];
+					line += Utility::Sprintf(" %s=%.0fus (max %.0fus, %.1f%%)",
+						cost.name, cost.averageMicroseconds, cost.maxMicroseconds, cost.percent);
+				}
+				textPos.y += RenderText(line, textPos, Color::Green).y;
+			}
+			textPos.y += RenderText(Utility::Sprintf(
+				"Audio locks: misses=%llu wait=%lluus (max %lluus) dropped records=%llu dropped dsp events=%llu",
+				mixStats.numLockMisses, mixStats.totalLockWaitMicroseconds, mixStats.maxLockWaitMicroseconds, mixStats.numDroppedRecords, mixStats.numDroppedDSPEvents
+			), textPos, mixStats.numLockMisses > 0 || mixStats.numDroppedDSPEvents > 0 ? Color::Yellow : Color::Green).y;
+
 			textPos.y += RenderText(Utility::Sprintf("Paused: %s, LastMapTime: %d", m_paused ? "Yes" : "No", m_lastMapTime), textPos, Color::Green).y;
+
+			textPos.y += RenderText(Utility::Sprintf("Audio memory: %.1f MB", (double)g_audio->GetPCMMemoryUsage() / (1024.0 * 1024.0)), textPos, Color::Green).y;
 		}
 
 		// Playback details
@@ -2166,7 +2210,8 @@ public:
 		float slamSize = object->points[1] - object->points[0];
 		float direction = Math::Sign(slamSize);
 		m_camera.AddCameraShake(slamSize);
-		m_slamSample->Play();
+		// Line the sound up with the chart instead of the frame the slam was processed in
+		m_audioPlayback.PlaySampleAt(m_slamSample.get(), object->time + GetAudioOffset());
 
 		if (object->spin.type != 0)
 		{
@@ -2249,7 +2294,7 @@ public:
 			if (m_fxSamples[st->sampleIndex])
 			{
 				m_fxSamples[st->sampleIndex]->SetVolume(st->sampleVolume * m_fxVolume * m_slamVolume);
-				m_fxSamples[st->sampleIndex]->Play();
+				m_audioPlayback.PlaySampleAt(m_fxSamples[st->sampleIndex].get(), st->time + GetAudioOffset());
 			}
 		}
 
@@ -2376,7 +2421,7 @@ public:
 			HoldObjectState* hold = (HoldObjectState*)object;
 			if(hold->effectType != EffectType::None)
 			{
-                m_audioPlayback.SetEffectEnabled(hold->index - 4, true);
+                m_audioPlayback.SetEffectEnabled(hold->index - 4, true, hold->time + GetAudioOffset());
             }
 		}
 	}
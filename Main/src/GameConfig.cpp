@@ -234,6 +234,13 @@ void GameConfig::InitDefaults()
 	Set(GameConfigKeys::WASAPI_Exclusive, false);
 	Set(GameConfigKeys::MuteUnfocused, false);
 	Set(GameConfigKeys::PrerenderEffects, false);
+	SetEnum<Enum_ResamplerQuality>(GameConfigKeys::ResamplerQuality, ResamplerQuality::Sinc);
+	Set(GameConfigKeys::StreamReadAhead, 500);
+	Set(GameConfigKeys::MixBlockSize, 0);
+	Set(GameConfigKeys::PcmCacheSize, 1024);
+	Set(GameConfigKeys::CompactAudio, false);
+	Set(GameConfigKeys::AudioLatencyCompensation, false);
+	Set(GameConfigKeys::AudioTelemetry, false);
 
 	Set(GameConfigKeys::CheckForUpdates, true);
 	Set(GameConfigKeys::OnlyRelease, true); // deprecated
@@ -263,6 +270,7 @@ void GameConfig::InitDefaults()
 	Set(GameConfigKeys::GameplaySettingsDialogLastTab, 0);
 	Set(GameConfigKeys::SettingsLastTab, 0);
 	Set(GameConfigKeys::TransferScoresOnChartUpdate, true);
+	Set(GameConfigKeys::ChartReadThreads, 0);
 	Set(GameConfigKeys::FastGUI, false);
 	Set(GameConfigKeys::SkinDevMode, false);
 
@@ -19,6 +19,7 @@ void GameplaySettingsDialog::InitTabs()
     if (m_songSelectScreen != nullptr)
     {
         offsetTab->settings.push_back(CreateButton("Compute Song Offset", [this](const auto&) { onPressComputeSongOffset.Call(); }));
+        offsetTab->settings.push_back(CreateButton("Compute All Song Offsets", [this](const auto&) { onPressComputeAllSongOffsets.Call(); }));
     }
 
     Tab speedTab = std::make_unique<TabData>();
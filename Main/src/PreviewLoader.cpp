@@ -0,0 +1,99 @@
+#include "stdafx.h"
+#include "PreviewLoader.hpp"
+#include "Application.hpp"
+#include <Audio/Audio.hpp>
+
+const uint32 PreviewLoader::defaultDuration = 15000;
+
+PreviewLoader::~PreviewLoader()
+{
+	Clear();
+}
+void PreviewLoader::Select(const PreviewParams& params)
+{
+	m_selected = params;
+	m_hasSelected = true;
+	m_Load(params);
+	m_Prune();
+}
+void PreviewLoader::Prefetch(const Vector<PreviewParams>& params)
+{
+	m_prefetch = params;
+	for (const PreviewParams& p : m_prefetch)
+	{
+		m_Load(p);
+	}
+	m_Prune();
+}
+void PreviewLoader::Clear()
+{
+	m_hasSelected = false;
+	m_prefetch.clear();
+	m_Prune();
+}
+void PreviewLoader::Update()
+{
+	if (!m_hasSelected)
+		return;
+
+	for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+	{
+		if (it->request->params != m_selected || !it->job->IsFinished())
+			continue;
+
+		// The stream is handed over, selecting this preview again loads it again
+		Ref<AudioStream> stream = it->request->stream;
+		m_entries.erase(it);
+		m_hasSelected = false;
+		OnLoaded.Call(m_selected, stream);
+		return;
+	}
+}
+void PreviewLoader::m_Load(const PreviewParams& params)
+{
+	for (const Entry& entry : m_entries)
+	{
+		if (entry.request->params == params)
+			return;
+	}
+
+	Ref<Request> request = Ref<Request>(new Request());
+	request->params = params;
+	Job job = JobBase::CreateLambda([request]() {
+		if (request->cancelled)
+			return false;
+
+		const PreviewParams& p = request->params;
+		const uint32 duration = p.duration > 0 ? p.duration : defaultDuration;
+		request->stream = AudioStream::CreateWindow(g_audio, p.filepath, (int32)p.offset, (int32)duration);
+		// Release the stream here if nobody wants it anymore
+		if (request->cancelled)
+			request->stream.reset();
+		return (bool)request->stream;
+	});
+	m_entries.Add({ request, job });
+	g_jobSheduler->Queue(job);
+}
+void PreviewLoader::m_Prune()
+{
+	for (auto it = m_entries.begin(); it != m_entries.end();)
+	{
+		const PreviewParams& params = it->request->params;
+		bool wanted = m_hasSelected && params == m_selected;
+		for (const PreviewParams& p : m_prefetch)
+		{
+			if (params == p)
+				wanted = true;
+		}
+
+		if (wanted)
+		{
+			++it;
+			continue;
+		}
+
+		// A job that already started decoding finishes on its own and drops the result
+		it->request->cancelled = true;
+		it = m_entries.erase(it);
+	}
+}
@@ -8,6 +8,8 @@
 #include "SkinConfig.hpp"
 #include "TransitionScreen.hpp"
 
+#include <Audio/Audio.hpp>
+
 static inline const char* GetKeyNameFromScancodeConfig(int scancode)
 {
 	return SDL_GetKeyName(SDL_GetKeyFromScancode(static_cast<SDL_Scancode>(scancode)));
@@ -500,6 +502,7 @@ protected:
 		m_songsPath.Render(m_nctx);
 
 		ToggleSetting(GameConfigKeys::TransferScoresOnChartUpdate, "When a chart is modified, do not reset the scores for the chart");
+		IntSetting(GameConfigKeys::ChartReadThreads, "Threads reading charts during a search (0 = automatic):", 0, 16);
 	}
 
 private:
@@ -730,6 +733,31 @@ protected:
 		ToggleSetting(GameConfigKeys::WASAPI_Exclusive, "WASAPI exclusive mode (requires restart)");
 #endif // _WIN32
 		ToggleSetting(GameConfigKeys::PrerenderEffects, "Pre-render song effects (experimental)");
+		if (EnumSetting<Enum_ResamplerQuality>(GameConfigKeys::ResamplerQuality, "Resampling quality:"))
+		{
+			g_audio->SetResamplerQuality(g_gameConfig.GetEnum<Enum_ResamplerQuality>(GameConfigKeys::ResamplerQuality));
+		}
+		if (IntSetting(GameConfigKeys::StreamReadAhead, "Streamed audio read-ahead (ms):", 50, 5000, 50))
+		{
+			g_audio->SetStreamReadAhead(g_gameConfig.GetInt(GameConfigKeys::StreamReadAhead));
+		}
+		if (IntSetting(GameConfigKeys::MixBlockSize, "Mixer block size (frames, 0 = follow the device):", 0, 4096, 64))
+		{
+			g_audio->SetMixBlockSize(g_gameConfig.GetInt(GameConfigKeys::MixBlockSize));
+		}
+		if (IntSetting(GameConfigKeys::PcmCacheSize, "Decoded audio cache size (MB, 0 = off):", 0, 16384, 128))
+		{
+			g_audio->SetPcmCache(Path::Absolute("cache/audio"), (uint64)g_gameConfig.GetInt(GameConfigKeys::PcmCacheSize) * 1024 * 1024);
+		}
+		if (ToggleSetting(GameConfigKeys::CompactAudio, "Store song audio as 16-bit (uses half the memory)"))
+		{
+			g_audio->SetCompactPcm(g_gameConfig.GetBool(GameConfigKeys::CompactAudio));
+		}
+		if (ToggleSetting(GameConfigKeys::AudioLatencyCompensation, "Compensate output latency (recalibrate the global offset after changing)"))
+		{
+			g_audio->SetLatencyCompensation(g_gameConfig.GetBool(GameConfigKeys::AudioLatencyCompensation));
+		}
+		ToggleSetting(GameConfigKeys::AudioTelemetry, "Write audio timing of each session to telemetry/ (for debugging stutters)");
 
 		SectionHeader("Lights");
 		const bool currentUseLight = g_gameConfig.GetBool(GameConfigKeys::UseLightPlugins);
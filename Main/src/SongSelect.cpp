@@ -21,8 +21,10 @@
 #include "SongSort.hpp"
 #include "DBUpdateScreen.hpp"
 #include "PreviewPlayer.hpp"
+#include "PreviewLoader.hpp"
 #include "ItemSelectionWheel.hpp"
 #include "Audio/OffsetComputer.hpp"
+#include "Audio/OffsetBatch.hpp"
 #include "Search.hpp"
 
 /*
@@ -932,6 +934,7 @@ class SongSelect_Impl : public SongSelect
 {
 private:
 	PreviewParams m_previewParams;
+	PreviewLoader m_previewLoader;
 
 	Timer m_dbUpdateTimer;
 	MapDatabase* m_mapDatabase;
@@ -975,6 +978,9 @@ private:
 
 	DBUpdateScreen* m_dbUpdateScreen = nullptr;
 
+	// Computes the offsets of all charts in the background
+	Ref<OffsetBatch> m_offsetBatch;
+
 public:
 	SongSelect_Impl() : m_settDiag(this) {}
 
@@ -990,6 +996,7 @@ public:
 		m_mapDatabase->OnDatabaseUpdateDone.Add(this, &SongSelect_Impl::m_onDatabaseUpdateDone);
 		m_mapDatabase->OnDatabaseUpdateProgress.Add(this, &SongSelect_Impl::m_onDatabaseUpdateProgress);
 		m_mapDatabase->SetChartUpdateBehavior(g_gameConfig.GetBool(GameConfigKeys::TransferScoresOnChartUpdate));
+		m_mapDatabase->SetChartReadThreads(g_gameConfig.GetInt(GameConfigKeys::ChartReadThreads));
 		m_mapDatabase->FinishInit();
 
 		// Setup the map database
@@ -1056,6 +1063,14 @@ public:
 		m_selectionWheel->OnItemsChanged.Add(m_filterSelection.get(), &FilterSelection::OnSongsChanged);
 		m_mapDatabase->StartSearching();
 
+		// Only the first song select picks up the flag
+		static bool computeOffsetsFlag = g_application->GetAppCommandLine().Contains("-computeoffsets");
+		if (computeOffsetsFlag)
+		{
+			computeOffsetsFlag = false;
+			m_StartOffsetBatch();
+		}
+
 		m_filterSelection->SetFiltersByIndex(g_gameConfig.GetInt(GameConfigKeys::LevelFilter), g_gameConfig.GetInt(GameConfigKeys::FolderFilter));
 
 		//sort selection
@@ -1067,6 +1082,7 @@ public:
 
 		m_selectionWheel->OnFolderSelected.Add(this, &SongSelect_Impl::OnFolderSelected);
 		m_selectionWheel->OnChartSelected.Add(this, &SongSelect_Impl::OnChartSelected);
+		m_previewLoader.OnLoaded.Add(this, &SongSelect_Impl::m_onPreviewLoaded);
 
 		m_searchInput = Ref<TextInput>(new TextInput());
 		m_searchInput->OnTextChanged.Add(this, &SongSelect_Impl::OnSearchTermChanged);
@@ -1178,6 +1194,10 @@ public:
 			m_previewPlayer.Restore();
 		});
 
+		m_settDiag.onPressComputeAllSongOffsets.AddLambda([this]() {
+			m_StartOffsetBatch();
+		});
+
 		if (m_hasCollDiag)
 		{
 			m_collDiag.OnCompletion.Add(this, &SongSelect_Impl::m_OnSongAddedToCollection);
@@ -1192,6 +1212,9 @@ public:
 	}
 	~SongSelect_Impl()
 	{
+		// Writes the offsets that are already computed
+		m_offsetBatch.reset();
+
 		// Clear callbacks
 		if (m_mapDatabase)
 		{
@@ -1207,20 +1230,33 @@ public:
 			g_application->DisposeLua(m_lua);
 	}
 
+	void m_StartOffsetBatch()
+	{
+		if (m_offsetBatch)
+			return;
+
+		m_offsetBatch = Ref<OffsetBatch>(new OffsetBatch(m_mapDatabase));
+		m_offsetBatch->Start(g_jobSheduler);
+	}
+
 	void m_OnSongAddedToCollection()
 	{
 		m_filterSelection->UpdateFilters();
 		OnSearchTermChanged(m_searchInput->input);
 	}
 
-	void m_updatePreview(ChartIndex *diff, bool mapChanged)
+	static PreviewParams m_getPreviewParams(const ChartIndex *diff)
 	{
 		String mapRootPath = diff->path.substr(0, diff->path.find_last_of(Path::sep));
-
-		// Set current preview audio
 		String audioPath = mapRootPath + Path::sep + diff->preview_file;
 
-		PreviewParams params = {audioPath, static_cast<uint32>(diff->preview_offset), static_cast<uint32>(diff->preview_length)};
+		return {audioPath, static_cast<uint32>(diff->preview_offset), static_cast<uint32>(diff->preview_length)};
+	}
+
+	void m_updatePreview(ChartIndex *diff, bool mapChanged)
+	{
+		// Set current preview audio
+		PreviewParams params = m_getPreviewParams(diff);
 
 		/* A lot of pre-effected charts use different audio files for each difficulty; these
 		 * files differ only in their effects, so the preview offset and duration remain the
@@ -1234,26 +1270,44 @@ public:
 
 		if (newPreview)
 		{
-			Ref<AudioStream> previewAudio = g_audio->CreateStream(audioPath);
-			if (previewAudio)
-			{
-				previewAudio->SetPosition(diff->preview_offset);
+			// Handed to the preview player by m_onPreviewLoaded once it is decoded
+			m_previewLoader.Select(params);
+			m_previewParams = params;
+		}
 
-				m_previewPlayer.FadeTo(previewAudio);
+		if (mapChanged)
+			m_prefetchPreviews();
+	}
 
-				m_previewParams = params;
-			}
-			else
-			{
-				params = {"", 0, 0};
+	// Starts loading the previews of the songs next to the selection
+	void m_prefetchPreviews()
+	{
+		Vector<PreviewParams> prefetch;
+		const int32 diffIndex = m_selectionWheel->GetSelectedDifficultyIndex();
+		for (int32 offset : { 1, -1 })
+		{
+			FolderIndex *folder = m_selectionWheel->GetSelectionAt(offset);
+			if (!folder || folder->charts.empty())
+				continue;
 
-				Logf("Failed to load preview audio from [%s]", Logger::Severity::Warning, audioPath);
-				if (m_previewParams != params)
-					m_previewPlayer.FadeTo(Ref<AudioStream>());
-			}
+			const ChartIndex *diff = folder->charts[Math::Clamp(diffIndex, 0, (int32)folder->charts.size() - 1)];
+			prefetch.Add(m_getPreviewParams(diff));
+		}
+		m_previewLoader.Prefetch(prefetch);
+	}
 
-			m_previewParams = params;
+	void m_onPreviewLoaded(const PreviewParams &params, Ref<AudioStream> previewAudio)
+	{
+		if (previewAudio)
+		{
+			// The stream only holds the preview window, so loop it
+			m_previewPlayer.FadeTo(previewAudio, 0);
+			return;
 		}
+
+		Logf("Failed to load preview audio from [%s]", Logger::Severity::Warning, params.filepath);
+		m_previewParams = {"", 0, 0};
+		m_previewPlayer.FadeTo(Ref<AudioStream>());
 	}
 
 	// When a map is selected in the song wheel
@@ -1593,6 +1647,7 @@ public:
 			{
 				m_previewParams = {"", 0, 0};
 
+				m_previewLoader.Clear();
 				m_previewPlayer.FadeTo(Ref<AudioStream>());
 				m_previewPlayer.StopCurrent();
 
@@ -1658,6 +1713,13 @@ public:
 		{
 			m_mapDatabase->Update();
 			m_dbUpdateTimer.Restart();
+
+			if (m_offsetBatch)
+			{
+				m_offsetBatch->Update();
+				if (m_offsetBatch->IsFinished())
+					m_offsetBatch.reset();
+			}
 		}
 
 		// Tick navigation
@@ -1666,6 +1728,7 @@ public:
 			TickNavigation(deltaTime);
 
 
+			m_previewLoader.Update();
 			m_previewPlayer.Update(deltaTime);
 			m_searchInput->Tick();
 			m_selectionWheel->SetSearchFieldLua(m_searchInput);
@@ -1804,6 +1867,8 @@ public:
 		m_suspended = true;
 		m_previewPlayer.Pause();
 		m_mapDatabase->PauseSearching();
+		if (m_offsetBatch)
+			m_offsetBatch->Pause();
 		if (m_lockMouse)
 			m_lockMouse.reset();
 	}
@@ -1817,6 +1882,8 @@ public:
 		m_mapDatabase->Update(); //flush pending db changes before setting lua tables
 		m_selectionWheel->ResetLuaTables();
 		m_mapDatabase->ResumeSearching();
+		if (m_offsetBatch)
+			m_offsetBatch->Resume();
 		if (g_gameConfig.GetBool(GameConfigKeys::EventMode))
 		{
 			g_gameConfig.SetEnum<Enum_SpeedMods>(GameConfigKeys::SpeedMod, SpeedMods::MMod);
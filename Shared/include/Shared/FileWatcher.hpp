@@ -0,0 +1,58 @@
+#pragma once
+#include "Shared/Unique.hpp"
+#include "Shared/String.hpp"
+#include "Shared/Vector.hpp"
+#include "Shared/Map.hpp"
+#include "Shared/Set.hpp"
+#include "Shared/Timer.hpp"
+
+/*
+	Watches folders and their subfolders for changes to files with certain extensions
+	uses inotify on Linux, other platforms or folders that can't be watched are polled by scanning them, which is slow for large folders so it is done rarely
+	files behind symlinks are reported by their resolved path, the same path a scan with Files::ScanFilesRecursive finds them at
+*/
+class FileWatcher : Unique
+{
+public:
+	// Only files with one of extFilters as extension are reported, given without leading dot
+	FileWatcher(const Vector<String>& extFilters);
+	~FileWatcher();
+
+	// Starts watching folder and everything in it
+	void AddFolder(const String& folder);
+
+	// Waits up to timeout milliseconds for changes
+	//	returns the paths of files that were created, written, moved or removed since the last call
+	//	a file that is reported might not exist anymore
+	Set<String> Wait(uint32 timeout);
+
+	// Whether folders are scanned every pollInterval milliseconds instead of being watched
+	bool IsPolling() const;
+	uint32 pollInterval = 60000;
+
+private:
+	friend class FileWatcher_Impl;
+
+	bool m_MatchesFilter(const String& path) const;
+	void m_StartPolling();
+	void m_Poll(Set<String>& changes);
+	// Stops reporting the files in folder and its subfolders, they are added to changes
+	void m_ForgetFiles(const String& folder, Set<String>& changes);
+
+	// Implemented per platform, returning false falls back to polling
+	bool m_StartWatching();
+	void m_StopWatching();
+	bool m_WatchFolder(const String& folder);
+	bool m_WaitForChanges(uint32 timeout, Set<String>& changes);
+
+	Vector<String> m_extFilters;
+	Vector<String> m_folders;
+	// Matching files in the watched folders with their last write time
+	Map<String, uint64> m_files;
+	Timer m_pollTimer;
+
+	bool m_polling = false;
+
+	// Watches of the platform, null when polling
+	class FileWatcher_Impl* m_impl = nullptr;
+};
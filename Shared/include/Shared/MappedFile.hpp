@@ -0,0 +1,25 @@
+#pragma once
+#include "Shared/Unique.hpp"
+#include "Shared/String.hpp"
+
+/*
+	Read-only view of a whole file mapped into memory
+*/
+class MappedFile : Unique
+{
+private:
+	class MappedFile_Impl* m_impl = nullptr;
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Maps the file at path
+	// with copyOnWrite set the mapped memory may be modified without affecting the file on disk
+	bool Open(const String& path, bool copyOnWrite = false);
+	void Close();
+	bool IsOpen() const { return m_impl != nullptr; }
+
+	uint8* GetData();
+	const uint8* GetData() const;
+	size_t GetSize() const;
+};
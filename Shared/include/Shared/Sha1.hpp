@@ -0,0 +1,29 @@
+#pragma once
+#include "Shared/String.hpp"
+#include "Shared/Vector.hpp"
+
+/*
+	SHA-1 hashing of whole buffers
+	Multiple implementations exist (scalar, SHA extensions on x86, ARMv8 crypto), the best one supported by the cpu is picked at startup
+*/
+class Sha1
+{
+public:
+	struct Implementation
+	{
+		// Name of the implementation
+		const char* name;
+		// Updates state with numBlocks 64 byte blocks
+		void (*Compress)(uint32* state, const uint8* data, size_t numBlocks);
+	};
+
+	// Hashes size bytes of data into digest
+	static void Hash(const void* data, size_t size, uint32 digest[5], const Implementation& impl = Get());
+	// Hash as 40 lowercase hex characters, the same format the map database stores
+	static String HashHex(const void* data, size_t size);
+
+	// Implementation selected for the current cpu
+	static const Implementation& Get();
+	// All implementations supported by the current cpu, the scalar fallback comes first
+	static Vector<const Implementation*> GetSupported();
+};
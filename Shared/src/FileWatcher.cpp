@@ -0,0 +1,112 @@
+#include "stdafx.h"
+#include "FileWatcher.hpp"
+#include "Files.hpp"
+#include "Path.hpp"
+#include "Math.hpp"
+#include <thread>
+
+FileWatcher::FileWatcher(const Vector<String>& extFilters)
+{
+	for (String ext : extFilters)
+	{
+		ext.TrimFront('.');
+		m_extFilters.push_back(ext);
+	}
+
+	if (!m_StartWatching())
+		m_polling = true;
+}
+FileWatcher::~FileWatcher()
+{
+	m_StopWatching();
+}
+void FileWatcher::AddFolder(const String& folder)
+{
+	String normalized = Path::Normalize(folder);
+	if (m_folders.Contains(normalized))
+		return;
+	m_folders.push_back(normalized);
+
+	if (IsPolling())
+	{
+		Set<String> changes;
+		m_Poll(changes);
+		return;
+	}
+	if (!m_WatchFolder(normalized))
+		m_StartPolling();
+}
+Set<String> FileWatcher::Wait(uint32 timeout)
+{
+	Set<String> changes;
+	if (IsPolling())
+	{
+		uint64 elapsed = (uint64)m_pollTimer.Milliseconds();
+		if (elapsed < pollInterval)
+			std::this_thread::sleep_for(std::chrono::milliseconds(Math::Min<uint64>(timeout, pollInterval - elapsed)));
+		if ((uint64)m_pollTimer.Milliseconds() >= pollInterval)
+			m_Poll(changes);
+		return changes;
+	}
+
+	if (!m_WaitForChanges(timeout, changes))
+		m_StartPolling();
+	return changes;
+}
+bool FileWatcher::IsPolling() const
+{
+	return m_polling;
+}
+bool FileWatcher::m_MatchesFilter(const String& path) const
+{
+	return m_extFilters.Contains(Path::GetExtension(path));
+}
+void FileWatcher::m_StartPolling()
+{
+	m_StopWatching();
+	m_files.clear();
+	m_polling = true;
+
+	// Remember what is there now so only later changes are reported
+	Set<String> changes;
+	m_Poll(changes);
+}
+void FileWatcher::m_Poll(Set<String>& changes)
+{
+	m_pollTimer.Restart();
+
+	Map<String, uint64> files;
+	for (const String& folder : m_folders)
+	{
+		Map<String, Vector<FileInfo>> found = Files::ScanFilesRecursive(folder, m_extFilters);
+		for (auto& ext : found)
+		{
+			for (FileInfo& info : ext.second)
+				files.Add(info.fullPath, info.lastWriteTime);
+		}
+	}
+
+	for (auto& file : files)
+	{
+		uint64* lwt = m_files.Find(file.first);
+		if (!lwt || *lwt != file.second)
+			changes.Add(file.first);
+	}
+	for (auto& file : m_files)
+	{
+		if (!files.Contains(file.first))
+			changes.Add(file.first);
+	}
+	m_files = std::move(files);
+}
+void FileWatcher::m_ForgetFiles(const String& folder, Set<String>& changes)
+{
+	// Files of the folder are sorted right after its prefix
+	const String prefix = folder + Path::sep;
+	auto it = m_files.lower_bound(prefix);
+	while (it != m_files.end() && it->first.compare(0, prefix.size(), prefix) == 0)
+	{
+		changes.Add(it->first);
+		it = m_files.erase(it);
+	}
+}
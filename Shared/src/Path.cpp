@@ -133,7 +133,10 @@ String Path::GetModuleName()
 }
 bool Path::CreateDirRecursive(String path)
 {
+	// Keep the root of absolute paths
 	String path1;
+	if(!path.empty() && path[0] == Path::sep)
+		path1 += Path::sep;
 	while(!path.empty())
 	{
 		String segment = path;
@@ -151,7 +154,7 @@ bool Path::CreateDirRecursive(String path)
 			path.clear();
 		}
 
-		if(!path1.empty())
+		if(!path1.empty() && path1.back() != Path::sep)
 			path1 += Path::sep;
 		path1 += segment;
 
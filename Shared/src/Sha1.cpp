@@ -0,0 +1,295 @@
+#include "stdafx.h"
+#include "Sha1.hpp"
+#include "Utility.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SHA1_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// Only used when the compiler targets a cpu that has the crypto extension, which includes all arm64 macs
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+#define SHA1_ARM 1
+#include <arm_neon.h>
+#endif
+
+// Allows compiling functions for instruction sets that are not enabled for the whole project
+#if defined(__GNUC__) || defined(__clang__)
+#define SHA1_TARGET(x) __attribute__((target(x)))
+#else
+#define SHA1_TARGET(x)
+#endif
+
+static const uint32 initialState[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+static const uint32 roundConstants[4] = { 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
+
+static inline uint32 LeftRotate(uint32 value, uint32 count)
+{
+	return (value << count) | (value >> (32 - count));
+}
+
+/*
+	Scalar fallback
+*/
+static void Compress_Scalar(uint32* state, const uint8* data, size_t numBlocks)
+{
+	for (size_t block = 0; block < numBlocks; block++, data += 64)
+	{
+		uint32 w[80];
+		for (uint32 i = 0; i < 16; i++)
+			w[i] = (uint32)data[i * 4] << 24 | (uint32)data[i * 4 + 1] << 16 | (uint32)data[i * 4 + 2] << 8 | (uint32)data[i * 4 + 3];
+		for (uint32 i = 16; i < 80; i++)
+			w[i] = LeftRotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+		uint32 a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+		for (uint32 i = 0; i < 80; i++)
+		{
+			uint32 f;
+			if (i < 20)
+				f = (b & c) | (~b & d);
+			else if (i < 40)
+				f = b ^ c ^ d;
+			else if (i < 60)
+				f = (b & c) | (b & d) | (c & d);
+			else
+				f = b ^ c ^ d;
+			const uint32 temp = LeftRotate(a, 5) + f + e + roundConstants[i / 20] + w[i];
+			e = d;
+			d = c;
+			c = LeftRotate(b, 30);
+			b = a;
+			a = temp;
+		}
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+	}
+}
+
+#if SHA1_X86
+/*
+	SHA extensions, 4 rounds per instruction
+*/
+// 4 rounds using the message words in cur, while computing the words of the following rounds
+#define SHA1_NI_ROUNDS(f, eIn, eOut, cur, next, prev, prev2) \
+	eIn = _mm_sha1nexte_epu32(eIn, cur); \
+	eOut = abcd; \
+	next = _mm_sha1msg2_epu32(next, cur); \
+	abcd = _mm_sha1rnds4_epu32(abcd, eIn, f); \
+	prev = _mm_sha1msg1_epu32(prev, cur); \
+	prev2 = _mm_xor_si128(prev2, cur);
+
+SHA1_TARGET("sha,sse4.1,ssse3")
+static void Compress_SHANI(uint32* state, const uint8* data, size_t numBlocks)
+{
+	// Message words are big endian
+	const __m128i byteSwap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+	__m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+	__m128i e1;
+	__m128i msg0, msg1, msg2, msg3;
+
+	for (size_t block = 0; block < numBlocks; block++, data += 64)
+	{
+		const __m128i abcdStart = abcd;
+		const __m128i eStart = e0;
+
+		// Rounds 0-15 load the message
+		msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), byteSwap);
+		e0 = _mm_add_epi32(e0, msg0);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+		msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), byteSwap);
+		e1 = _mm_sha1nexte_epu32(e1, msg1);
+		e0 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+		msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+		msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), byteSwap);
+		e0 = _mm_sha1nexte_epu32(e0, msg2);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+		msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+		msg0 = _mm_xor_si128(msg0, msg2);
+
+		msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), byteSwap);
+		SHA1_NI_ROUNDS(0, e1, e0, msg3, msg0, msg2, msg1);
+
+		// Rounds 16-67
+		SHA1_NI_ROUNDS(0, e0, e1, msg0, msg1, msg3, msg2);
+		SHA1_NI_ROUNDS(1, e1, e0, msg1, msg2, msg0, msg3);
+		SHA1_NI_ROUNDS(1, e0, e1, msg2, msg3, msg1, msg0);
+		SHA1_NI_ROUNDS(1, e1, e0, msg3, msg0, msg2, msg1);
+		SHA1_NI_ROUNDS(1, e0, e1, msg0, msg1, msg3, msg2);
+		SHA1_NI_ROUNDS(1, e1, e0, msg1, msg2, msg0, msg3);
+		SHA1_NI_ROUNDS(2, e0, e1, msg2, msg3, msg1, msg0);
+		SHA1_NI_ROUNDS(2, e1, e0, msg3, msg0, msg2, msg1);
+		SHA1_NI_ROUNDS(2, e0, e1, msg0, msg1, msg3, msg2);
+		SHA1_NI_ROUNDS(2, e1, e0, msg1, msg2, msg0, msg3);
+		SHA1_NI_ROUNDS(2, e0, e1, msg2, msg3, msg1, msg0);
+		SHA1_NI_ROUNDS(3, e1, e0, msg3, msg0, msg2, msg1);
+		SHA1_NI_ROUNDS(3, e0, e1, msg0, msg1, msg3, msg2);
+
+		// Rounds 68-79 only finish the words that are left
+		e1 = _mm_sha1nexte_epu32(e1, msg1);
+		e0 = abcd;
+		msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+		msg3 = _mm_xor_si128(msg3, msg1);
+
+		e0 = _mm_sha1nexte_epu32(e0, msg2);
+		e1 = abcd;
+		msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+		e1 = _mm_sha1nexte_epu32(e1, msg3);
+		e0 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+		e0 = _mm_sha1nexte_epu32(e0, eStart);
+		abcd = _mm_add_epi32(abcd, abcdStart);
+	}
+
+	_mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+	state[4] = (uint32)_mm_extract_epi32(e0, 3);
+}
+#undef SHA1_NI_ROUNDS
+
+static bool CpuSupportsSHA()
+{
+	// The SHA instructions are used together with SSSE3 and SSE4.1 ones
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	const bool ssse3 = (info[2] & (1 << 9)) != 0;
+	const bool sse41 = (info[2] & (1 << 19)) != 0;
+	__cpuidex(info, 7, 0);
+	return ssse3 && sse41 && (info[1] & (1 << 29)) != 0;
+#else
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	const bool ssse3 = (ecx & (1 << 9)) != 0;
+	const bool sse41 = (ecx & (1 << 19)) != 0;
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return false;
+	return ssse3 && sse41 && (ebx & (1 << 29)) != 0;
+#endif
+}
+#endif
+
+#if SHA1_ARM
+/*
+	ARMv8 crypto extension, 4 rounds per instruction
+*/
+static void Compress_ARMv8(uint32* state, const uint8* data, size_t numBlocks)
+{
+	uint32x4_t abcd = vld1q_u32(state);
+	uint32 e = state[4];
+
+	for (size_t block = 0; block < numBlocks; block++, data += 64)
+	{
+		const uint32x4_t abcdStart = abcd;
+		const uint32 eStart = e;
+
+		// Message words are big endian
+		uint32x4_t msg[4];
+		for (uint32 i = 0; i < 4; i++)
+			msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+
+		// Each group of 4 rounds also adds the constants for the group after the next one and computes the words of a later group
+		uint32x4_t wk[2] = { vaddq_u32(msg[0], vdupq_n_u32(roundConstants[0])), vaddq_u32(msg[1], vdupq_n_u32(roundConstants[0])) };
+		uint32 eGroup[2] = { e, 0 };
+		for (uint32 g = 0; g < 20; g++)
+		{
+			eGroup[(g + 1) % 2] = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+			if (g < 5)
+				abcd = vsha1cq_u32(abcd, eGroup[g % 2], wk[g % 2]);
+			else if (g < 10 || g >= 15)
+				abcd = vsha1pq_u32(abcd, eGroup[g % 2], wk[g % 2]);
+			else
+				abcd = vsha1mq_u32(abcd, eGroup[g % 2], wk[g % 2]);
+
+			if (g + 2 < 20)
+				wk[g % 2] = vaddq_u32(msg[(g + 2) % 4], vdupq_n_u32(roundConstants[(g + 2) / 5]));
+			if (g >= 1 && g <= 16)
+				msg[(g + 3) % 4] = vsha1su1q_u32(msg[(g + 3) % 4], msg[(g + 2) % 4]);
+			if (g <= 15)
+				msg[g % 4] = vsha1su0q_u32(msg[g % 4], msg[(g + 1) % 4], msg[(g + 2) % 4]);
+		}
+
+		e = eGroup[0] + eStart;
+		abcd = vaddq_u32(abcd, abcdStart);
+	}
+
+	vst1q_u32(state, abcd);
+	state[4] = e;
+}
+#endif
+
+static const Sha1::Implementation scalarImplementation = { "Scalar", &Compress_Scalar };
+#if SHA1_X86
+static const Sha1::Implementation shaniImplementation = { "SHA-NI", &Compress_SHANI };
+#endif
+#if SHA1_ARM
+static const Sha1::Implementation armv8Implementation = { "ARMv8", &Compress_ARMv8 };
+#endif
+
+void Sha1::Hash(const void* data, size_t size, uint32 digest[5], const Implementation& impl /*= Get()*/)
+{
+	uint32 state[5];
+	memcpy(state, initialState, sizeof(state));
+
+	const uint8* bytes = (const uint8*)data;
+	const size_t numBlocks = size / 64;
+	impl.Compress(state, bytes, numBlocks);
+
+	// Padding and the length in bits go into the last one or two blocks
+	uint8 tail[128] = { 0 };
+	const size_t remaining = size - numBlocks * 64;
+	memcpy(tail, bytes + numBlocks * 64, remaining);
+	tail[remaining] = 0x80;
+	const size_t tailSize = remaining < 56 ? 64 : 128;
+	const uint64 bitCount = (uint64)size * 8;
+	for (uint32 i = 0; i < 8; i++)
+		tail[tailSize - 1 - i] = (uint8)(bitCount >> (i * 8));
+	impl.Compress(state, tail, tailSize / 64);
+
+	memcpy(digest, state, sizeof(state));
+}
+String Sha1::HashHex(const void* data, size_t size)
+{
+	uint32 digest[5];
+	Hash(data, size, digest);
+	return Utility::Sprintf("%08x%08x%08x%08x%08x", digest[0], digest[1], digest[2], digest[3], digest[4]);
+}
+const Sha1::Implementation& Sha1::Get()
+{
+	// The last supported implementation is the fastest one
+	static const Implementation* selected = GetSupported().back();
+	return *selected;
+}
+Vector<const Sha1::Implementation*> Sha1::GetSupported()
+{
+	Vector<const Implementation*> ret;
+	ret.Add(&scalarImplementation);
+#if SHA1_X86
+	if (CpuSupportsSHA())
+		ret.Add(&shaniImplementation);
+#endif
+#if SHA1_ARM
+	ret.Add(&armv8Implementation);
+#endif
+	return ret;
+}
@@ -0,0 +1,296 @@
+#include "stdafx.h"
+#include "FileWatcher.hpp"
+#include "Path.hpp"
+#include "Log.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+static const uint32 watchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR;
+
+/*
+	inotify implementation, other Unix platforms poll
+*/
+class FileWatcher_Impl
+{
+public:
+	FileWatcher_Impl(FileWatcher& watcher, int inotify) : watcher(watcher), inotify(inotify)
+	{
+	}
+	~FileWatcher_Impl()
+	{
+		close(inotify);
+	}
+
+	// Adds watches for folder and its subfolders, matching files in them are added to changes if it isn't null
+	//	returns false when out of watches
+	bool Watch(const String& folder, Set<String>* changes)
+	{
+		// Watch the folder before reading it so files added in between are not missed
+		int watch = inotify_add_watch(inotify, *folder, watchMask);
+		if (watch < 0)
+		{
+			if (errno == ENOSPC)
+			{
+				Logf("Out of inotify watches while watching \"%s\", falling back to polling", Logger::Severity::Warning, folder);
+				return false;
+			}
+			return true;
+		}
+		// Watching the same folder again returns the same watch, this also stops loops of symlinked folders
+		if (watches.Contains(watch))
+			return true;
+		watches[watch] = folder;
+
+		DIR* dir = opendir(*folder);
+		if (dir == nullptr)
+			return true;
+		bool result = true;
+		dirent* ent;
+		while (result && (ent = readdir(dir)))
+		{
+			if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+				continue;
+			String path = folder + Path::sep + ent->d_name;
+			const String name = ent->d_name;
+
+			bool isDir = ent->d_type == DT_DIR;
+			if (ent->d_type == DT_UNKNOWN || ent->d_type == DT_LNK)
+			{
+				struct stat buffer;
+				if (stat(*path, &buffer) != 0)
+					continue;
+				isDir = S_ISDIR(buffer.st_mode);
+			}
+			// Links are followed and resolved like the scanner does
+			if (ent->d_type == DT_LNK)
+				path = ResolveLink(path);
+
+			if (isDir)
+			{
+				result = Watch(path, changes);
+			}
+			else if (watcher.m_MatchesFilter(name))
+			{
+				watcher.m_files[path] = 0;
+				if (changes)
+					changes->Add(path);
+			}
+		}
+		closedir(dir);
+		return result;
+	}
+	// Stops watching folder and its subfolders, the files that were in them are added to changes
+	void Forget(const String& folder, Set<String>& changes)
+	{
+		const String prefix = folder + Path::sep;
+		for (auto it = watches.begin(); it != watches.end();)
+		{
+			if (it->second == folder || it->second.compare(0, prefix.size(), prefix) == 0)
+			{
+				inotify_rm_watch(inotify, it->first);
+				it = watches.erase(it);
+			}
+			else
+			{
+				it++;
+			}
+		}
+
+		// Links in the folder take what they point to with them
+		Vector<String> targets;
+		auto it = links.lower_bound(prefix);
+		while (it != links.end() && it->first.compare(0, prefix.size(), prefix) == 0)
+		{
+			targets.Add(it->second);
+			it = links.erase(it);
+		}
+		for (const String& target : targets)
+			ForgetLinkTarget(target, changes);
+
+		watcher.m_ForgetFiles(folder, changes);
+	}
+	// Reads the pending events, returns false when watching has to fall back to polling
+	bool ReadEvents(Set<String>& changes)
+	{
+		alignas(inotify_event) char buffer[4096];
+		while (true)
+		{
+			ssize_t length = read(inotify, buffer, sizeof(buffer));
+			if (length <= 0)
+				return true;
+
+			for (char* ptr = buffer; ptr < buffer + length;)
+			{
+				const inotify_event* event = (const inotify_event*)ptr;
+				ptr += sizeof(inotify_event) + event->len;
+
+				if (event->mask & IN_Q_OVERFLOW)
+				{
+					// Events were lost, compare everything with a scan instead
+					Logf("inotify queue overflowed, rescanning watched folders", Logger::Severity::Warning);
+					Map<String, uint64> files = std::move(watcher.m_files);
+					for (auto& watch : watches)
+						inotify_rm_watch(inotify, watch.first);
+					watches.clear();
+					links.clear();
+					watcher.m_files.clear();
+					for (auto& file : files)
+						changes.Add(file.first);
+					for (const String& folder : watcher.m_folders)
+					{
+						if (!Watch(folder, &changes))
+							return false;
+					}
+					continue;
+				}
+
+				String* folder = watches.Find(event->wd);
+				if (event->mask & IN_IGNORED)
+				{
+					watches.erase(event->wd);
+					continue;
+				}
+				if (!folder || event->len == 0)
+					continue;
+
+				String path = *folder + Path::sep + event->name;
+				if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+				{
+					String* target = links.Find(path);
+					if (target)
+					{
+						String resolved = *target;
+						links.erase(path);
+						ForgetLinkTarget(resolved, changes);
+					}
+					else if (event->mask & IN_ISDIR)
+					{
+						Forget(path, changes);
+					}
+					else if (watcher.m_MatchesFilter(path))
+					{
+						watcher.m_files.erase(path);
+						changes.Add(path);
+					}
+					continue;
+				}
+
+				// Links are resolved like the scanner does, the filter applies to the name of the link
+				const bool matches = watcher.m_MatchesFilter(path);
+				struct stat buffer;
+				const bool isLink = (event->mask & (IN_CREATE | IN_MOVED_TO)) && lstat(*path, &buffer) == 0 && S_ISLNK(buffer.st_mode);
+				if (isLink)
+				{
+					if (!Path::FileExists(path))
+						continue;
+					path = ResolveLink(path);
+				}
+
+				if ((event->mask & IN_ISDIR) || (isLink && Path::IsDirectory(path)))
+				{
+					if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && !Watch(path, &changes))
+						return false;
+				}
+				else if (matches)
+				{
+					// Created files are reported once they are closed after writing, links don't get written
+					if (isLink || (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)))
+					{
+						watcher.m_files[path] = 0;
+						changes.Add(path);
+					}
+				}
+			}
+		}
+	}
+
+	FileWatcher& watcher;
+	int inotify;
+	// Folder of each watch
+	Map<int, String> watches;
+	// Resolved path of each followed link
+	Map<String, String> links;
+
+private:
+	String ResolveLink(const String& path)
+	{
+		String resolved = Path::Normalize(path);
+		links[path] = resolved;
+		return resolved;
+	}
+	// Removes what a removed link pointed to, unless it is still reachable through another link or a watched folder
+	void ForgetLinkTarget(const String& target, Set<String>& changes)
+	{
+		for (auto& link : links)
+		{
+			if (link.second == target)
+				return;
+		}
+		for (const String& folder : watcher.m_folders)
+		{
+			if (target == folder || target.compare(0, folder.size() + 1, folder + Path::sep) == 0)
+				return;
+		}
+		if (watcher.m_files.Contains(target))
+		{
+			watcher.m_files.erase(target);
+			changes.Add(target);
+		}
+		else
+		{
+			Forget(target, changes);
+		}
+	}
+};
+
+bool FileWatcher::m_StartWatching()
+{
+	int inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify < 0)
+	{
+		Logf("inotify is not available (%s), falling back to polling", Logger::Severity::Warning, strerror(errno));
+		return false;
+	}
+	m_impl = new FileWatcher_Impl(*this, inotify);
+	return true;
+}
+void FileWatcher::m_StopWatching()
+{
+	delete m_impl;
+	m_impl = nullptr;
+}
+bool FileWatcher::m_WatchFolder(const String& folder)
+{
+	return m_impl->Watch(folder, nullptr);
+}
+bool FileWatcher::m_WaitForChanges(uint32 timeout, Set<String>& changes)
+{
+	pollfd fd = { m_impl->inotify, POLLIN, 0 };
+	if (poll(&fd, 1, (int)timeout) > 0)
+		return m_impl->ReadEvents(changes);
+	return true;
+}
+#else
+bool FileWatcher::m_StartWatching()
+{
+	return false;
+}
+void FileWatcher::m_StopWatching()
+{
+}
+bool FileWatcher::m_WatchFolder(const String& folder)
+{
+	return false;
+}
+bool FileWatcher::m_WaitForChanges(uint32 timeout, Set<String>& changes)
+{
+	return false;
+}
+#endif
@@ -2,12 +2,200 @@
 #include "Files.hpp"
 #include "Path.hpp"
 #include "Log.hpp"
-#include "List.hpp"
-#include "File.hpp"
+#include "Math.hpp"
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Number of threads that read folders at the same time during a recursive scan
+static const uint32 maxScanThreads = 4;
+
+static uint64 GetModificationTime(const struct stat& buffer)
+{
+#ifdef __APPLE__
+	return buffer.st_mtimespec.tv_sec * (uint64)1000000000L + buffer.st_mtimespec.tv_nsec;
+#else
+	return buffer.st_mtim.tv_sec * (uint64)1000000000L + buffer.st_mtim.tv_nsec;
+#endif
+}
+
+/*
+	Folders waiting to be read, shared by the threads of a scan
+*/
+class ScanQueue
+{
+public:
+	ScanQueue(bool* interrupt) : m_interrupt(interrupt)
+	{
+	}
+
+	void Push(Vector<String>& folders)
+	{
+		if (folders.empty())
+			return;
+		std::lock_guard<std::mutex> guard(m_lock);
+		for (String& folder : folders)
+			m_folders.push_back(std::move(folder));
+		folders.clear();
+		m_condition.notify_all();
+	}
+
+	// Takes the next folder, returns false when all folders have been read
+	bool Pop(String& folder)
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_condition.wait(guard, [this] { return !m_folders.empty() || m_numBusy == 0 || IsInterrupted(); });
+		if (m_folders.empty() || IsInterrupted())
+			return false;
+		folder = std::move(m_folders.back());
+		m_folders.pop_back();
+		m_numBusy++;
+		return true;
+	}
+
+	// Called after a folder returned by Pop is read and its subfolders are pushed
+	void Done()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if (--m_numBusy == 0)
+			m_condition.notify_all();
+	}
+
+	bool IsInterrupted() const
+	{
+		return m_interrupt && *m_interrupt;
+	}
+
+private:
+	std::mutex m_lock;
+	std::condition_variable m_condition;
+	Vector<String> m_folders;
+	// Threads that are reading a folder and may still add subfolders
+	uint32 m_numBusy = 0;
+	bool* m_interrupt;
+};
+
+/*
+	Reads folders from a ScanQueue, stat is only called for entries that end up in the results
+*/
+class FolderScanner
+{
+public:
+	FolderScanner(ScanQueue& queue, const Vector<String>& extFilters, const Vector<String>& fixedExts, bool filterByExtension, bool recurse)
+		: m_queue(queue), m_extFilters(extFilters), m_fixedExts(fixedExts), m_filterByExtension(filterByExtension), m_recurse(recurse)
+	{
+	}
+
+	void Run()
+	{
+		String folder;
+		while (m_queue.Pop(folder))
+		{
+			m_ScanFolder(folder);
+			m_queue.Push(m_subFolders);
+			m_queue.Done();
+		}
+	}
+
+	// Files found by this scanner, with the unmodified extension filter as key
+	Map<String, Vector<FileInfo>> results;
+
+private:
+	// Index of the extension filter name matches, -1 if none does
+	int32 m_MatchExtension(const char* name) const
+	{
+		const char* dot = strrchr(name, '.');
+		const char* ext = dot ? dot + 1 : "";
+		for (size_t i = 0; i < m_fixedExts.size(); i++)
+		{
+			if (m_fixedExts[i] == ext)
+				return (int32)i;
+		}
+		return -1;
+	}
+
+	void m_ScanFolder(const String& folder)
+	{
+		int folderFd = open(*folder, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (folderFd < 0)
+			return;
+		DIR* dir = fdopendir(folderFd);
+		if (dir == nullptr)
+		{
+			close(folderFd);
+			return;
+		}
+
+		dirent* ent;
+		while ((ent = readdir(dir)) && !m_queue.IsInterrupted())
+		{
+			const char* name = ent->d_name;
+			if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+				continue;
+
+			// Only entries without a known type need to be stat'ed to find folders
+			struct stat buffer;
+			bool hasStat = false;
+			bool isDir = ent->d_type == DT_DIR;
+			const bool isLink = ent->d_type == DT_LNK;
+			if (ent->d_type == DT_UNKNOWN || isLink)
+			{
+				if (fstatat(folderFd, name, &buffer, 0) != 0)
+					continue;
+				hasStat = true;
+				isDir = S_ISDIR(buffer.st_mode);
+			}
+
+			int32 extIndex = -1;
+			if (isDir)
+			{
+				if (!m_recurse && m_filterByExtension)
+					continue;
+			}
+			else if (m_filterByExtension)
+			{
+				extIndex = m_MatchExtension(name);
+				if (extIndex < 0)
+					continue;
+			}
+
+			FileInfo info;
+			// Children of a normalized folder are normalized, except for links which have to be resolved
+			info.fullPath = folder + Path::sep + name;
+			if (isLink)
+				info.fullPath = Path::Normalize(info.fullPath);
+
+			if (isDir && m_recurse)
+			{
+				// Visit sub-folder
+				m_subFolders.push_back(std::move(info.fullPath));
+				continue;
+			}
+
+			if (!hasStat && fstatat(folderFd, name, &buffer, 0) != 0)
+				continue;
+			info.lastWriteTime = GetModificationTime(buffer);
+			info.type = isDir ? FileType::Folder : FileType::Regular;
+			results[extIndex < 0 ? String() : m_extFilters[extIndex]].push_back(std::move(info));
+		}
+
+		// Also closes folderFd
+		closedir(dir);
+	}
+
+	ScanQueue& m_queue;
+	const Vector<String>& m_extFilters;
+	const Vector<String>& m_fixedExts;
+	bool m_filterByExtension;
+	bool m_recurse;
+	Vector<String> m_subFolders;
+};
 
 static Map<String, Vector<FileInfo>> _ScanFiles(const String& rootFolder, const Vector<String>& extFilters, bool recurse, bool* interrupt)
 {
@@ -33,92 +221,45 @@ static Map<String, Vector<FileInfo>> _ScanFiles(const String& rootFolder, const
 		return ret;
 	}
 
-	// List of paths to process, subfolders are getting added to this list
-	List<String> folderQueue;
-
-	// Add / to the end
-	folderQueue.AddBack(rootFolder);
-
 	// Either if we have no exts or no exts besides an empty string
 	bool filterByExtension = extFilters.size() != 0 && !(extFilters.size() == 1 && fixedExts[0].empty());
 	// Make sure the empty one is ready
 	if (!filterByExtension)
 		ret[""] = Vector<FileInfo>();
 
-	while(!folderQueue.empty() && (!interrupt || !*interrupt))
-	{
-		String searchPath = folderQueue.front();
-		folderQueue.pop_front();
+	ScanQueue queue(interrupt);
+	Vector<String> root = { Path::Normalize(rootFolder) };
+	queue.Push(root);
 
-		DIR* dir = opendir(*searchPath);
-		if(dir == nullptr)
-			continue;
+	// Folders are read in parallel, which mostly helps when they aren't cached yet
+	const uint32 numThreads = recurse ? Math::Clamp(std::thread::hardware_concurrency(), 1u, maxScanThreads) : 1;
+	Vector<FolderScanner> scanners;
+	scanners.reserve(numThreads);
+	for (uint32 i = 0; i < numThreads; i++)
+		scanners.emplace_back(queue, extFilters, fixedExts, filterByExtension, recurse);
 
-		// Open first entry
-		dirent* ent = readdir(dir);
-		if(ent)
+	Vector<std::thread> threads;
+	for (uint32 i = 1; i < numThreads; i++)
+		threads.emplace_back(&FolderScanner::Run, &scanners[i]);
+	scanners[0].Run();
+	for (std::thread& thread : threads)
+		thread.join();
+
+	for (FolderScanner& scanner : scanners)
+	{
+		for (auto& found : scanner.results)
 		{
-			// Keep scanning files in this folder
-			do
-			{
-                String filename = ent->d_name;
-
-                /// TODO: Ask linux why
-                if(filename == ".")
-                    continue;
-                if(filename == "..")
-                    continue;
-
-				FileInfo info;
-                info.fullPath = Path::Normalize(searchPath + Path::sep + filename);
-				info.lastWriteTime = File::GetLastWriteTime(info.fullPath); // linux doesn't provide this timestamp in the directory entry
-				info.type = FileType::Regular;
-				bool is_dir = (ent->d_type == DT_DIR);
-				if (ent->d_type == DT_UNKNOWN || ent->d_type == DT_LNK)
-				{
-					struct stat buffer;
-					stat(info.fullPath.c_str(), &buffer);
-					is_dir = S_ISDIR(buffer.st_mode);
-				}
-				if(is_dir)
-				{
-					if(recurse)
-					{
-						// Visit sub-folder
-						folderQueue.AddBack(info.fullPath);
-					}
-					else if(!filterByExtension)
-					{
-                        info.type = FileType::Folder;
-						ret[""].push_back(info);
-					}
-				}
-				else
-				{
-					// Check file
-					if(filterByExtension)
-					{
-						String ext = Path::GetExtension(info.fullPath);
-						for (int i = 0; i < extFilters.size(); i++)
-						{
-							const String& extFilter = fixedExts[i];
-							if (ext == extFilter)
-							{
-								const String& realExt = extFilters[i];
-								ret[realExt].push_back(info);
-								break;
-							}
-						}
-					}
-					else
-					{
-						ret[""].push_back(info);
-					}
-				}
-			} while((ent = readdir(dir)) && (!interrupt || !*interrupt));
+			Vector<FileInfo>& files = ret[found.first];
+			files.insert(files.end(), std::make_move_iterator(found.second.begin()), std::make_move_iterator(found.second.end()));
 		}
+	}
 
-		closedir(dir);
+	// Keep the results in the same order no matter which thread found them
+	for (auto& found : ret)
+	{
+		std::sort(found.second.begin(), found.second.end(), [](const FileInfo& l, const FileInfo& r) {
+			return l.fullPath < r.fullPath;
+		});
 	}
 
 	return move(ret);
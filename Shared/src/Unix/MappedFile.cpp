@@ -0,0 +1,86 @@
+#include "stdafx.h"
+#include "MappedFile.hpp"
+#include "Log.hpp"
+
+/*
+	Unix implementation
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+class MappedFile_Impl
+{
+public:
+	MappedFile_Impl(void* data, size_t size) : data((uint8*)data), size(size) {};
+	~MappedFile_Impl()
+	{
+		munmap(data, size);
+	}
+	uint8* data;
+	size_t size;
+};
+
+MappedFile::MappedFile()
+{
+}
+MappedFile::~MappedFile()
+{
+	Close();
+}
+bool MappedFile::Open(const String& path, bool copyOnWrite /*= false*/)
+{
+	Close();
+
+	int handle = open(*path, O_RDONLY);
+	if(handle == -1)
+	{
+		Logf("Failed to open file for mapping %s: %d", Logger::Severity::Warning, *path, errno);
+		return false;
+	}
+
+	struct stat sb;
+	if(fstat(handle, &sb) != 0 || sb.st_size == 0)
+	{
+		close(handle);
+		return false;
+	}
+
+	int prot = copyOnWrite ? (PROT_READ | PROT_WRITE) : PROT_READ;
+	void* data = mmap(nullptr, sb.st_size, prot, MAP_PRIVATE, handle, 0);
+	// The mapping stays valid after closing the file
+	close(handle);
+	if(data == MAP_FAILED)
+	{
+		Logf("Failed to map file %s: %d", Logger::Severity::Warning, *path, errno);
+		return false;
+	}
+
+	m_impl = new MappedFile_Impl(data, sb.st_size);
+	return true;
+}
+void MappedFile::Close()
+{
+	if(m_impl)
+	{
+		delete m_impl;
+		m_impl = nullptr;
+	}
+}
+uint8* MappedFile::GetData()
+{
+	assert(m_impl);
+	return m_impl->data;
+}
+const uint8* MappedFile::GetData() const
+{
+	assert(m_impl);
+	return m_impl->data;
+}
+size_t MappedFile::GetSize() const
+{
+	assert(m_impl);
+	return m_impl->size;
+}
@@ -0,0 +1,22 @@
+#include "stdafx.h"
+#include "FileWatcher.hpp"
+
+/*
+	Windows implementation
+	folders are polled until watching them with ReadDirectoryChangesW is tested
+*/
+bool FileWatcher::m_StartWatching()
+{
+	return false;
+}
+void FileWatcher::m_StopWatching()
+{
+}
+bool FileWatcher::m_WatchFolder(const String& folder)
+{
+	return false;
+}
+bool FileWatcher::m_WaitForChanges(uint32 timeout, Set<String>& changes)
+{
+	return false;
+}
@@ -0,0 +1,95 @@
+#include "stdafx.h"
+#include "MappedFile.hpp"
+#include "Log.hpp"
+
+/*
+	Windows implementation
+*/
+class MappedFile_Impl
+{
+public:
+	MappedFile_Impl(HANDLE mapping, void* data, size_t size) : mapping(mapping), data((uint8*)data), size(size) {};
+	~MappedFile_Impl()
+	{
+		UnmapViewOfFile(data);
+		CloseHandle(mapping);
+	}
+	HANDLE mapping;
+	uint8* data;
+	size_t size;
+};
+
+MappedFile::MappedFile()
+{
+}
+MappedFile::~MappedFile()
+{
+	Close();
+}
+bool MappedFile::Open(const String& path, bool copyOnWrite /*= false*/)
+{
+	Close();
+	WString wstringPath = Utility::ConvertToWString(path);
+	HANDLE h = CreateFileW(*wstringPath,
+		GENERIC_READ, // Desired Access
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		0, 0);
+	if(h == INVALID_HANDLE_VALUE)
+	{
+		Logf("Failed to open file for mapping %s: %s", Logger::Severity::Warning, *path, Utility::WindowsFormatMessage(GetLastError()));
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(h, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(h);
+		return false;
+	}
+
+	// PAGE_WRITECOPY allows private writes to the mapped pages
+	HANDLE mapping = CreateFileMappingW(h, nullptr, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+	// The mapping keeps the file open
+	CloseHandle(h);
+	if(!mapping)
+	{
+		Logf("Failed to map file %s: %s", Logger::Severity::Warning, *path, Utility::WindowsFormatMessage(GetLastError()));
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	if(!data)
+	{
+		Logf("Failed to map file %s: %s", Logger::Severity::Warning, *path, Utility::WindowsFormatMessage(GetLastError()));
+		CloseHandle(mapping);
+		return false;
+	}
+
+	m_impl = new MappedFile_Impl(mapping, data, (size_t)size.QuadPart);
+	return true;
+}
+void MappedFile::Close()
+{
+	if(m_impl)
+	{
+		delete m_impl;
+		m_impl = nullptr;
+	}
+}
+uint8* MappedFile::GetData()
+{
+	assert(m_impl);
+	return m_impl->data;
+}
+const uint8* MappedFile::GetData() const
+{
+	assert(m_impl);
+	return m_impl->data;
+}
+size_t MappedFile::GetSize() const
+{
+	assert(m_impl);
+	return m_impl->size;
+}
@@ -1,6 +1,13 @@
 #include "stdafx.h"
 #include <Audio/Audio.hpp>
 #include <Audio/DSP.hpp>
+#include <Audio/Audio_Impl.hpp>
+#include <Audio/FileAudioOutput.hpp>
+#include <Audio/DSPPreRenderer.hpp>
+#include <Audio/FFT.hpp>
+#include <Shared/FileStream.hpp>
+#include <Shared/TextStream.hpp>
+#include <Shared/Files.hpp>
 #include <float.h>
 #include "TestMusicPlayer.hpp"
 
@@ -297,3 +304,1042 @@ Test("Audio.Music.Flanger")
 	mp.Init(testSongPath, testSongOffset);
 	mp.Run();
 }
+
+Test("Audio.StereoBQF")
+{
+	// Should match filtering each channel separately with a scalar BQF
+	Vector<float> input(48000 * 2);
+	for(float& f : input)
+		f = Random::FloatRange(-1.0f, 1.0f);
+
+	BQF designs[2];
+	designs[0].SetAllPass(0.707f, 3000.0f, 48000.0f);
+	designs[1].SetAllPass(0.707f, 5000.0f, 48000.0f);
+	const uint32 numStages = 6;
+	const float feedback = 0.35f;
+
+	Vector<float> expected = input;
+	BQF scalar[numStages][2];
+	for(uint32 s = 0; s < numStages; s++)
+	{
+		scalar[s][0] = designs[0];
+		scalar[s][1] = designs[1];
+	}
+	float lastOutput[2] = { 0.0f, 0.0f };
+	for(uint32 i = 0; i < 48000; i++)
+	{
+		for(uint32 c = 0; c < 2; c++)
+		{
+			float output = feedback * lastOutput[c] + expected[i * 2 + c];
+			for(uint32 s = 0; s < numStages; s++)
+				output = scalar[s][c].Update(output);
+			lastOutput[c] = output;
+			expected[i * 2 + c] = output;
+		}
+	}
+
+	Vector<float> actual = input;
+	StereoBQF filter;
+	filter.SetNumStages(numStages);
+	filter.SetCoefficients(designs[0], designs[1]);
+	filter.Process(actual.data(), 48000, feedback);
+
+	float maxError = 0.0f;
+	for(size_t i = 0; i < actual.size(); i++)
+		maxError = Math::Max(maxError, fabsf(actual[i] - expected[i]));
+	Logf("Max stereo biquad error: %f", Logger::Severity::Info, maxError);
+	TestEnsure(maxError < 1e-4f);
+}
+
+Test("Audio.FFT")
+{
+	// Should match a plain DFT and invert back to the input
+	const uint32 size = 256;
+	Vector<std::complex<float>> input(size);
+	for(auto& c : input)
+		c = std::complex<float>(Random::FloatRange(-1.0f, 1.0f), Random::FloatRange(-1.0f, 1.0f));
+
+	Vector<std::complex<float>> actual = input;
+	FFT fft(size);
+	fft.Transform(actual.data());
+
+	double maxError = 0.0;
+	for(uint32 k = 0; k < size; k++)
+	{
+		std::complex<double> expected = 0.0;
+		for(uint32 n = 0; n < size; n++)
+			expected += std::complex<double>(input[n]) * std::polar(1.0, -2.0 * Math::pi * k * n / size);
+		maxError = Math::Max(maxError, std::abs(expected - std::complex<double>(actual[k])));
+	}
+	Logf("Max FFT error: %f", Logger::Severity::Info, maxError);
+	TestEnsure(maxError < 1e-3);
+
+	fft.Transform(actual.data(), true);
+	float maxRoundTripError = 0.0f;
+	for(uint32 n = 0; n < size; n++)
+		maxRoundTripError = Math::Max(maxRoundTripError, std::abs(actual[n] - input[n]));
+	TestEnsure(maxRoundTripError < 1e-5f);
+	TestEnsure(FFT::GetPowerOfTwo(1000) == 1024);
+	TestEnsure(FFT::GetPowerOfTwo(1024) == 1024);
+}
+
+Test("Audio.Stress.Register")
+{
+	// Synthetic sound source so no files need to be decoded
+	class SineSource : public AudioBase
+	{
+		uint64 m_samplePos = 0;
+	public:
+		~SineSource()
+		{
+			Deregister();
+		}
+		void Process(float* out, uint32 numSamples) override
+		{
+			for(uint32 i = 0; i < numSamples; i++)
+			{
+				float v = sinf((float)m_samplePos++ * 0.05f) * 0.01f;
+				out[i * 2] = v;
+				out[i * 2 + 1] = v;
+			}
+		}
+		int32 GetPosition() const override { return (int32)(m_samplePos * 1000 / GetSampleRate()); }
+		uint32 GetSampleRate() const override { return GetAudioSampleRate(); }
+		uint64 GetSamplePos() const override { return m_samplePos; }
+		float* GetPCM() override { return nullptr; }
+		uint64 GetPCMCount() const override { return 0; }
+		void PreRenderDSPs(Vector<DSP*>& DSPs) override {}
+	};
+
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(audio->Init(output));
+	Audio_Impl* impl = audio->GetImpl();
+	const uint64 startFrames = impl->stats.numFramesMixed;
+	const uint64 startLockMisses = impl->telemetry.numLockMisses;
+
+	// Real streams that get seeked while rendering, one of them decodes on its own thread
+	Ref<AudioStream> preloaded = audio->CreateStream(testSongPath, true);
+	Ref<AudioStream> streamed = audio->CreateStream(testSongPath, false);
+	TestEnsure(preloaded && streamed);
+	preloaded->Play();
+	streamed->Play();
+	const int32 maxSeek = Math::Max(0, (int32)(preloaded->GetPCMCount() * 1000 / preloaded->GetSampleRate()) - 1000);
+
+	// Render a fixed amount of audio on a separate thread, like an audio device would
+	const uint64 totalFrames = 48000 * 20;
+	const uint32 blockFrames = 256;
+	std::atomic<bool> rendering = { true };
+	std::thread renderThread([&]()
+	{
+		while(output->GetFramesRendered() < totalFrames)
+			output->Render(Math::Min<uint64>(blockFrames, totalFrames - output->GetFramesRendered()));
+		rendering = false;
+	});
+
+	const uint32 numIterations = 10000;
+	const uint32 maxAlive = 64;
+	Vector<SineSource*> alive;
+	uint32 numSeeks = 0;
+	uint64 lastSeekFrame = UINT64_MAX;
+	bool seeksVisible = true;
+	Timer t;
+	for(uint32 i = 0; i < numIterations || rendering; i++)
+	{
+		if(i < numIterations)
+		{
+			SineSource* source = new SineSource();
+			impl->Register(source);
+
+			// Toggle DSPs on some sources as well
+			if(i % 4 == 0)
+			{
+				PanDSP* pan = new PanDSP();
+				pan->panning = 0.5f;
+				source->AddDSP(pan);
+				source->RemoveDSP(pan);
+				delete pan;
+			}
+
+			alive.Add(source);
+			if(alive.size() > maxAlive)
+			{
+				delete alive.front();
+				alive.erase(alive.begin());
+			}
+		}
+
+		// Seek once per rendered block so the seek queue never fills up
+		const uint64 framesRendered = output->GetFramesRendered();
+		if(framesRendered != lastSeekFrame && framesRendered < totalFrames)
+		{
+			lastSeekFrame = framesRendered;
+			const int32 seek = Random::IntRange(0, maxSeek);
+			preloaded->SetPosition(seek);
+			streamed->SetPosition(seek);
+			// Reported right away, before the audio thread performed the seek
+			seeksVisible &= abs(preloaded->GetPosition() - seek) <= 1 && abs(streamed->GetPosition() - seek) <= 1;
+			numSeeks++;
+		}
+	}
+	renderThread.join();
+	for(SineSource* source : alive)
+		delete source;
+	Logf("%d register/deregister cycles and %d seeks while rendering %llu frames in %.2fs", Logger::Severity::Info,
+		numIterations, numSeeks, totalFrames, t.SecondsAsDouble());
+
+	// Every frame got rendered and the audio thread never had to skip a stream because of the game thread
+	TestEnsure(output->GetFramesRendered() == totalFrames);
+	TestEnsure(impl->stats.numFramesMixed - startFrames == totalFrames);
+	TestEnsure(impl->telemetry.numLockMisses == startLockMisses);
+	TestEnsure(seeksVisible);
+
+	// Seeks are performed by the next block, also while paused where the position stays put
+	const int32 seek = maxSeek / 2;
+	preloaded->Pause();
+	streamed->Pause();
+	preloaded->SetPosition(seek);
+	streamed->SetPosition(seek);
+	output->Render(blockFrames);
+	const uint64 expectedPos = (uint64)((double)seek / 1000.0 * preloaded->GetSampleRate());
+	TestEnsure(preloaded->GetSamplePos() == expectedPos);
+	TestEnsure(streamed->GetSamplePos() == expectedPos);
+	TestEnsure(!preloaded->HasEnded() && !streamed->HasEnded());
+
+	preloaded.reset();
+	streamed.reset();
+	delete audio;
+}
+
+static bool ReadFile(const String& path, Buffer& out)
+{
+	File file;
+	if(!file.OpenRead(path))
+		return false;
+	out.resize(file.GetSize());
+	file.Read(out.data(), out.size());
+	return true;
+}
+
+// Renders the test song with a few DSPs and samples into a wav file without using a sound card
+// mixTime receives the time spent inside the mixer
+static void RenderTestScene(const String& outputPath, double seconds, double& mixTime)
+{
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(output->Open(outputPath));
+	TestEnsure(audio->Init(output));
+
+	Ref<AudioStream> song = audio->CreateStream(testSongPath, true);
+	TestEnsure(song);
+	Sample sample = audio->CreateSample(testSamplePath);
+	TestEnsure(sample);
+
+	BQFDSP* filter = new BQFDSP(audio->GetSampleRate());
+	filter->SetLowPass(2.0f, 1000.0f);
+	song->AddDSP(filter);
+	EchoDSP* echo = new EchoDSP(audio->GetSampleRate());
+	echo->SetLength(5000);
+	echo->feedback = 0.4f;
+	song->AddDSP(echo);
+	PhaserDSP* phaser = new PhaserDSP(audio->GetSampleRate());
+	phaser->SetLength(2000);
+	song->AddDSP(phaser);
+
+	song->Play();
+	song->SetPosition(testSongOffset);
+
+	// Trigger the sample every 500ms
+	const uint64 totalFrames = (uint64)(seconds * output->GetSampleRate());
+	const uint64 sampleInterval = output->GetSampleRate() / 2;
+	while(output->GetFramesRendered() < totalFrames)
+	{
+		sample->Play();
+		output->Render(Math::Min(sampleInterval, totalFrames - output->GetFramesRendered()));
+	}
+	mixTime = output->GetMixTime();
+
+	song.reset();
+	sample.reset();
+	delete filter;
+	delete echo;
+	delete phaser;
+	delete audio;
+}
+
+Test("Audio.Render.Deterministic")
+{
+	// Rendering the same scene twice should produce the exact same file
+	String pathA = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_A.wav");
+	String pathB = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_B.wav");
+	double mixTime;
+	RenderTestScene(pathA, 10.0, mixTime);
+	RenderTestScene(pathB, 10.0, mixTime);
+
+	Buffer a, b;
+	TestEnsure(ReadFile(pathA, a));
+	TestEnsure(ReadFile(pathB, b));
+
+	TestEnsure(a.size() > 44);
+	TestEnsure(a == b);
+}
+
+Test("Audio.FileOutput.Overwrite")
+{
+	// Writing a shorter render over an existing file shouldn't leave the old data behind
+	String path = Path::Absolute(TestBasePath + Path::sep + context.GetName() + ".wav");
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(audio->Init(output));
+	for(uint32 seconds : {2, 1})
+	{
+		TestEnsure(output->Open(path));
+		output->Render(48000 * seconds);
+		output->Close();
+	}
+	delete audio;
+
+	Buffer data;
+	TestEnsure(ReadFile(path, data));
+	TestEnsure(data.size() == 44 + 48000 * 2 * sizeof(float));
+}
+
+Test("Audio.Benchmark.Pipeline")
+{
+	const double seconds = 60.0;
+	String path = Path::Absolute(TestBasePath + Path::sep + context.GetName() + ".wav");
+	double mixTime;
+	Timer t;
+	RenderTestScene(path, seconds, mixTime);
+	double totalTime = t.SecondsAsDouble();
+
+	Logf("Rendered %.0fs of audio in %.3fs (%.3fs mixing): %.0f frames per cpu second (%.1fx realtime)", Logger::Severity::Info,
+		seconds, totalTime, mixTime, seconds * 48000.0 / mixTime, seconds / mixTime);
+}
+
+// Renders the test sample, playing it a second time after numFrames when overlap is set
+static void RenderSampleOverlap(const String& outputPath, uint32 numFrames, bool overlap)
+{
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(output->Open(outputPath));
+	TestEnsure(audio->Init(output));
+
+	Sample sample = audio->CreateSample(testSamplePath);
+	TestEnsure(sample);
+	// Keep the sum of two plays away from the limiter
+	sample->SetVolume(0.25f);
+
+	sample->Play();
+	output->Render(numFrames);
+	if(overlap)
+		sample->Play();
+	output->Render(numFrames);
+
+	sample.reset();
+	delete audio;
+}
+
+Test("Audio.Sample.Polyphony")
+{
+	// Multiple of the mixer block size, so the second play starts exactly here
+	const uint32 numFrames = 384 * 10;
+	String pathSingle = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_Single.wav");
+	String pathOverlap = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_Overlap.wav");
+	RenderSampleOverlap(pathSingle, numFrames, false);
+	RenderSampleOverlap(pathOverlap, numFrames, true);
+
+	Buffer single, overlap;
+	TestEnsure(ReadFile(pathSingle, single));
+	TestEnsure(ReadFile(pathOverlap, overlap));
+	const uint32 numValues = numFrames * 2 * 2;
+	TestEnsure(single.size() == overlap.size());
+	TestEnsure(single.size() >= 44 + numValues * sizeof(float));
+
+	// The second half should have the first play continuing with the second one on top of it
+	const float* a = (const float*)(single.data() + 44);
+	const float* b = (const float*)(overlap.data() + 44);
+	const uint32 half = numFrames * 2;
+	float maxError = 0.0f;
+	for(uint32 i = 0; i < half; i++)
+	{
+		maxError = Math::Max(maxError, fabsf(b[i] - a[i]));
+		maxError = Math::Max(maxError, fabsf(b[half + i] - (a[half + i] + a[i])));
+	}
+	Logf("Max overlap error: %f", Logger::Severity::Info, maxError);
+	TestEnsure(maxError < 1e-5f);
+}
+
+// Renders the test sample next to a silent stream, returns the first frame that isn't silent
+//	scheduled plays the sample when the stream reaches samplePos instead of right away
+static int64 RenderFirstSound(const String& outputPath, bool scheduled, int64 samplePos, uint32& streamRate)
+{
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(output->Open(outputPath));
+	TestEnsure(audio->Init(output));
+
+	Ref<AudioStream> song = audio->CreateStream(testSongPath, true);
+	TestEnsure(song);
+	streamRate = song->GetSampleRate();
+	song->SetVolume(0.0f);
+	song->SetPosition(0);
+	song->Play();
+	Sample sample = audio->CreateSample(testSamplePath);
+	TestEnsure(sample);
+
+	if(scheduled)
+		sample->PlayAt(song.get(), samplePos);
+	else
+		sample->Play();
+	const uint32 numFrames = output->GetSampleRate();
+	output->Render(numFrames);
+
+	song.reset();
+	sample.reset();
+	delete audio;
+
+	Buffer data;
+	TestEnsure(ReadFile(outputPath, data));
+	TestEnsure(data.size() >= 44 + numFrames * 2 * sizeof(float));
+	const float* pcm = (const float*)(data.data() + 44);
+	for(uint32 i = 0; i < numFrames * 2; i++)
+	{
+		if(pcm[i] != 0.0f)
+			return i / 2;
+	}
+	return -1;
+}
+
+Test("Audio.Sample.Scheduled")
+{
+	String pathNow = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_Now.wav");
+	String pathScheduled = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_Scheduled.wav");
+
+	// Not aligned to the mixer blocks
+	const int64 samplePos = 12345;
+	uint32 streamRate;
+	int64 now = RenderFirstSound(pathNow, false, 0, streamRate);
+	int64 scheduled = RenderFirstSound(pathScheduled, true, samplePos, streamRate);
+	TestEnsure(now >= 0 && scheduled >= 0);
+
+	// The sample should start at the frame where the stream reaches the position, not at the next block
+	int64 expected = now + samplePos * 48000 / streamRate;
+	Logf("Scheduled sample started at frame %d, expected %d", Logger::Severity::Info, (int32)scheduled, (int32)expected);
+	TestEnsure(abs(scheduled - expected) <= 1);
+}
+
+Test("Audio.Sample.ScheduledDropped")
+{
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(audio->Init(output));
+
+	Ref<AudioStream> song = audio->CreateStream(testSongPath, true);
+	TestEnsure(song);
+	song->SetPosition(0);
+	song->Play();
+	Sample sample = audio->CreateSample(testSamplePath);
+	TestEnsure(sample);
+
+	// Seeking makes the scheduled position meaningless
+	sample->PlayAt(song.get(), song->GetSampleRate() * 10);
+	output->Render(1024);
+	TestEnsure(sample->IsPlaying());
+	song->SetPosition(0);
+	output->Render(1024);
+	TestEnsure(!sample->IsPlaying());
+
+	// Removing the clock must not leave the sample with a dangling pointer
+	sample->PlayAt(song.get(), song->GetSampleRate() * 10);
+	output->Render(1024);
+	song.reset();
+	output->Render(1024);
+	TestEnsure(!sample->IsPlaying());
+
+	sample.reset();
+	delete audio;
+}
+
+Test("Audio.Sample.Stop")
+{
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(audio->Init(output));
+	Sample metronome = audio->CreateSample(testSamplePath);
+	TestEnsure(metronome);
+
+	metronome->Play(true);
+	output->Render(1024);
+	TestEnsure(metronome->IsPlaying());
+
+	// Stop still gets through when the command queue is full of plays
+	for(uint32 i = 0; i < 100; i++)
+		metronome->Play();
+	metronome->Stop();
+	output->Render(1024);
+	TestEnsure(!metronome->IsPlaying());
+	output->Render(48000);
+	TestEnsure(!metronome->IsPlaying());
+
+	// Plays after a stop in the same block are kept
+	metronome->Play(true);
+	metronome->Stop();
+	metronome->Play(true);
+	output->Render(48000);
+	TestEnsure(metronome->IsPlaying());
+	metronome->Stop();
+	output->Render(1024);
+	TestEnsure(!metronome->IsPlaying());
+
+	metronome.reset();
+	delete audio;
+}
+
+Test("Audio.DSP.ScheduledDropped")
+{
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(audio->Init(output));
+	AudioTelemetry& telemetry = audio->GetImpl()->telemetry;
+	const uint64 droppedBefore = telemetry.numDroppedDSPEvents;
+
+	Ref<AudioStream> song = audio->CreateStream(testSongPath, true);
+	TestEnsure(song);
+	song->Play();
+	PanDSP* pan = new PanDSP();
+	song->AddDSP(pan);
+
+	// Changes that don't fit in the queue are dropped without touching the DSP on this thread
+	for(uint32 i = 1; i <= 100; i++)
+		song->ScheduleDSPMix(pan, (float)i / 100.0f, 0);
+	TestEnsure(pan->mix == 1.0f);
+	TestEnsure(telemetry.numDroppedDSPEvents - droppedBefore == 100 - 64);
+
+	// The last change that was queued wins
+	output->Render(1024);
+	TestEnsure(pan->mix == 0.64f);
+
+	song->RemoveDSP(pan);
+	delete pan;
+	song.reset();
+	delete audio;
+}
+
+Test("Audio.Resampler.Bypass")
+{
+	// At 1:1 the sinc filter is skipped and the input comes out unchanged, only delayed
+	Resampler resampler;
+	resampler.SetQuality(ResamplerQuality::Sinc);
+	resampler.SetRatio(1.0);
+
+	const uint32 delay = Resampler::numTaps / 2;
+	float out[2];
+	for(uint32 i = 0; i < 256; i++)
+	{
+		const float value = (float)((i * 7919) % 255) / 127.0f - 1.0f;
+		resampler.Push(value, -value);
+		resampler.Interpolate(0.0f, out);
+		if(i >= delay)
+		{
+			const float expected = (float)(((i - delay) * 7919) % 255) / 127.0f - 1.0f;
+			TestEnsure(out[0] == expected && out[1] == -expected);
+		}
+	}
+}
+
+Test("Audio.Clock")
+{
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(audio->Init(output));
+
+	Ref<AudioStream> song = audio->CreateStream(testSongPath, true);
+	TestEnsure(song);
+	song->SetPosition(0);
+	song->Play();
+
+	// Manual pacing drives the clock with the rendered frames, everything that was rendered has been heard
+	//	blocks that don't line up with the mixer check the position in between callbacks as well
+	for(uint32 i = 0; i < 20; i++)
+	{
+		output->Render(2000 + i * 37);
+		int32 expected = (int32)(output->GetFramesRendered() * 1000 / output->GetSampleRate());
+		int32 position = song->GetPosition();
+		Logf("Position after rendering %d frames: %dms, expected %dms", Logger::Severity::Info, (int32)output->GetFramesRendered(), position, expected);
+		TestEnsure(abs(position - expected) <= 1);
+	}
+
+	// Still there after pausing
+	int32 pausedAt = song->GetPosition();
+	song->Pause();
+	output->Render(output->GetSampleRate() / 10);
+	TestEnsure(abs(song->GetPosition() - pausedAt) <= 1);
+
+	song.reset();
+	delete audio;
+}
+
+// Renders the test song with a filter and a sample using the given mixer block size
+static void RenderBlockSize(const String& outputPath, uint32 blockSize)
+{
+	Audio* audio = new Audio();
+	audio->SetMixBlockSize(blockSize);
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(output->Open(outputPath));
+	TestEnsure(audio->Init(output));
+
+	Ref<AudioStream> song = audio->CreateStream(testSongPath, true);
+	TestEnsure(song);
+	BQFDSP* filter = new BQFDSP(audio->GetSampleRate());
+	filter->SetLowPass(2.0f, 1000.0f);
+	song->AddDSP(filter);
+	song->SetPosition(0);
+	song->Play();
+	Sample sample = audio->CreateSample(testSamplePath);
+	TestEnsure(sample);
+
+	// Triggered on a multiple of every block size so plays start at the same frame
+	for(uint32 i = 0; i < 5; i++)
+	{
+		sample->Play();
+		output->Render(12288);
+	}
+	if(blockSize != 0)
+		TestEnsure(audio->GetImpl()->stats.blockSize == blockSize);
+
+	song.reset();
+	sample.reset();
+	delete filter;
+	audio->SetMixBlockSize(0);
+	delete audio;
+}
+
+Test("Audio.BlockSize")
+{
+	// The block size should only change the latency, not the result
+	String pathReference = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_384.wav");
+	RenderBlockSize(pathReference, 384);
+	Buffer reference;
+	TestEnsure(ReadFile(pathReference, reference));
+
+	for(uint32 blockSize : {0u, 64u, 4096u})
+	{
+		String path = Path::Absolute(TestBasePath + Path::sep + context.GetName() + Utility::Sprintf("_%d.wav", blockSize));
+		RenderBlockSize(path, blockSize);
+		Buffer data;
+		TestEnsure(ReadFile(path, data));
+		TestEnsure(data == reference);
+	}
+}
+
+Test("Audio.Telemetry")
+{
+	String csvPath = Path::Absolute(TestBasePath + Path::sep + context.GetName() + ".csv");
+
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(audio->Init(output));
+	audio->SetTelemetryCsv(csvPath);
+
+	Ref<AudioStream> song = audio->CreateStream(testSongPath, true);
+	TestEnsure(song);
+	PhaserDSP* phaser = new PhaserDSP(song->GetAudioSampleRate());
+	song->AddDSP(phaser);
+	song->Play();
+
+	const uint32 numCallbacks = 50;
+	for(uint32 i = 0; i < numCallbacks; i++)
+	{
+		output->Render(480);
+		audio->UpdateTelemetry();
+	}
+	audio->SetTelemetryCsv(String());
+
+	// Every item and DSP that was rendered has a cost
+	const AudioTelemetry& telemetry = audio->GetImpl()->telemetry;
+	auto hasCost = [](const Vector<AudioCostStats>& costs, const String& name)
+	{
+		for(const AudioCostStats& cost : costs)
+		{
+			if(name == cost.name && cost.numCalls > 0)
+				return true;
+		}
+		return false;
+	};
+	Vector<AudioCostStats> dspCosts = telemetry.GetCosts(telemetry.dspCosts, audio->GetImpl()->stats.totalCallbackMicroseconds);
+	TestEnsure(hasCost(dspCosts, "PhaserDSP"));
+	TestEnsure(hasCost(dspCosts, "LimiterDSP"));
+	TestEnsure(hasCost(telemetry.GetCosts(telemetry.itemCosts, 0), song->GetName()));
+
+	// A header and a line for each callback
+	File file;
+	TestEnsure(file.OpenRead(csvPath));
+	FileReader reader(file);
+	String line;
+	uint32 numLines = 0;
+	while(TextStream::ReadLine(reader, line))
+		numLines++;
+	TestEnsure(numLines == numCallbacks + 1);
+
+	song->RemoveDSP(phaser);
+	delete phaser;
+	song.reset();
+	delete audio;
+}
+
+// Renders the test song with or without preloading, seeking once halfway
+//	seeks are performed while the stream is paused, so the decode thread can catch up before the stream is heard again
+static void RenderStream(const String& outputPath, bool preload)
+{
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(output->Open(outputPath));
+	TestEnsure(audio->Init(output));
+	const uint32 blockSize = output->GetSampleRate() / 20;
+
+	Ref<AudioStream> song = audio->CreateStream(testSongPath, preload);
+	TestEnsure(song);
+	song->SetPosition(testSongOffset);
+	output->Render(blockSize);
+	TestEnsure(song->WaitForDecoding(10000));
+	song->Play();
+
+	for(uint32 i = 0; i < 100; i++)
+	{
+		if(i == 50)
+		{
+			song->Pause();
+			song->SetPosition(testSongOffset + 1000);
+			output->Render(blockSize);
+			TestEnsure(song->WaitForDecoding(10000));
+			song->Play();
+		}
+
+		TestEnsure(song->WaitForDecoding(10000));
+		output->Render(blockSize);
+	}
+
+	song.reset();
+	delete audio;
+}
+
+Test("Audio.Stream.DecodeThread")
+{
+	// Streams decoded on a separate thread should sound exactly the same as preloaded ones
+	String pathPreloaded = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_Preloaded.wav");
+	String pathStreamed = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_Streamed.wav");
+	RenderStream(pathPreloaded, true);
+	RenderStream(pathStreamed, false);
+
+	Buffer a, b;
+	TestEnsure(ReadFile(pathPreloaded, a));
+	TestEnsure(ReadFile(pathStreamed, b));
+
+	TestEnsure(a.size() > 44);
+	TestEnsure(a == b);
+}
+
+Test("Audio.PcmCache")
+{
+	String cachePath = Path::Absolute(TestBasePath + Path::sep + context.GetName());
+	Path::DeleteDir(cachePath);
+
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(audio->Init(output));
+	audio->SetPcmCache(cachePath, 1024ull * 1024 * 1024);
+
+	// First load decodes and stores the file
+	Timer t;
+	Ref<AudioStream> decoded = audio->CreateStream(testSongPath, true);
+	TestEnsure(decoded);
+	double decodeTime = t.SecondsAsDouble();
+	audio->GetImpl()->pcmCache.Flush();
+
+	// Second load should map the stored file
+	t.Restart();
+	Ref<AudioStream> cached = audio->CreateStream(testSongPath, true);
+	TestEnsure(cached);
+	double cachedTime = t.SecondsAsDouble();
+	Logf("Decoded in %.3fs, loaded from cache in %.3fs", Logger::Severity::Info, decodeTime, cachedTime);
+
+	TestEnsure(decoded->GetPCM() != cached->GetPCM());
+	TestEnsure(decoded->GetPCMCount() == cached->GetPCMCount());
+	TestEnsure(decoded->GetSampleRate() == cached->GetSampleRate());
+	TestEnsure(memcmp(decoded->GetPCM(), cached->GetPCM(), (size_t)decoded->GetPCMCount() * 2 * sizeof(float)) == 0);
+
+	decoded.reset();
+	cached.reset();
+	delete audio;
+}
+
+Test("Audio.PcmCache.Variant")
+{
+	String cachePath = Path::Absolute(TestBasePath + Path::sep + context.GetName());
+	Path::DeleteDir(cachePath);
+
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(audio->Init(output));
+	audio->SetPcmCache(cachePath, 1024ull * 1024 * 1024);
+
+	// Modified copy of the track, like one with pre-rendered effects
+	Ref<AudioStream> music = audio->CreateStream(testSongPath, true);
+	TestEnsure(music);
+	Ref<AudioStream> modified = AudioStream::Clone(audio, music);
+	float* pcm = modified->GetPCM();
+	for(uint64 i = 0; i < modified->GetPCMCount() * 2; i++)
+		pcm[i] *= 0.5f;
+
+	TestEnsure(!AudioStream::LoadVariant(audio, testSongPath, "a", "1"));
+	AudioStream::StoreVariant(audio, testSongPath, "a", "1", modified);
+	audio->GetImpl()->pcmCache.Flush();
+
+	Ref<AudioStream> cached = AudioStream::LoadVariant(audio, testSongPath, "a", "1");
+	TestEnsure(cached);
+	TestEnsure(cached->GetPCMCount() == modified->GetPCMCount());
+	TestEnsure(memcmp(cached->GetPCM(), modified->GetPCM(), (size_t)modified->GetPCMCount() * 2 * sizeof(float)) == 0);
+	TestEnsure(!AudioStream::LoadVariant(audio, testSongPath, "b", "1"));
+	TestEnsure(!AudioStream::LoadVariant(audio, testSongPath, "a", "2"));
+	cached.reset();
+
+	// Storing the variant with a new key replaces the old entry
+	TestEnsure(Files::ScanFiles(cachePath, "pcm").size() == 2);
+	for(uint64 i = 0; i < modified->GetPCMCount() * 2; i++)
+		pcm[i] *= 0.5f;
+	AudioStream::StoreVariant(audio, testSongPath, "a", "2", modified);
+	audio->GetImpl()->pcmCache.Flush();
+	TestEnsure(Files::ScanFiles(cachePath, "pcm").size() == 2);
+	TestEnsure(!AudioStream::LoadVariant(audio, testSongPath, "a", "1"));
+	cached = AudioStream::LoadVariant(audio, testSongPath, "a", "2");
+	TestEnsure(cached);
+	TestEnsure(memcmp(cached->GetPCM(), modified->GetPCM(), (size_t)modified->GetPCMCount() * 2 * sizeof(float)) == 0);
+
+	// Keys of effects change with any of their parameters
+	PhaserDSP a(48000), b(48000);
+	a.SetLength(500);
+	b.SetLength(500);
+	TestEnsure(a.GetKey() == b.GetKey());
+	b.feedback = 0.5f;
+	TestEnsure(a.GetKey() != b.GetKey());
+	b.feedback = a.feedback;
+	b.SetStage(4);
+	TestEnsure(a.GetKey() != b.GetKey());
+
+	music.reset();
+	modified.reset();
+	cached.reset();
+	delete audio;
+}
+
+Test("Audio.PcmCache.Mapped")
+{
+	String cachePath = Path::Absolute(TestBasePath + Path::sep + context.GetName());
+	Path::DeleteDir(cachePath);
+
+	Ref<Vector<float>> data = std::make_shared<Vector<float>>(1000 * 2, 0.5f);
+	Vector<float> pcm = *data;
+	const uint64 entrySize = sizeof(PcmCacheHeader) + pcm.size() * sizeof(float);
+
+	PcmCache cache;
+	cache.Configure(cachePath, entrySize * 4);
+	// Any existing file works as the source of an entry, the data is kept alive until it is written
+	cache.Store(testSongPath, 48000, PcmCacheFormat::Float32, data->data(), 1000, 48000, data);
+	data.reset();
+	cache.Flush();
+	TestEnsure(Files::ScanFiles(cachePath, "pcm").size() == 1);
+
+	PcmCacheHeader header;
+	Ref<MappedFile> mapped = cache.Load(testSongPath, 48000, PcmCacheFormat::Float32, header);
+	TestEnsure(mapped);
+	Ref<MappedFile> mappedAgain = cache.Load(testSongPath, 48000, PcmCacheFormat::Float32, header);
+	TestEnsure(mappedAgain);
+
+	// Keyed on the contents, a copy of the source maps the same entry
+	String copyPath = cachePath + Path::sep + "copy.ogg";
+	TestEnsure(Path::Copy(testSongPath, copyPath));
+	TestEnsure(cache.Load(copyPath, 48000, PcmCacheFormat::Float32, header));
+	TestEnsure(!cache.Load(copyPath, 44100, PcmCacheFormat::Float32, header));
+	Path::Delete(copyPath);
+
+	// Mapped entries are kept when the cache shrinks
+	cache.Configure(cachePath, entrySize / 2);
+	TestEnsure(Files::ScanFiles(cachePath, "pcm").size() == 1);
+	TestEnsure(memcmp(mapped->GetData() + sizeof(PcmCacheHeader), pcm.data(), pcm.size() * sizeof(float)) == 0);
+
+	// Removed once the last mapping is released
+	mapped.reset();
+	TestEnsure(Files::ScanFiles(cachePath, "pcm").size() == 1);
+	mappedAgain.reset();
+	TestEnsure(Files::ScanFiles(cachePath, "pcm").empty());
+}
+
+Test("Audio.CompactPcm")
+{
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(audio->Init(output));
+
+	Ref<AudioStream> full = audio->CreateStream(testSongPath, true);
+	TestEnsure(full && full->GetPCM());
+	audio->SetCompactPcm(true);
+	Ref<AudioStream> compact = audio->CreateStream(testSongPath, true);
+	TestEnsure(compact && compact->GetPCM16());
+	audio->SetCompactPcm(false);
+
+	TestEnsure(compact->GetPCMCount() == full->GetPCMCount());
+	TestEnsure(compact->GetPCMMemoryUsage() * 2 == full->GetPCMMemoryUsage());
+
+	// Should only differ by the 16-bit quantization
+	const float* a = full->GetPCM();
+	const int16* b = compact->GetPCM16();
+	float maxError = 0.0f;
+	for(uint64 i = 0; i < full->GetPCMCount() * 2; i++)
+	{
+		float expected = Math::Clamp(a[i], -1.0f, 1.0f);
+		maxError = Math::Max(maxError, fabsf(expected - (float)b[i] / (float)0x7FFF));
+	}
+	Logf("Max compact pcm error: %f", Logger::Severity::Info, maxError);
+	TestEnsure(maxError <= 1.0f / (float)0x7FFF);
+
+	full.reset();
+	compact.reset();
+	delete audio;
+}
+
+Test("Audio.Stream.Window")
+{
+	Audio* audio = new Audio();
+	TestEnsure(audio->Init(new FileAudioOutput(48000)));
+
+	Ref<AudioStream> full = audio->CreateStream(testSongPath, true);
+	TestEnsure(full && full->GetPCM());
+	Ref<AudioStream> window = AudioStream::CreateWindow(audio, testSongPath, 1000, 500);
+	TestEnsure(window && window->GetPCM());
+
+	// Should hold exactly the requested part of the song
+	const uint32 rate = full->GetSampleRate();
+	TestEnsure(window->GetSampleRate() == rate);
+	TestEnsure(window->GetPCMCount() == (uint64)rate / 2);
+	const float* expected = full->GetPCM() + (uint64)rate * 2;
+	const float* actual = window->GetPCM();
+	float maxError = 0.0f;
+	for(uint64 i = 0; i < window->GetPCMCount() * 2; i++)
+		maxError = Math::Max(maxError, fabsf(actual[i] - expected[i]));
+	Logf("Max window error: %f", Logger::Severity::Info, maxError);
+	TestEnsure(maxError < 1e-5f);
+
+	full.reset();
+	window.reset();
+	delete audio;
+}
+
+// A mix of overlapping and separate effects on the first few seconds of stream
+static Vector<DSP*> CreatePreRenderDSPs(AudioStream* stream)
+{
+	Vector<DSP*> DSPs;
+	for(uint32 i = 0; i < 16; i++)
+	{
+		DSP* dsp;
+		if(i % 3 == 0)
+		{
+			BQFDSP* bqf = new BQFDSP(stream->GetSampleRate());
+			bqf->SetLowPass(1.0f, 500.0f + i * 100.0f);
+			dsp = bqf;
+		}
+		else if(i % 3 == 1)
+		{
+			RetriggerDSP* retrigger = new RetriggerDSP(stream->GetSampleRate());
+			retrigger->SetLength(60.0);
+			retrigger->SetResetDuration(240);
+			dsp = retrigger;
+		}
+		else
+		{
+			PanDSP* pan = new PanDSP();
+			pan->panning = 0.5f;
+			dsp = pan;
+		}
+		dsp->startTime = i * 1000;
+		dsp->endTime = dsp->startTime + ((i % 4 == 0) ? 1200 : 150);
+		dsp->priority = i % 3;
+		dsp->SetAudioBase(stream);
+		DSPs.Add(dsp);
+	}
+	DSPs.Sort(DSP::Sorter);
+	return DSPs;
+}
+
+// Renders DSPs one after another the way streams did before DSPPreRenderer, each one on a copy of its range
+static void PreRenderSerial(AudioStream* stream, const Vector<DSP*>& DSPs)
+{
+	float* pcm = stream->GetPCM();
+	for(DSP* dsp : DSPs)
+	{
+		uint64 startSample = ((uint64)dsp->startTime * stream->GetSampleRate()) / 1000;
+		uint64 endSample = Math::Min(((uint64)dsp->endTime * stream->GetSampleRate()) / 1000, stream->GetPCMCount());
+		if(startSample >= endSample)
+			continue;
+
+		Vector<float> buffer(pcm + startSample * 2, pcm + endSample * 2);
+		dsp->SetPreRenderPosition(startSample);
+		dsp->Process(buffer.data(), (uint32)(endSample - startSample));
+		dsp->SetPreRenderPosition(-1);
+		memcpy(pcm + startSample * 2, buffer.data(), buffer.size() * sizeof(float));
+	}
+}
+
+Test("Audio.PreRender.Parallel")
+{
+	Audio* audio = new Audio();
+	TestEnsure(audio->Init(new FileAudioOutput(48000)));
+
+	Ref<AudioStream> song = audio->CreateStream(testSongPath, true);
+	TestEnsure(song);
+	Ref<AudioStream> serial = AudioStream::Clone(audio, song);
+	Ref<AudioStream> parallel = AudioStream::Clone(audio, song);
+
+	Vector<DSP*> serialDSPs = CreatePreRenderDSPs(serial.get());
+	Timer t;
+	PreRenderSerial(serial.get(), serialDSPs);
+	double serialTime = t.SecondsAsDouble();
+	for(DSP* dsp : serialDSPs)
+	{
+		dsp->RemoveAudioBase();
+		delete dsp;
+	}
+
+	// Clusters rendered on different threads should give the same result as rendering everything in order
+	{
+		JobSheduler sheduler;
+		t.Restart();
+		DSPPreRenderer preRenderer(parallel, CreatePreRenderDSPs(parallel.get()));
+		preRenderer.Start(&sheduler);
+		preRenderer.Wait();
+		TestEnsure(preRenderer.IsFinished());
+		TestEnsure(preRenderer.GetNumClusters() > 1);
+		Logf("Serial: %.3fs, parallel: %.3fs (%d clusters)", Logger::Severity::Info, serialTime, t.SecondsAsDouble(), preRenderer.GetNumClusters());
+	}
+
+	TestEnsure(memcmp(serial->GetPCM(), parallel->GetPCM(), (size_t)serial->GetPCMCount() * 2 * sizeof(float)) == 0);
+
+	// Waiting only renders the clusters before the requested time on the calling thread
+	{
+		Ref<AudioStream> partial = AudioStream::Clone(audio, song);
+		DSPPreRenderer preRenderer(partial, CreatePreRenderDSPs(partial.get()));
+		preRenderer.Start(nullptr);
+		preRenderer.WaitUntil(2500);
+		TestEnsure(preRenderer.GetRenderedUntil() >= 2500);
+		TestEnsure(preRenderer.GetRenderedUntil() < UINT32_MAX);
+		TestEnsure(preRenderer.GetProgress() < 0.5f);
+		preRenderer.Wait();
+		TestEnsure(preRenderer.IsFinished());
+		TestEnsure(memcmp(serial->GetPCM(), partial->GetPCM(), (size_t)serial->GetPCMCount() * 2 * sizeof(float)) == 0);
+	}
+
+	song.reset();
+	serial.reset();
+	parallel.reset();
+	delete audio;
+}
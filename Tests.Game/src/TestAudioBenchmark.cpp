@@ -0,0 +1,443 @@
+#include "stdafx.h"
+#include <Audio/MixKernels.hpp>
+#include <Audio/Resampler.hpp>
+#include <Audio/Audio.hpp>
+#include <Audio/Audio_Impl.hpp>
+#include <Audio/FileAudioOutput.hpp>
+#include <Audio/DSP.hpp>
+#include <Shared/Files.hpp>
+#include "json.hpp"
+
+// Number of frames rendered by the mixer per block
+static const uint32 mixBlockLength = 384;
+// Minimum time to spend on a single measurement
+static const double benchmarkDuration = 0.25;
+
+// Fills a buffer with noise that slightly exceeds [-1, 1] so clamping is exercised
+static void FillNoise(Vector<float>& buffer)
+{
+	for(float& f : buffer)
+		f = Random::FloatRange(-1.2f, 1.2f);
+}
+
+Test("Audio.Benchmark.Mix")
+{
+	const Vector<uint32> itemCounts = { 1, 2, 4, 8, 16, 32, 64 };
+	const uint32 maxItems = itemCounts.back();
+
+	Vector<Vector<float>> items(maxItems);
+	for(auto& item : items)
+	{
+		item.resize(mixBlockLength * 2);
+		FillNoise(item);
+	}
+	Vector<float> mixBuffer(mixBlockLength * 2);
+	Vector<int16> output(mixBlockLength * 2);
+
+	// All implementations should produce the exact same output, including for invalid samples
+	items[0][1] = NAN;
+	items[0][2] = INFINITY;
+	items[0][3] = -INFINITY;
+	Vector<int16> reference;
+	for(const MixKernels* kernels : MixKernels::GetSupported())
+	{
+		std::fill(mixBuffer.begin(), mixBuffer.end(), 0.0f);
+		for(auto& item : items)
+			kernels->Accumulate(mixBuffer.data(), item.data(), 0.3f, mixBlockLength * 2);
+		kernels->GainClamp(mixBuffer.data(), 0.8f, mixBlockLength * 2);
+		kernels->InterleaveInt16(output.data(), mixBuffer.data(), mixBlockLength, 2);
+		if(reference.empty())
+			reference = output;
+		TestEnsure(memcmp(reference.data(), output.data(), output.size() * sizeof(int16)) == 0);
+	}
+	FillNoise(items[0]);
+
+	Logf("Selected mixing kernels: %s", Logger::Severity::Info, MixKernels::Get().name);
+	for(const MixKernels* kernels : MixKernels::GetSupported())
+	{
+		for(uint32 numItems : itemCounts)
+		{
+			uint64 framesMixed = 0;
+			Timer t;
+			while(t.SecondsAsDouble() < benchmarkDuration)
+			{
+				std::fill(mixBuffer.begin(), mixBuffer.end(), 0.0f);
+				for(uint32 i = 0; i < numItems; i++)
+					kernels->Accumulate(mixBuffer.data(), items[i].data(), 0.5f, mixBlockLength * 2);
+				kernels->GainClamp(mixBuffer.data(), 0.8f, mixBlockLength * 2);
+				kernels->InterleaveInt16(output.data(), mixBuffer.data(), mixBlockLength, 2);
+				framesMixed += mixBlockLength;
+			}
+			double framesPerSecond = (double)framesMixed / t.SecondsAsDouble();
+			Logf("%-6s %2d items: %12.0f frames/s (%.0fx realtime at 48kHz)", Logger::Severity::Info,
+				kernels->name, numItems, framesPerSecond, framesPerSecond / 48000.0);
+		}
+	}
+}
+
+Test("Audio.Benchmark.MixPath")
+{
+	// Plays a noise buffer in a loop, so only the mixer itself is measured
+	class NoiseSource : public AudioBase
+	{
+		const Vector<float>& m_noise;
+		uint64 m_samplePos = 0;
+	public:
+		NoiseSource(const Vector<float>& noise) : m_noise(noise) {}
+		~NoiseSource()
+		{
+			Deregister();
+		}
+		void Process(float* out, uint32 numSamples) override
+		{
+			const uint64 numFrames = m_noise.size() / 2;
+			for(uint32 i = 0; i < numSamples; i++)
+			{
+				const uint64 frame = (m_samplePos++) % numFrames;
+				out[i * 2] = m_noise[frame * 2];
+				out[i * 2 + 1] = m_noise[frame * 2 + 1];
+			}
+		}
+		int32 GetPosition() const override { return (int32)(m_samplePos * 1000 / GetSampleRate()); }
+		uint32 GetSampleRate() const override { return GetAudioSampleRate(); }
+		uint64 GetSamplePos() const override { return m_samplePos; }
+		float* GetPCM() override { return nullptr; }
+		uint64 GetPCMCount() const override { return 0; }
+		void PreRenderDSPs(Vector<DSP*>& DSPs) override {}
+	};
+
+	Vector<float> noise(48000 * 2);
+	FillNoise(noise);
+
+	// The whole mix of Audio_Impl, including the render state, telemetry, per item DSPs and the output conversion
+	Logf("Mixing kernels: %s", Logger::Severity::Info, MixKernels::Get().name);
+	for(uint32 numItems : { 1, 8, 32 })
+	{
+		Audio* audio = new Audio();
+		audio->SetMixBlockSize(mixBlockLength);
+		FileAudioOutput* output = new FileAudioOutput(48000);
+		TestEnsure(audio->Init(output));
+
+		Vector<NoiseSource*> sources;
+		Vector<BQFDSP*> filters;
+		for(uint32 i = 0; i < numItems; i++)
+		{
+			NoiseSource* source = new NoiseSource(noise);
+			audio->GetImpl()->Register(source);
+			// Every other item gets a filter, like songs with effects
+			if(i % 2 == 0)
+			{
+				BQFDSP* filter = new BQFDSP(audio->GetSampleRate());
+				filter->SetLowPass(1.0f, 2000.0f);
+				source->AddDSP(filter);
+				filters.Add(filter);
+			}
+			sources.Add(source);
+		}
+
+		Timer t;
+		while(t.SecondsAsDouble() < benchmarkDuration)
+			output->Render(mixBlockLength * 16);
+		const double framesPerSecond = (double)output->GetFramesRendered() / output->GetMixTime();
+		Logf("Full mix %2d items: %12.0f frames/s (%.0fx realtime at 48kHz)", Logger::Severity::Info,
+			numItems, framesPerSecond, framesPerSecond / 48000.0);
+
+		for(NoiseSource* source : sources)
+			delete source;
+		for(BQFDSP* filter : filters)
+			delete filter;
+		delete audio;
+	}
+}
+
+Test("Audio.Benchmark.Resampler")
+{
+	// Common conversions: 44.1kHz to 48kHz and practice mode speeds
+	const Vector<double> ratios = { 44100.0 / 48000.0, 0.5, 1.25, 2.0 };
+
+	Vector<float> input(48000 * 2);
+	FillNoise(input);
+	const uint32 numInputFrames = (uint32)input.size() / 2;
+	float out[2];
+	float checksum = 0.0f;
+
+	for(uint32 q = 0; q < (uint32)ResamplerQuality::_Length; q++)
+	{
+		ResamplerQuality quality = (ResamplerQuality)q;
+		for(double ratio : ratios)
+		{
+			Resampler::Prepare(ratio);
+			Resampler resampler;
+			resampler.SetQuality(quality);
+			resampler.SetRatio(ratio);
+
+			uint64 framesOut = 0;
+			uint32 inputFrame = 0;
+			double position = 0.0;
+			Timer t;
+			while(t.SecondsAsDouble() < benchmarkDuration)
+			{
+				for(uint32 i = 0; i < mixBlockLength; i++)
+				{
+					uint32 target = (uint32)position;
+					while(inputFrame <= target)
+					{
+						uint32 idx = inputFrame % numInputFrames;
+						resampler.Push(input[idx * 2], input[idx * 2 + 1]);
+						inputFrame++;
+					}
+					resampler.Interpolate((float)(position - target), out);
+					checksum += out[0];
+					position += ratio;
+				}
+				framesOut += mixBlockLength;
+			}
+			double elapsed = t.SecondsAsDouble();
+			Logf("%-6s ratio %.3f: %6.1f ns/frame (%.0fx realtime at 48kHz)", Logger::Severity::Info,
+				Enum_ResamplerQuality::ToString(quality), ratio, elapsed * 1e9 / (double)framesOut, (double)framesOut / (elapsed * 48000.0));
+		}
+	}
+	// Prevent the work from being optimized away
+	Logf("Checksum: %f", Logger::Severity::Info, checksum);
+}
+
+Test("Audio.Benchmark.Seek")
+{
+	Audio* audio = new Audio();
+	FileAudioOutput* output = new FileAudioOutput(48000);
+	TestEnsure(audio->Init(output));
+
+	const uint32 numSeeks = 50;
+	const uint32 blockLength = 256;
+	Vector<float> streamed(blockLength * 2);
+	Vector<float> preloaded(blockLength * 2);
+	auto IsSilent = [](const Vector<float>& buffer)
+	{
+		for(float f : buffer)
+		{
+			if(f != 0.0f)
+				return false;
+		}
+		return true;
+	};
+
+	for(const String& extension : { String("ogg"), String("mp3"), String("wav") })
+	{
+		Vector<FileInfo> files = Files::ScanFilesRecursive("songs", extension);
+		if(files.empty())
+		{
+			Logf("No %s file to benchmark seeking", Logger::Severity::Warning, extension);
+			continue;
+		}
+
+		// Streamed seeks should land on the same samples as the preloaded data
+		const String& path = files[0].fullPath;
+		Ref<AudioStream> stream = audio->CreateStream(path, false);
+		Ref<AudioStream> reference = audio->CreateStream(path, true);
+		TestEnsure(stream && reference);
+		stream->Play();
+		reference->Play();
+		const int32 length = (int32)(reference->GetPCMCount() * 1000 / reference->GetSampleRate());
+
+		uint32 numMeasured = 0;
+		double totalTime = 0.0;
+		double maxTime = 0.0;
+		float maxError = 0.0f;
+		for(uint32 i = 0; i < numSeeks; i++)
+		{
+			int32 position = Random::IntRange(0, Math::Max(0, length - 1000));
+			reference->SetPosition(position);
+			reference->Process(preloaded.data(), blockLength);
+			if(IsSilent(preloaded))
+				continue;
+
+			// Output stays silent until the decode thread has seeked
+			Timer t;
+			stream->SetPosition(position);
+			do
+			{
+				std::fill(streamed.begin(), streamed.end(), 0.0f);
+				stream->Process(streamed.data(), blockLength);
+			} while(IsSilent(streamed) && t.SecondsAsDouble() < 1.0);
+			double seekTime = t.SecondsAsDouble();
+
+			totalTime += seekTime;
+			maxTime = Math::Max(maxTime, seekTime);
+			numMeasured++;
+			for(uint32 j = 0; j < blockLength * 2; j++)
+				maxError = Math::Max(maxError, fabsf(streamed[j] - preloaded[j]));
+		}
+
+		Logf("%-4s %2d seeks: %7.3f ms average, %7.3f ms max, max difference %f", Logger::Severity::Info,
+			extension, numMeasured, totalTime * 1000.0 / Math::Max(1u, numMeasured), maxTime * 1000.0, maxError);
+		TestEnsure(maxError < 1e-3f);
+
+		stream.reset();
+		reference.reset();
+	}
+
+	delete audio;
+}
+
+// Preloaded audio made from a few tones and noise, DSPs read from it and use its play position
+class SyntheticAudio : public AudioBase
+{
+public:
+	SyntheticAudio(uint32 sampleRate, double seconds) : m_sampleRate(sampleRate)
+	{
+		m_pcm.resize((size_t)(seconds * sampleRate) * 2);
+		for(size_t i = 0; i < m_pcm.size() / 2; i++)
+		{
+			double t = (double)i / sampleRate;
+			float tone = (float)(0.3 * sin(2.0 * Math::pi * 110.0 * t) + 0.2 * sin(2.0 * Math::pi * 440.0 * t) + 0.1 * sin(2.0 * Math::pi * 3520.0 * t));
+			m_pcm[i * 2] = tone + Random::FloatRange(-0.1f, 0.1f);
+			m_pcm[i * 2 + 1] = tone + Random::FloatRange(-0.1f, 0.1f);
+		}
+	}
+
+	// Copies the next block to out and advances the play position
+	void Read(float* out, uint32 numFrames)
+	{
+		const uint64 numTotal = GetPCMCount();
+		for(uint32 i = 0; i < numFrames; i++)
+		{
+			uint64 index = (m_position + i) % numTotal;
+			out[i * 2] = m_pcm[index * 2];
+			out[i * 2 + 1] = m_pcm[index * 2 + 1];
+		}
+	}
+	void Advance(uint32 numFrames) { m_position = (m_position + numFrames) % GetPCMCount(); }
+
+	void Process(float* out, uint32 numSamples) override {}
+	int32 GetPosition() const override { return (int32)(m_position * 1000 / m_sampleRate); }
+	uint32 GetSampleRate() const override { return m_sampleRate; }
+	uint64 GetSamplePos() const override { return m_position; }
+	float* GetPCM() override { return m_pcm.data(); }
+	uint64 GetPCMCount() const override { return m_pcm.size() / 2; }
+	void PreRenderDSPs(Vector<DSP*>& DSPs) override {}
+
+private:
+	uint32 m_sampleRate;
+	Vector<float> m_pcm;
+	uint64 m_position = 0;
+};
+
+Test("Audio.Benchmark.DSP")
+{
+	const uint32 sampleRate = 48000;
+	// Effect lengths as used for a quarter note at 120 BPM
+	const double noteLength = 500.0;
+	const Vector<uint32> blockSizes = { 64, 256, 1024 };
+
+	using CreateFunc = std::function<DSP*()>;
+	const Map<String, CreateFunc> effects = {
+		{ "Pan", [&]() { PanDSP* dsp = new PanDSP(); dsp->panning = 0.5f; return dsp; } },
+		{ "BQF", [&]() { BQFDSP* dsp = new BQFDSP(sampleRate); dsp->SetLowPass(1.0f, 800.0f); return dsp; } },
+		{ "BitCrusher", [&]() { BitCrusherDSP* dsp = new BitCrusherDSP(sampleRate); dsp->SetPeriod(10.0f); return dsp; } },
+		{ "Gate", [&]() { GateDSP* dsp = new GateDSP(sampleRate); dsp->SetLength(noteLength / 8); dsp->SetGating(0.5f); return dsp; } },
+		{ "TapeStop", [&]() { TapeStopDSP* dsp = new TapeStopDSP(sampleRate); dsp->SetLength(noteLength * 4); return dsp; } },
+		{ "Retrigger", [&]() {
+			RetriggerDSP* dsp = new RetriggerDSP(sampleRate);
+			dsp->SetMaxLength((uint32)noteLength);
+			dsp->SetLength(noteLength / 8);
+			dsp->SetGating(0.7f);
+			dsp->SetResetDuration((uint32)noteLength);
+			return dsp;
+		} },
+		{ "Wobble", [&]() { WobbleDSP* dsp = new WobbleDSP(sampleRate); dsp->SetLength(noteLength / 4); return dsp; } },
+		{ "Phaser", [&]() { PhaserDSP* dsp = new PhaserDSP(sampleRate); dsp->SetLength(noteLength * 4); dsp->SetStage(6); return dsp; } },
+		{ "Flanger", [&]() {
+			FlangerDSP* dsp = new FlangerDSP(sampleRate);
+			dsp->SetLength(noteLength * 4);
+			dsp->SetDelayRange(30, 60);
+			dsp->SetFeedback(0.6f);
+			dsp->SetVolume(0.75f);
+			return dsp;
+		} },
+		{ "Echo", [&]() { EchoDSP* dsp = new EchoDSP(sampleRate); dsp->SetLength(noteLength / 4); dsp->feedback = 0.6f; return dsp; } },
+		{ "Sidechain", [&]() {
+			SidechainDSP* dsp = new SidechainDSP(sampleRate);
+			dsp->SetLength(noteLength);
+			dsp->SetAttackTime(10.0);
+			dsp->SetHoldTime(50.0);
+			dsp->SetReleaseTime(noteLength / 2);
+			return dsp;
+		} },
+		{ "PitchShift", [&]() { PitchShiftDSP* dsp = new PitchShiftDSP(sampleRate); dsp->amount = 4.0f; return dsp; } },
+	};
+	// Combinations seen during dense FX sections, a laser filter on top of button effects
+	const Vector<Vector<String>> chains = {
+		{ "BQF", "Retrigger" },
+		{ "BQF", "Phaser", "Echo" },
+		{ "BQF", "Flanger", "Sidechain" },
+		{ "Wobble", "Gate", "BitCrusher" },
+	};
+
+	Vector<Vector<String>> configurations;
+	for(auto& effect : effects)
+		configurations.Add({ effect.first });
+	for(auto& chain : chains)
+		configurations.Add(chain);
+
+	SyntheticAudio source(sampleRate, 10.0);
+	nlohmann::json results = nlohmann::json::array();
+	for(const Vector<String>& configuration : configurations)
+	{
+		String name;
+		for(const String& effect : configuration)
+		{
+			if(!name.empty())
+				name += "+";
+			name += effect;
+		}
+		for(uint32 blockSize : blockSizes)
+		{
+			Vector<DSP*> DSPs;
+			for(const String& effect : configuration)
+			{
+				DSP* dsp = effects.at(effect)();
+				dsp->SetAudioBase(&source);
+				dsp->endTime = UINT32_MAX;
+				DSPs.Add(dsp);
+			}
+
+			Vector<float> buffer(blockSize * 2);
+			uint64 numFrames = 0;
+			Timer t;
+			while(t.SecondsAsDouble() < benchmarkDuration)
+			{
+				source.Read(buffer.data(), blockSize);
+				for(DSP* dsp : DSPs)
+					dsp->Process(buffer.data(), blockSize);
+				source.Advance(blockSize);
+				numFrames += blockSize;
+			}
+			double elapsed = t.SecondsAsDouble();
+			double nsPerFrame = elapsed * 1e9 / (double)numFrames;
+			double realtime = (double)numFrames / (elapsed * sampleRate);
+			Logf("%-28s block %4d: %8.1f ns/frame (%.0fx realtime at 48kHz)", Logger::Severity::Info,
+				name, blockSize, nsPerFrame, realtime);
+
+			results.push_back({
+				{ "name", name },
+				{ "blockSize", blockSize },
+				{ "nsPerFrame", nsPerFrame },
+				{ "realtimeFactor", realtime },
+			});
+
+			for(DSP* dsp : DSPs)
+			{
+				dsp->RemoveAudioBase();
+				delete dsp;
+			}
+		}
+	}
+
+	// Machine readable results to compare between builds
+	String jsonPath = Path::Absolute(TestBasePath + Path::sep + context.GetName() + ".json");
+	File file;
+	TestEnsure(file.OpenWrite(jsonPath));
+	std::string text = results.dump(1, '\t');
+	file.Write(text.data(), text.size());
+	Logf("Results written to %s", Logger::Severity::Info, jsonPath);
+}
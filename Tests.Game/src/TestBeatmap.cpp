@@ -3,6 +3,10 @@
 #include <Beatmap/BeatmapPlayback.hpp>
 #include <Audio/DSP.hpp>
 #include "TestMusicPlayer.hpp"
+#include <Shared/MemoryStream.hpp>
+#include <Beatmap/KShootMap.hpp>
+#include <Shared/Sha1.hpp>
+#include <Beatmap/TinySHA1.hpp>
 
 // Normal test map
 static String testBeatmapPath = Path::Normalize("songs/love is insecurable/love_is_insecurable.ksh");
@@ -340,3 +344,155 @@ Test("Beatmap.SingleFilter")
 	Player player(beatmap, mapRootPath);
 	player.Run();
 }
+
+// File reader that counts the calls that end up as system calls and the bytes read
+class CountingFileReader : public FileReader
+{
+public:
+	using FileReader::FileReader;
+	size_t Serialize(void* data, size_t len) override
+	{
+		numCalls++;
+		size_t read = FileReader::Serialize(data, len);
+		numBytes += read;
+		return read;
+	}
+	void Seek(size_t pos) override
+	{
+		numCalls++;
+		FileReader::Seek(pos);
+	}
+	size_t Tell() const override
+	{
+		numCalls++;
+		return FileReader::Tell();
+	}
+	size_t GetSize() const override
+	{
+		numCalls++;
+		return FileReader::GetSize();
+	}
+
+	mutable uint64 numCalls = 0;
+	uint64 numBytes = 0;
+};
+
+// The header scanner should read the same settings as the full parser
+Test("Beatmap.Metadata")
+{
+	const Vector<String> charts = {
+		"\xef\xbb\xbftitle=A=B\r\n// comment\r\n\r\n  artist=Test  \r\nt=120\r\n--\r\n1000|00|--\r\n--\r\n",
+		// No byte order mark, Shift-JIS title
+		"title=\x83\x65\x83\x58\x83\x67\r\nartist=Test\r\n--\r\nnot=parsed\r\n",
+		// No measures and no line ending at the end
+		"\xef\xbb\xbftitle=Test\r\nt=180",
+		// Lines without a value are invalid
+		"\xef\xbb\xbftitle=Test\r\ninvalid\r\n--\r\n",
+		"",
+	};
+	for(const String& chart : charts)
+	{
+		Buffer data(chart.begin(), chart.end());
+		MemoryReader reader(data);
+		KShootMap full, header;
+		bool fullValid = full.Init(reader, true);
+		bool headerValid = header.InitHeader(chart.data(), chart.size());
+		TestEnsure(fullValid == headerValid);
+		if(fullValid)
+			TestEnsure(full.settings == header.settings);
+	}
+}
+
+// Compares reading chart metadata and hashing the file in separate passes with reading it once
+Test("Beatmap.Benchmark.ReadChart")
+{
+	// SHA-1 implementations should agree with each other and the old hash
+	const char* abc = "abc";
+	TestEnsure(Sha1::HashHex(abc, 3) == "a9993e364706816aba3e25717850c26c9cd0d89d");
+	Buffer random(1000);
+	for(uint8& b : random)
+		b = (uint8)Random::IntRange(0, 255);
+	for(size_t size = 0; size < random.size(); size += 7)
+	{
+		uint32 reference[5];
+		sha1::SHA1 s;
+		s.processBytes(random.data(), size);
+		s.getDigest(reference);
+		for(const Sha1::Implementation* impl : Sha1::GetSupported())
+		{
+			uint32 digest[5];
+			Sha1::Hash(random.data(), size, digest, *impl);
+			TestEnsure(memcmp(reference, digest, sizeof(digest)) == 0);
+		}
+	}
+	Logf("Selected SHA-1 implementation: %s", Logger::Severity::Info, Sha1::Get().name);
+
+	// Synthetic chart with a typical header and 400 measures
+	String path = Path::Absolute(TestBasePath + Path::sep + context.GetName() + ".ksh");
+	{
+		String chart = "\xef\xbb\xbftitle=Benchmark\r\nartist=Test\r\neffect=Test\r\njacket=jacket.png\r\nillustrator=Test\r\n"
+			"difficulty=infinite\r\nlevel=18\r\nt=180\r\nm=song.ogg\r\nmvol=75\r\no=0\r\nbg=desert\r\nlayer=arrow\r\npo=60000\r\nplength=15000\r\nver=160\r\n--\r\n";
+		for(uint32 i = 0; i < 400; i++)
+		{
+			chart += "beat=4/4\r\n";
+			for(uint32 j = 0; j < 16; j++)
+				chart += (j % 4 == 0) ? "1000|01|0o\r\n" : "0000|00|--\r\n";
+			chart += "--\r\n";
+		}
+		File file;
+		TestEnsure(file.OpenWrite(path));
+		file.Write(chart.data(), chart.size());
+	}
+
+	const uint32 numReads = 200;
+	String oldHash, newHash;
+
+	// Before: parse through the file, seek back and hash in small chunks
+	uint64 oldCalls = 0, oldBytes = 0;
+	Timer t;
+	for(uint32 i = 0; i < numReads; i++)
+	{
+		File file;
+		TestEnsure(file.OpenRead(path));
+		CountingFileReader reader(file);
+		Beatmap map;
+		TestEnsure(map.Load(reader, true));
+		reader.Seek(0);
+		char buffer[0x80];
+		sha1::SHA1 s;
+		size_t read;
+		while((read = reader.Serialize(buffer, sizeof(buffer))) != 0)
+			s.processBytes(buffer, read);
+		uint32 digest[5];
+		s.getDigest(digest);
+		oldHash = Utility::Sprintf("%08x%08x%08x%08x%08x", digest[0], digest[1], digest[2], digest[3], digest[4]);
+		oldCalls += reader.numCalls;
+		oldBytes += reader.numBytes;
+	}
+	double oldTime = t.SecondsAsDouble();
+
+	// After: read the file once, parse only the header and hash the buffer
+	uint64 newCalls = 0, newBytes = 0;
+	t.Restart();
+	for(uint32 i = 0; i < numReads; i++)
+	{
+		File file;
+		TestEnsure(file.OpenRead(path));
+		CountingFileReader fileReader(file);
+		Buffer data(fileReader.GetSize());
+		TestEnsure(fileReader.Serialize(data.data(), data.size()) == data.size());
+		Beatmap map;
+		TestEnsure(map.LoadMetadata((const char*)data.data(), data.size()));
+		newHash = Sha1::HashHex(data.data(), data.size());
+		newCalls += fileReader.numCalls;
+		newBytes += fileReader.numBytes;
+	}
+	double newTime = t.SecondsAsDouble();
+
+	TestEnsure(oldHash == newHash);
+	TestEnsure(newCalls < oldCalls);
+	Logf("Separate passes: %.1f calls, %.0f bytes read, %.1f us per chart", Logger::Severity::Info,
+		(double)oldCalls / numReads, (double)oldBytes / numReads, oldTime * 1000000.0 / numReads);
+	Logf("Single pass:     %.1f calls, %.0f bytes read, %.1f us per chart", Logger::Severity::Info,
+		(double)newCalls / numReads, (double)newBytes / numReads, newTime * 1000000.0 / numReads);
+}
@@ -0,0 +1,245 @@
+#include "stdafx.h"
+#include <Beatmap/MapDatabase.hpp>
+#include <atomic>
+#include <thread>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+static const uint32 numTestFolders = 20;
+static const uint32 numTestChartsPerFolder = 10;
+
+static void WriteTestChart(const String& path, uint32 song, uint32 level)
+{
+	String chart = Utility::Sprintf("\xef\xbb\xbftitle=Song %d\r\nartist=Test\r\ndifficulty=extended\r\nlevel=%d\r\nt=120\r\n--\r\n1000|00|--\r\n--\r\n", song, level);
+	File file;
+	TestEnsure(file.OpenWrite(path));
+	file.Write(chart.data(), chart.size());
+}
+
+// Generates a folder of small charts, returns the paths of the charts in the order a search finds them
+static Vector<String> CreateTestCharts(const String& folder)
+{
+	Vector<String> paths;
+	Path::DeleteDir(folder);
+	TestEnsure(Path::CreateDirRecursive(folder));
+	for(uint32 i = 0; i < numTestFolders; i++)
+	{
+		String songFolder = folder + Path::sep + Utility::Sprintf("song%02d", i);
+		TestEnsure(Path::CreateDir(songFolder));
+		for(uint32 j = 0; j < numTestChartsPerFolder; j++)
+		{
+			String path = songFolder + Path::sep + Utility::Sprintf("chart%02d.ksh", j);
+			WriteTestChart(path, i, j + 1);
+			paths.Add(path);
+		}
+	}
+	return paths;
+}
+
+// Counts the charts the search thread handed to the database and can pause the search after a number of them
+//	the chart map of the database can't be read during a search, charts are collected from the folder events instead
+class SearchObserver
+{
+public:
+	SearchObserver(MapDatabase& database, uint32 pauseAfter = 0) : m_database(database), m_pauseAfter(pauseAfter)
+	{
+		database.OnSearchStatusUpdated.Add(this, &SearchObserver::OnStatus);
+		database.OnFoldersAdded.Add(this, &SearchObserver::OnFolders);
+		database.OnFoldersUpdated.Add(this, &SearchObserver::OnFolders);
+	}
+	void OnStatus(String status)
+	{
+		if(status.compare(0, 17, "Discovered Chart ") == 0)
+		{
+			// Paused from the search thread so the search stops at exactly this chart
+			if(++numDiscovered == m_pauseAfter)
+				m_database.PauseSearching();
+		}
+		else if(status == "[END] Chart Database - Process New Charts")
+		{
+			done = true;
+		}
+	}
+	void OnFolders(Vector<FolderIndex*> folders)
+	{
+		for(FolderIndex* folder : folders)
+		{
+			for(ChartIndex* chart : folder->charts)
+				charts[chart->id] = chart;
+		}
+	}
+	// Waits for a condition set by the search thread, false after a timeout
+	template<typename T>
+	bool Wait(T&& condition)
+	{
+		Timer t;
+		while(!condition())
+		{
+			if(t.SecondsAsDouble() > 30.0)
+				return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+
+	std::atomic<uint32> numDiscovered{0};
+	std::atomic<bool> done{false};
+	// Charts applied by MapDatabase::Update by id
+	Map<int32, ChartIndex*> charts;
+
+private:
+	MapDatabase& m_database;
+	uint32 m_pauseAfter;
+};
+
+static String OpenTestDatabase()
+{
+	String databasePath = Path::Absolute("maps.db");
+	Path::Delete(databasePath);
+	return databasePath;
+}
+
+// Charts are added in the order they were found, independent of the number of threads reading them
+Test("MapDatabase.IngestionOrder")
+{
+	String folder = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_TestFolder");
+	Vector<String> paths = CreateTestCharts(folder);
+
+	for(uint32 numThreads : { 1u, 4u, 0u })
+	{
+		String databasePath = OpenTestDatabase();
+		{
+			MapDatabase database(true);
+			database.SetChartReadThreads(numThreads);
+			database.FinishInit();
+			SearchObserver observer(database);
+			database.AddSearchPath(folder);
+			database.StartSearching();
+			TestEnsure(observer.Wait([&] { return observer.done.load(); }));
+			database.Update();
+
+			TestEnsure(observer.charts.size() == paths.size());
+			TestEnsure(observer.numDiscovered == paths.size());
+			size_t i = 0;
+			for(auto& chart : observer.charts)
+			{
+				// Ids are given out in the order the changes were added
+				TestEnsure(Path::Normalize(chart.second->path) == Path::Normalize(paths[i]));
+				TestEnsure(chart.second->level == (int32)(i % numTestChartsPerFolder) + 1);
+				i++;
+			}
+			database.StopSearching();
+		}
+		Path::Delete(databasePath);
+	}
+}
+
+// Pausing a search stops adding charts until it is resumed, stopping a paused search doesn't add the rest
+Test("MapDatabase.PauseStop")
+{
+	String folder = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_TestFolder");
+	Vector<String> paths = CreateTestCharts(folder);
+	const uint32 pauseAfter = 50;
+
+	// Pause and resume
+	String databasePath = OpenTestDatabase();
+	{
+		MapDatabase database(true);
+		database.SetChartReadThreads(4);
+		database.FinishInit();
+		SearchObserver observer(database, pauseAfter);
+		database.AddSearchPath(folder);
+		database.StartSearching();
+		TestEnsure(observer.Wait([&] { return observer.numDiscovered >= pauseAfter; }));
+
+		// Nothing is added while paused
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		TestEnsure(observer.numDiscovered == pauseAfter);
+		TestEnsure(!observer.done);
+		database.Update();
+		TestEnsure(observer.charts.size() == pauseAfter);
+
+		database.ResumeSearching();
+		TestEnsure(observer.Wait([&] { return observer.done.load(); }));
+		database.Update();
+		TestEnsure(observer.charts.size() == paths.size());
+		database.StopSearching();
+	}
+	Path::Delete(databasePath);
+
+	// Stop while paused
+	databasePath = OpenTestDatabase();
+	{
+		MapDatabase database(true);
+		database.SetChartReadThreads(4);
+		database.FinishInit();
+		SearchObserver observer(database, pauseAfter);
+		database.AddSearchPath(folder);
+		database.StartSearching();
+		TestEnsure(observer.Wait([&] { return observer.numDiscovered >= pauseAfter; }));
+
+		// Joins the search and its read threads
+		database.StopSearching();
+		TestEnsure(observer.numDiscovered == pauseAfter);
+		database.Update();
+		TestEnsure(observer.charts.size() == pauseAfter);
+	}
+	Path::Delete(databasePath);
+}
+#ifdef __linux__
+// Changes under a symlinked folder are matched with the charts the search found behind the link
+Test("MapDatabase.WatchSymlink")
+{
+	String folder = Path::Normalize(Path::Absolute(TestBasePath)) + Path::sep + context.GetName() + "_TestFolder";
+	String target = folder + "_Target";
+	String link = folder + Path::sep + "Linked";
+	// Remove the link first so cleaning up never follows it
+	unlink(*link);
+	Path::DeleteDir(folder);
+	TestEnsure(Path::CreateDir(folder));
+	Vector<String> paths = CreateTestCharts(target);
+	TestEnsure(symlink(*target, *link) == 0);
+
+	String databasePath = OpenTestDatabase();
+	{
+		MapDatabase database;
+		SearchObserver observer(database);
+		database.AddSearchPath(folder);
+		database.StartSearching();
+		TestEnsure(observer.Wait([&] { return observer.done && !database.IsSearching(); }));
+		database.Update();
+		TestEnsure(database.GetChartMap().size() == paths.size());
+
+		// Write through the link until the file watcher picks it up, it only starts watching after the search
+		String changed = target + Path::sep + "song00" + Path::sep + "chart00.ksh";
+		String added = target + Path::sep + "song00" + Path::sep + "added.ksh";
+		WriteTestChart(link + Path::sep + "song00" + Path::sep + "added.ksh", 0, 20);
+		WriteTestChart(link + Path::sep + "song00" + Path::sep + "chart00.ksh", 0, 20);
+		Timer lastWrite;
+		bool found = observer.Wait([&] {
+			if (lastWrite.Milliseconds() > 2000)
+			{
+				WriteTestChart(link + Path::sep + "song00" + Path::sep + "added.ksh", 0, 20);
+				WriteTestChart(link + Path::sep + "song00" + Path::sep + "chart00.ksh", 0, 20);
+				lastWrite.Restart();
+			}
+			database.Update();
+			ChartIndex* chart = database.FindFirstChartByPath(changed);
+			return chart && chart->level == 20 && database.FindFirstChartByPath(added);
+		});
+		TestEnsure(found);
+
+		// Updated in place instead of added again under the path of the link
+		auto& charts = database.GetChartMap();
+		TestEnsure(charts.size() == paths.size() + 1);
+		for (auto& chart : charts)
+			TestEnsure(chart.second->path.compare(0, target.size() + 1, target + Path::sep) == 0);
+		database.StopSearching();
+	}
+	Path::Delete(databasePath);
+	unlink(*link);
+	Path::DeleteDir(folder);
+	Path::DeleteDir(target);
+}
+#endif
@@ -2,8 +2,12 @@
 #include <Shared/Enum.hpp>
 #include <Tests/Tests.hpp>
 #include <Shared/Files.hpp>
+#include <Shared/FileWatcher.hpp>
 #include <Shared/FileStream.hpp>
 #include <Shared/CompressedFileStream.hpp>
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 void CreateDummyFile(const String& filename)
 {
@@ -67,6 +71,46 @@ Test("File.ScanFilesRecursive")
 	}
 	TestEnsure(expectedPaths.empty());
 }
+Test("File.Benchmark.ScanFilesRecursive")
+{
+	// Synthetic library of 100k files, most of them are not charts
+	const uint32 numFolders = 2000;
+	const uint32 numFilesPerFolder = 50;
+	const uint32 numChartsPerFolder = 3;
+	String folder = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_TestFolder");
+	if(!Path::IsDirectory(folder))
+	{
+		TestEnsure(Path::CreateDir(folder));
+		for(uint32 i = 0; i < numFolders; i++)
+		{
+			String songFolder = folder + Path::sep + Utility::Sprintf("song%d", i);
+			TestEnsure(Path::CreateDir(songFolder));
+			for(uint32 j = 0; j < numFilesPerFolder; j++)
+			{
+				const char* ext = j < numChartsPerFolder ? "ksh" : (j % 2 ? "ogg" : "png");
+				File file;
+				TestEnsure(file.OpenWrite(songFolder + Path::sep + Utility::Sprintf("file%d.%s", j, ext), false));
+			}
+		}
+	}
+
+	Vector<String> exts = { "ksh", "chal", "kco" };
+	Timer t;
+	Map<String, Vector<FileInfo>> charts = Files::ScanFilesRecursive(folder, exts);
+	double chartTime = t.SecondsAsDouble();
+	TestEnsure(charts["ksh"].size() == numFolders * numChartsPerFolder);
+	TestEnsure(charts["chal"].empty());
+	for(const FileInfo& file : charts["ksh"])
+		TestEnsure(file.lastWriteTime != 0);
+
+	// Every file has to be stat'ed without a filter
+	t.Restart();
+	Vector<FileInfo> all = Files::ScanFilesRecursive(folder);
+	double allTime = t.SecondsAsDouble();
+	TestEnsure(all.size() == numFolders * numFilesPerFolder);
+
+	Logf("Scanned %d files for charts in %.3fs, all files in %.3fs", Logger::Severity::Info, numFolders * numFilesPerFolder, chartTime, allTime);
+}
 Test("File.ScanFiles")
 {
 	String folder = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_TestFolder");
@@ -94,6 +138,87 @@ Test("File.ScanFiles")
 	}
 	TestEnsure(expectedPaths.empty());
 }
+Test("File.Watcher")
+{
+	String folder = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_TestFolder");
+	Path::DeleteDir(folder);
+	TestEnsure(Path::CreateDir(folder));
+	folder = Path::Normalize(folder);
+
+	FileWatcher watcher({ "ksh" });
+	watcher.pollInterval = 100;
+	watcher.AddFolder(folder);
+	TestEnsure(watcher.Wait(200).empty());
+
+	// Only files matching the filter are reported
+	String chart = folder + Path::sep + "chart.ksh";
+	CreateDummyFile(chart);
+	CreateDummyFile(folder + Path::sep + "song.ogg");
+	Set<String> changes = watcher.Wait(200);
+	TestEnsure(changes.size() == 1 && changes.Contains(chart));
+
+	// Files in folders that are added later are watched as well
+	String subFolder = folder + Path::sep + "Folder";
+	TestEnsure(Path::CreateDir(subFolder));
+	watcher.Wait(200);
+	String subChart = subFolder + Path::sep + "sub.ksh";
+	CreateDummyFile(subChart);
+	changes = watcher.Wait(200);
+	TestEnsure(changes.size() == 1 && changes.Contains(subChart));
+
+	TestEnsure(Path::Delete(chart));
+	changes = watcher.Wait(200);
+	TestEnsure(changes.size() == 1 && changes.Contains(chart));
+}
+#ifdef __linux__
+Test("File.Watcher.Symlink")
+{
+	String folder = Path::Normalize(Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_TestFolder"));
+	String target = folder + "_Target";
+	String link = folder + Path::sep + "Link";
+	String loop = folder + Path::sep + "Loop";
+	// Remove the links first so cleaning up never follows them
+	unlink(*link);
+	unlink(*loop);
+	Path::DeleteDir(folder);
+	Path::DeleteDir(target);
+	TestEnsure(Path::CreateDir(folder));
+	TestEnsure(Path::CreateDir(target));
+
+	// Symlinked folders are watched like normal ones, a link back to the root must not loop forever
+	TestEnsure(symlink(*target, *link) == 0);
+	TestEnsure(symlink(*folder, *loop) == 0);
+	FileWatcher watcher({ "ksh" });
+	watcher.AddFolder(folder);
+	TestEnsure(!watcher.IsPolling());
+
+	// Files are reported by their resolved path, like a scan finds them
+	String chart = target + Path::sep + "chart.ksh";
+	CreateDummyFile(link + Path::sep + "chart.ksh");
+	Set<String> changes = watcher.Wait(200);
+	TestEnsure(changes.size() == 1 && changes.Contains(chart));
+
+	// Removing the link reports the files in it as removed
+	TestEnsure(unlink(*link) == 0);
+	changes = watcher.Wait(200);
+	TestEnsure(changes.size() == 1 && changes.Contains(chart));
+
+	// Links created later are resolved as well, removing the link to the root doesn't forget the root
+	CreateDummyFile(target + Path::sep + "other.ksh");
+	TestEnsure(symlink(*target, *link) == 0);
+	changes = watcher.Wait(200);
+	TestEnsure(changes.size() == 2 && changes.Contains(chart) && changes.Contains(target + Path::sep + "other.ksh"));
+	TestEnsure(unlink(*loop) == 0);
+	TestEnsure(watcher.Wait(200).empty());
+	TestEnsure(unlink(*link) == 0);
+	changes = watcher.Wait(200);
+	TestEnsure(changes.size() == 2);
+
+	unlink(*loop);
+	Path::DeleteDir(folder);
+	Path::DeleteDir(target);
+}
+#endif
 Test("File.Dir")
 {
 	String folder = TestFilename;